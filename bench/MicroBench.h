@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal in-tree microbenchmark harness modelled on google-benchmark.
+// A benchmark body loops while state.KeepRunning(); the harness grows the iteration count until
+// one run takes at least the minimum time and records the per-iteration wall time.
+
+// Keeps the compiler from discarding a value that is computed only to be timed.
+template <typename T>
+inline void DoNotOptimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile const void* sink;
+	sink = &value;
+#endif
+}
+
+class BenchState
+{
+private:
+	int64_t iterations;
+	int64_t done = 0;
+	int64_t itemsPerIteration = 0;
+	std::chrono::steady_clock::time_point start, stop;
+
+public:
+	BenchState(int64_t _iterations) : iterations(_iterations) {}
+
+	// Starts the timer on the first call, so setup before the loop is not measured.
+	bool KeepRunning()
+	{
+		if (done == 0) start = std::chrono::steady_clock::now();
+		if (done < iterations)
+		{
+			done++;
+			return true;
+		}
+		stop = std::chrono::steady_clock::now();
+		return false;
+	}
+
+	// Number of work items (particles, springs, vertices, ...) one iteration processes.
+	void SetItemsPerIteration(int64_t n) { itemsPerIteration = n; }
+
+	int64_t GetIterations() const { return iterations; }
+	int64_t GetItemsPerIteration() const { return itemsPerIteration; }
+	double GetSeconds() const { return std::chrono::duration<double>(stop - start).count(); }
+};
+
+struct BenchResult
+{
+	std::string name;
+	int64_t iterations;
+	double nsPerIteration;
+	double itemsPerSecond;
+};
+
+class MicroBench
+{
+private:
+	std::string filter;
+	double minTime;
+	std::vector<BenchResult> results;
+	std::vector<std::pair<std::string, std::string>> context;
+
+public:
+	MicroBench(const std::string& _filter, double _minTime) : filter(_filter), minTime(_minTime) {}
+
+	// Whether a benchmark name passes the filter, so callers can skip expensive setup.
+	bool Matches(const std::string& name) const { return filter.empty() || name.find(filter) != std::string::npos; }
+
+	// Adds a key/value pair to the "context" object of the report.
+	void AddContext(const std::string& key, const std::string& value) { context.push_back({ key, value }); }
+
+	// Run: Times body with a growing iteration count until a run lasts at least minTime.
+	void Run(const std::string& name, const std::function<void(BenchState&)>& body)
+	{
+		if (!Matches(name)) return;
+
+		int64_t n = 1;
+		while (true)
+		{
+			BenchState state(n);
+			body(state);
+			double seconds = state.GetSeconds();
+			if (seconds >= minTime || n >= 1000000000)
+			{
+				BenchResult r;
+				r.name = name;
+				r.iterations = n;
+				r.nsPerIteration = seconds * 1e9 / n;
+				r.itemsPerSecond = seconds > 0.0 ? state.GetItemsPerIteration() * n / seconds : 0.0;
+				results.push_back(r);
+				fprintf(stderr, "%-40s %12lld it %14.1f ns/it %12.3e items/s\n", name.c_str(), (long long)n, r.nsPerIteration, r.itemsPerSecond);
+				return;
+			}
+
+			// Aim for 1.4x the minimum time, growing at most 10x per attempt.
+			double target = seconds > 0.0 ? n * minTime * 1.4 / seconds : n * 10.0;
+			n = std::max(n + 1, (int64_t)std::min(target, n * 10.0));
+		}
+	}
+
+	// WriteJSON: Writes the results in the layout of google-benchmark's JSON reporter.
+	void WriteJSON(FILE* file) const
+	{
+		fprintf(file, "{\n  \"context\": {\n");
+		for (size_t i = 0; i < context.size(); i++)
+		{
+			fprintf(file, "    \"%s\": \"%s\"%s\n", context[i].first.c_str(), context[i].second.c_str(), i + 1 < context.size() ? "," : "");
+		}
+		fprintf(file, "  },\n  \"benchmarks\": [\n");
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const BenchResult& r = results[i];
+			fprintf(file, "    {\"name\": \"%s\", \"iterations\": %lld, \"real_time\": %.3f, \"time_unit\": \"ns\", \"items_per_second\": %.6e}%s\n",
+				r.name.c_str(), (long long)r.iterations, r.nsPerIteration, r.itemsPerSecond, i + 1 < results.size() ? "," : "");
+		}
+		fprintf(file, "  ]\n}\n");
+	}
+};
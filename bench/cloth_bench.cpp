@@ -0,0 +1,478 @@
+#include "ClothWorld.h"
+#include "Skin.h"
+#include "Character.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// Command-line benchmark driver for the headless cloth simulation.
+// Runs a fixed number of frames and reports the wall time of each phase and the throughput in particle-substeps/s.
+
+struct BenchConfig
+{
+    float size = 4.0f;
+    float mass = 100.0f;
+    int N = 64;
+    int cloths = 1; // Cloths in the world, every third one at full size and the others at half and a quarter.
+    int frames = 600;
+    int substeps = 0; // 0 keeps the solver's default (adaptive for the explicit solver).
+    double dt = 1.0 / 60.0;
+    glm::vec3 wind = glm::vec3(0.5f, 0.5f, -2.5f);
+    SolverMode solver = SOLVER_EXPLICIT;
+    int blockSubsteps = 1; // Substeps per pass of the grid solver's temporal blocking.
+    ImplicitPreconditioner precond = PRECOND_MULTIGRID;
+    bool sleep = true; // Let resting tiles of the explicit solver sleep.
+    bool selfCollision = false;
+    float thickness = 0.0f; // 0 keeps the default, a quarter of the rest length.
+    std::vector<int> threads;
+    std::string meshFile; // .skin file whose positions and triangles replace the grid.
+    MeshOrdering order = MESH_ORDER_RCM;
+    std::string colliderFile, skelFile, animFile; // Skin the cloths collide with, optionally posed and animated.
+    bool boxes = false; // Collide with the skeleton's joint boxes instead of the skin.
+    bool sdf = false; // Collide with a distance field of the skin in its first pose instead of the moving skin.
+    float sdfCell = 0.0f; // 0 divides the largest side of the skin's bounds into 64 cells.
+    std::string sdfCache;
+    bool shuffle = false; // Randomize the vertex and triangle order of the mesh first.
+    std::string csvFile, traceFile;
+};
+
+// PrintUsage: Lists the command-line options.
+static void PrintUsage(const char* name)
+{
+    std::cout << "Usage: " << name << " [options]\n"
+        << "  --size <float>        edge length of the cloth (default 4)\n"
+        << "  --mass <float>        total mass of the cloth (default 100)\n"
+        << "  --n <int>             particles along one edge (default 64)\n"
+        << "  --cloths <int>        cloths stepped together, sizes cycling N, N/2, N/4 (default 1)\n"
+        << "  --mesh <file>         cloth from the positions and triangles of a .skin file, pinned at the top\n"
+        << "  --order <name>        mesh particle order: none, morton, hilbert or rcm (default rcm)\n"
+        << "  --shuffle <0|1>       randomize the vertex and triangle order of the mesh first (default 0)\n"
+        << "  --frames <int>        frames to simulate (default 600)\n"
+        << "  --substeps <int>      substeps per frame, 0 = solver default (default 0)\n"
+        << "  --dt <float>          fixed frame step in seconds (default 1/60)\n"
+        << "  --wind <x,y,z>        wind velocity (default 0.5,0.5,-2.5)\n"
+        << "  --solver <name>       explicit, implicit, xpbd, projective or grid (default explicit)\n"
+        << "  --block <int>         substeps per cache-blocked pass of the grid solver (default 1)\n"
+        << "  --precond <name>      jacobi or multigrid, for the implicit solver (default multigrid)\n"
+        << "  --sleep <0|1>         let resting tiles sleep with the explicit solver (default 1)\n"
+        << "  --self <0|1>          particle-triangle and edge-edge self-collision (default 0)\n"
+        << "  --thickness <float>   self-collision thickness (default a quarter of the rest length)\n"
+        << "  --collider <file>     .skin mesh placed behind the cloth as a collider\n"
+        << "  --skel <file>         .skel that poses the collider\n"
+        << "  --anim <file>         .anim that animates the posed collider\n"
+        << "  --boxes <0|1>         collide with the joint boxes of --skel instead of a skin (default 0)\n"
+        << "  --sdf <0|1>           collide with a distance field of the --collider skin, held in its first pose (default 0)\n"
+        << "  --sdf-cell <float>    cell size of the distance field (default 1/64 of the skin's largest side)\n"
+        << "  --sdf-cache <file>    load the distance field from this file, or save it there after building\n"
+        << "  --threads <a,b,...>   thread counts to run, one run each (default all)\n"
+        << "  --csv <file>          write the timed events of the last run as CSV\n"
+        << "  --trace <file>        write the timed events of the last run as Chrome trace JSON\n";
+}
+
+// ParseList: Splits a comma-separated list of numbers.
+template <typename T>
+static std::vector<T> ParseList(const char* arg)
+{
+    std::vector<T> values;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        std::stringstream is(item);
+        T value;
+        if (is >> value) values.push_back(value);
+    }
+    return values;
+}
+
+// ParseArgs: Fills the configuration from argv, returns false on an unknown or malformed option.
+static bool ParseArgs(int argc, char* argv[], BenchConfig& config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string opt = argv[i];
+        if (opt == "--help" || opt == "-h") return false;
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << opt << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (opt == "--size") config.size = (float)atof(value);
+        else if (opt == "--mass") config.mass = (float)atof(value);
+        else if (opt == "--n") config.N = atoi(value);
+        else if (opt == "--cloths") config.cloths = atoi(value);
+        else if (opt == "--mesh") config.meshFile = value;
+        else if (opt == "--shuffle") config.shuffle = atoi(value) != 0;
+        else if (opt == "--order")
+        {
+            std::string name = value;
+            if (name == "none") config.order = MESH_ORDER_NONE;
+            else if (name == "morton") config.order = MESH_ORDER_MORTON;
+            else if (name == "hilbert") config.order = MESH_ORDER_HILBERT;
+            else if (name == "rcm") config.order = MESH_ORDER_RCM;
+            else
+            {
+                std::cerr << "Unknown order " << name << std::endl;
+                return false;
+            }
+        }
+        else if (opt == "--frames") config.frames = atoi(value);
+        else if (opt == "--substeps") config.substeps = atoi(value);
+        else if (opt == "--dt") config.dt = atof(value);
+        else if (opt == "--block") config.blockSubsteps = atoi(value);
+        else if (opt == "--precond")
+        {
+            std::string name = value;
+            if (name == "jacobi") config.precond = PRECOND_BLOCK_JACOBI;
+            else if (name == "multigrid") config.precond = PRECOND_MULTIGRID;
+            else
+            {
+                std::cerr << "Unknown preconditioner " << name << std::endl;
+                return false;
+            }
+        }
+        else if (opt == "--sleep") config.sleep = atoi(value) != 0;
+        else if (opt == "--self") config.selfCollision = atoi(value) != 0;
+        else if (opt == "--thickness") config.thickness = (float)atof(value);
+        else if (opt == "--collider") config.colliderFile = value;
+        else if (opt == "--skel") config.skelFile = value;
+        else if (opt == "--anim") config.animFile = value;
+        else if (opt == "--boxes") config.boxes = atoi(value) != 0;
+        else if (opt == "--sdf") config.sdf = atoi(value) != 0;
+        else if (opt == "--sdf-cell") config.sdfCell = (float)atof(value);
+        else if (opt == "--sdf-cache") config.sdfCache = value;
+        else if (opt == "--threads") config.threads = ParseList<int>(value);
+        else if (opt == "--csv") config.csvFile = value;
+        else if (opt == "--trace") config.traceFile = value;
+        else if (opt == "--wind")
+        {
+            std::vector<float> w = ParseList<float>(value);
+            if (w.size() != 3)
+            {
+                std::cerr << "--wind expects x,y,z" << std::endl;
+                return false;
+            }
+            config.wind = glm::vec3(w[0], w[1], w[2]);
+        }
+        else if (opt == "--solver")
+        {
+            std::string name = value;
+            if (name == "explicit") config.solver = SOLVER_EXPLICIT;
+            else if (name == "implicit") config.solver = SOLVER_IMPLICIT;
+            else if (name == "xpbd") config.solver = SOLVER_XPBD;
+            else if (name == "projective") config.solver = SOLVER_PROJECTIVE;
+            else if (name == "grid") config.solver = SOLVER_GRID;
+            else
+            {
+                std::cerr << "Unknown solver " << name << std::endl;
+                return false;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option " << opt << std::endl;
+            return false;
+        }
+    }
+
+    if (config.N < 2 || config.cloths < 1 || config.frames < 1 || config.dt <= 0.0)
+    {
+        std::cerr << "Need --n >= 2, --cloths >= 1, --frames >= 1 and --dt > 0" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// MeshCloth: Bind pose of a skin moved so its top sits at the height of the grid cloth, and the vertices within
+// a hundredth of its height from the top, which get pinned.
+struct MeshCloth
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::ivec3> triangles;
+    std::vector<int> pinned;
+    float width = 0.0f;
+};
+
+static MeshCloth LoadMeshCloth(const std::string& fileName, bool shuffle)
+{
+    Skin skin(fileName, nullptr);
+    MeshCloth mesh;
+    mesh.positions = skin.getBindPositions();
+    mesh.triangles = skin.getTriangles();
+    if (mesh.positions.empty()) return mesh;
+
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (const glm::vec3& p : mesh.positions)
+    {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    glm::vec3 shift(-0.5f * (lo.x + hi.x), 3.0f - hi.y, -0.5f * (lo.z + hi.z));
+    for (int i = 0; i < (int)mesh.positions.size(); i++)
+    {
+        mesh.positions[i] += shift;
+        if (mesh.positions[i].y >= 3.0f - 0.01f * (hi.y - lo.y)) mesh.pinned.push_back(i);
+    }
+    mesh.width = hi.x - lo.x;
+
+    // A fixed seed keeps runs comparable.
+    if (shuffle)
+    {
+        std::mt19937 rng(1);
+        std::vector<int> newIndex(mesh.positions.size());
+        for (int i = 0; i < (int)newIndex.size(); i++) newIndex[i] = i;
+        std::shuffle(newIndex.begin(), newIndex.end(), rng);
+        ApplyMeshOrdering(newIndex, mesh.positions, mesh.triangles, mesh.pinned);
+        std::shuffle(mesh.triangles.begin(), mesh.triangles.end(), rng);
+    }
+    return mesh;
+}
+
+// Character the cloths collide with, through its skin or its joint boxes. It is moved so its front faces the
+// cloths from behind.
+struct BenchCollider
+{
+    std::unique_ptr<Skeleton> skel;
+    std::unique_ptr<Skin> skin;
+    std::unique_ptr<Animation> anim;
+    std::unique_ptr<Character> character;
+    std::unique_ptr<MeshCollider> collider;
+    std::unique_ptr<BoxCollider> boxes;
+    std::unique_ptr<DistanceCollider> sdf;
+    glm::vec3 shift;
+    std::vector<glm::vec3> positions;
+};
+
+// ShiftedPositions: Skinned positions of the collider's skin in front of the cloths.
+static const std::vector<glm::vec3>& ShiftedPositions(BenchCollider& bc)
+{
+    bc.positions = bc.skel ? bc.skin->getPositions() : bc.skin->getBindPositions();
+    for (glm::vec3& p : bc.positions) p += bc.shift;
+    return bc.positions;
+}
+
+// LoadCollider: Loads the collider's skeleton, skin or boxes, and animation. The bounds of the first pose place
+// it behind the cloths, which the wind blows into it. A distance field is built, or read from its cache, once.
+static bool LoadCollider(const BenchConfig& config, BenchCollider& bc, int numThreads)
+{
+    if (!config.skelFile.empty())
+    {
+        bc.skel = std::make_unique<Skeleton>(config.skelFile);
+        bc.skel->update(glm::mat4(1.0f));
+        if (!config.animFile.empty())
+        {
+            bc.anim = std::make_unique<Animation>(config.animFile);
+            bc.character = std::make_unique<Character>(bc.skel.get(), bc.anim.get());
+        }
+    }
+
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    bc.shift = glm::vec3(0.0f);
+    if (config.boxes)
+    {
+        if (!bc.skel) return false;
+        bc.boxes = std::make_unique<BoxCollider>(bc.skel.get());
+        if (bc.boxes->GetNumBoxes() == 0) return false;
+        lo = bc.boxes->GetMin();
+        hi = bc.boxes->GetMax();
+    }
+    else
+    {
+        if (config.colliderFile.empty()) return false;
+        bc.skin = std::make_unique<Skin>(config.colliderFile, bc.skel.get());
+        if (bc.skin->getTriangles().empty()) return false;
+        if (bc.skel) bc.skin->update();
+        for (const glm::vec3& p : ShiftedPositions(bc))
+        {
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+    }
+
+    bc.shift = glm::vec3(-0.5f * (lo.x + hi.x), 1.0f - 0.5f * (lo.y + hi.y), -0.1f - hi.z);
+    if (bc.boxes)
+    {
+        bc.boxes->SetPlacement(glm::translate(bc.shift));
+        bc.boxes->Update(0.0f);
+    }
+    else if (config.sdf)
+    {
+        glm::vec3 extent = hi - lo;
+        float cell = config.sdfCell > 0.0f ? config.sdfCell : std::max(extent.x, std::max(extent.y, extent.z)) / 64.0f;
+        auto start = std::chrono::steady_clock::now();
+        bc.sdf = std::make_unique<DistanceCollider>(ShiftedPositions(bc), bc.skin->getTriangles(), cell, config.sdfCache, numThreads);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const DistanceField& field = bc.sdf->GetField();
+        std::cout << "distance field: " << field.GetNumBlocks() << " blocks, " << field.GetMemoryBytes() / 1024 << " KB, "
+            << (bc.sdf->IsFromCache() ? "loaded" : "built") << " in " << ms << " ms" << std::endl;
+    }
+    else bc.collider = std::make_unique<MeshCollider>(ShiftedPositions(bc), bc.skin->getTriangles());
+    return true;
+}
+
+// RunBenchmark: Simulates the configured cloths with the given number of threads and prints the timings.
+static void RunBenchmark(const BenchConfig& config, int numThreads)
+{
+    // The grid solver needs no explicit springs or triangles, which keeps very large cloths small.
+    bool implicitTopology = config.solver == SOLVER_GRID;
+    ClothWorld world;
+    world.SetWindVelocity(config.wind);
+    world.SetSolverMode(config.solver);
+    world.SetNumThreads(numThreads);
+    MeshCloth mesh;
+    if (!config.meshFile.empty()) mesh = LoadMeshCloth(config.meshFile, config.shuffle);
+    BenchCollider collider;
+    if ((!config.colliderFile.empty() || config.boxes) && LoadCollider(config, collider, numThreads))
+    {
+        if (collider.boxes) world.AddCollider(collider.boxes.get());
+        else if (collider.sdf) world.AddCollider(collider.sdf.get());
+        else world.AddCollider(collider.collider.get());
+    }
+    for (int c = 0; c < config.cloths; c++)
+    {
+        Cloth* cloth;
+        if (!mesh.positions.empty())
+        {
+            std::vector<glm::vec3> positions = mesh.positions;
+            for (glm::vec3& p : positions) p.x += c * mesh.width * 1.5f;
+            cloth = world.AddCloth(positions, mesh.triangles, config.mass, mesh.pinned, config.order);
+        }
+        else
+        {
+            // Side by side along x, so the cloths are easy to tell apart in a trace.
+            int N = std::max(2, config.N >> (c % 3));
+            float size = config.size * N / config.N;
+            glm::vec3 pos(-config.size / 2 + c * config.size * 1.5f, 3.0f, 0.0f);
+            cloth = world.AddCloth(size, config.mass * (size / config.size) * (size / config.size), N, pos, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), implicitTopology);
+            cloth->GetGridSolver().SetBlocking(config.blockSubsteps);
+            cloth->GetSleepTracker().SetEnabled(config.sleep);
+        }
+        cloth->GetImplicitSolver().SetPreconditioner(config.precond);
+        cloth->GetSelfCollision().SetEnabled(config.selfCollision);
+        if (config.thickness > 0.0f) cloth->GetSelfCollision().SetThickness(config.thickness);
+        if (config.substeps > 0)
+        {
+            cloth->SetAdaptiveSubsteps(false);
+            cloth->SetNumOfOversamples(config.substeps);
+            cloth->SetImplicitSubsteps(config.substeps);
+            cloth->SetXPBDSubsteps(config.substeps);
+        }
+    }
+
+    // Exactly one fixed step per frame.
+    SimulationClock clock(config.dt, 1);
+
+    Profiler& profiler = Profiler::Shared();
+    profiler.ResetTotals();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < config.frames; frame++)
+    {
+        clock.BeginFrame(config.dt);
+        if (collider.character && !collider.sdf)
+        {
+            float elapsed = clock.GetSteps() * clock.GetFixedDt();
+            collider.character->update(clock);
+            if (collider.boxes) collider.boxes->Update(elapsed);
+            else
+            {
+                collider.skin->update();
+                collider.collider->Update(ShiftedPositions(collider), elapsed, numThreads);
+            }
+        }
+        world.Update(clock);
+        profiler.EndFrame();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long long substeps = 0;
+    int numSleeping = 0, numTiles = 0;
+    for (int c = 0; c < world.GetNumCloths(); c++)
+    {
+        substeps += world.GetCloth(c)->GetTotalSubsteps();
+        numSleeping += world.GetCloth(c)->GetSleepTracker().GetNumSleeping();
+        numTiles += world.GetCloth(c)->GetSleepTracker().GetNumTiles();
+    }
+    double particleSubsteps = world.GetTotalParticleSubsteps();
+
+    printf("threads %d: %d frames, %lld substeps (%.1f per frame), %.3f s\n",
+        world.GetNumThreads(), config.frames, substeps, (double)substeps / config.frames, wall);
+    printf("  %-10s %12s %12s %8s\n", "phase", "total ms", "ms/frame", "share");
+    for (int p = 0; p < NUM_PROFILE_PHASES; p++)
+    {
+        double t = profiler.GetTotal((ProfilePhase)p);
+        if (t == 0.0) continue;
+        printf("  %-10s %12.2f %12.4f %7.1f%%\n", Profiler::GetPhaseName((ProfilePhase)p), t * 1e3, t * 1e3 / config.frames, 100.0 * t / wall);
+    }
+    printf("  throughput: %.3e particle-substeps/s, %.1f frames/s\n", particleSubsteps / wall, config.frames / wall);
+    if (!mesh.positions.empty())
+    {
+        // Locality of the input order against the chosen one.
+        static const char* orderNames[] = { "none", "morton", "hilbert", "rcm" };
+        Cloth input(mesh.positions, mesh.triangles, config.mass, mesh.pinned, MESH_ORDER_NONE);
+        MeshLocalityReport before = input.GetLocalityReport();
+        MeshLocalityReport after = world.GetCloth(0)->GetLocalityReport();
+        printf("  %-10s %12s %12s %12s %12s\n", "order", "mean span", "bandwidth", "miss/spring", "miss/tri");
+        printf("  %-10s %12.1f %12d %12.3f %12.3f\n", "input", before.averageSpan, before.bandwidth, before.springMisses, before.triangleMisses);
+        printf("  %-10s %12.1f %12d %12.3f %12.3f\n", orderNames[config.order], after.averageSpan, after.bandwidth, after.springMisses, after.triangleMisses);
+    }
+    if (world.GetNumCloths() > 1) printf("  %d cloths, %d particles, %d stepped concurrently\n", world.GetNumCloths(), world.GetNumParticles(), world.GetLastConcurrent());
+    if (numSleeping > 0) printf("  sleeping tiles at the end: %d of %d\n", numSleeping, numTiles);
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        // ru_maxrss is in kilobytes on Linux and in bytes on macOS.
+#ifdef __APPLE__
+        double peakMB = usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+        double peakMB = usage.ru_maxrss / 1024.0;
+#endif
+        printf("  peak memory: %.1f MB\n", peakMB);
+    }
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig config;
+    if (!ParseArgs(argc, argv, config))
+    {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (config.threads.empty()) config.threads.push_back(ThreadPool::Shared().GetNumThreads());
+
+    static const char* solverNames[] = { "explicit", "implicit", "xpbd", "projective", "grid" };
+    printf("%d cloth(s) up to %dx%d (%d particles), size %.2f, dt %.4f s, solver %s, wind (%.2f, %.2f, %.2f), %s SIMD kernel\n",
+        config.cloths, config.N, config.N, config.N * config.N, config.size, config.dt, solverNames[config.solver],
+        config.wind.x, config.wind.y, config.wind.z, GetSpringKernelName(GetSpringKernel()));
+
+    Profiler::Shared().SetEnabled(true);
+    for (int t : config.threads)
+    {
+        RunBenchmark(config, t);
+    }
+
+    if (!config.csvFile.empty() && !Profiler::Shared().WriteCSV(config.csvFile))
+    {
+        std::cerr << "Cannot write " << config.csvFile << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!config.traceFile.empty() && !Profiler::Shared().WriteChromeTrace(config.traceFile))
+    {
+        std::cerr << "Cannot write " << config.traceFile << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
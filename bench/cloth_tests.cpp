@@ -0,0 +1,332 @@
+#include "Particle.h"
+#include "SpringDamper.h"
+#include "Coloring.h"
+#include "ThreadPool.h"
+#include "GridSolver.h"
+#include "ImplicitSolver.h"
+#include "ClothWorld.h"
+
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+
+// Equivalence and convergence checks of the solver kernels, one ctest per case: cloth_tests <case>.
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; failures++; } } while (0)
+
+// Tilted, slightly stretched N x N grid with structural and shear springs, moving so damping does work.
+struct TestGrid
+{
+	ParticleSystem ps;
+	std::vector<SpringDamper> structural, shear;
+	float rest;
+
+	TestGrid(int N)
+	{
+		float gridLength = 4.0f / (N - 1);
+		rest = gridLength * 0.95f;
+		ps.Resize(N * N, 100.0f / (N * N));
+		for (int y = 0; y < N; y++)
+		{
+			for (int x = 0; x < N; x++)
+			{
+				int i = x + y * N;
+				ps.SetPosition(i, glm::vec3(x * gridLength, 3.0f - y * gridLength * 0.8f, y * gridLength * 0.6f + 0.01f * (i % 5)));
+				ps.vx[i] = 0.01f * (i % 7);
+				ps.vy[i] = -0.02f * (i % 3);
+			}
+		}
+		for (int y = 0; y < N; y++)
+		{
+			for (int x = 0; x < N; x++)
+			{
+				int i = x + y * N;
+				if (x < N - 1) structural.push_back({ i, i + 1, rest });
+				if (y < N - 1) structural.push_back({ i, i + N, rest });
+				if (x < N - 1 && y < N - 1)
+				{
+					shear.push_back({ i, i + N + 1, rest * 1.4142136f });
+					shear.push_back({ i + 1, i + N, rest * 1.4142136f });
+				}
+			}
+		}
+		for (int x = 0; x < N; x++) ps.SetFixed(x, true, 0.0f);
+	}
+
+	// Spring and damping forces of all springs with the selected kernel.
+	void ComputeForces(float k, float c)
+	{
+		ps.ResetForces();
+		ComputeSpringForces(ps, structural, k, c);
+		ComputeSpringForces(ps, shear, k, c);
+	}
+};
+
+// Particle and SpringDamper::ComputeForce as they were before the springs were packed, kept as the reference.
+struct LegacyParticle
+{
+	glm::vec3 position, velocity, force;
+
+	glm::vec3 GetPosition() { return position; }
+	glm::vec3 GetVelocity() { return velocity; }
+	void ApplyForce(glm::vec3 f) { force += f; }
+};
+
+struct LegacySpringDamper
+{
+	const float *SpringConst, *DampingConst;
+	const float *RestLength;
+	LegacyParticle *P1, *P2;
+
+	void ComputeForce()
+	{
+		glm::vec3 dir = P2->GetPosition() - P1->GetPosition();
+		float currLength = glm::length(dir);
+
+		if (currLength > EPSILON)
+		{
+			dir = glm::normalize(dir);
+		}
+		else
+		{
+			dir = glm::vec3(0.0f);
+			currLength = 0.0f;
+		}
+
+		glm::vec3 f_spring = -(*SpringConst) * ((*RestLength) - currLength) * dir;
+		if (f_spring.length() < EPSILON) f_spring = glm::vec3(0.0f);
+
+		float v = glm::dot(P1->GetVelocity() - P2->GetVelocity(), dir);
+		glm::vec3 f_damper = -(*DampingConst) * v * dir;
+		if (f_damper.length() < EPSILON) f_damper = glm::vec3(0.0f);
+
+		P1->ApplyForce(f_spring + f_damper);
+		P2->ApplyForce(-f_spring - f_damper);
+	}
+};
+
+// SpringPacked: The packed scalar kernel gives the same forces, bit for bit, as the per-object springs it replaced.
+static void SpringPacked()
+{
+	TestGrid grid(32);
+	float k = 1000.0f, c = 3.5f;
+
+	std::vector<LegacyParticle> particles(grid.ps.Size());
+	for (int i = 0; i < grid.ps.Size(); i++) particles[i] = { grid.ps.GetPosition(i), grid.ps.GetVelocity(i), glm::vec3(0.0f) };
+	std::vector<float> restLengths;
+	for (const std::vector<SpringDamper>* springs : { &grid.structural, &grid.shear })
+	{
+		for (const SpringDamper& sp : *springs) restLengths.push_back(sp.restLength);
+	}
+	int r = 0;
+	for (const std::vector<SpringDamper>* springs : { &grid.structural, &grid.shear })
+	{
+		for (const SpringDamper& sp : *springs)
+		{
+			LegacySpringDamper legacy = { &k, &c, &restLengths[r++], &particles[sp.i], &particles[sp.j] };
+			legacy.ComputeForce();
+		}
+	}
+
+	SetSpringKernel(SPRING_KERNEL_SCALAR);
+	grid.ComputeForces(k, c);
+	SetSpringKernel(GetBestSpringKernel());
+
+	for (int i = 0; i < grid.ps.Size(); i++)
+	{
+		CHECK(grid.ps.fx[i] == particles[i].force.x);
+		CHECK(grid.ps.fy[i] == particles[i].force.y);
+		CHECK(grid.ps.fz[i] == particles[i].force.z);
+	}
+}
+
+// SpringSimd: Every SIMD kernel the CPU supports gives the same forces, bit for bit, as the scalar one.
+static void SpringSimd()
+{
+	TestGrid grid(33);
+	const float k = 1000.0f, c = 3.5f;
+
+	SetSpringKernel(SPRING_KERNEL_SCALAR);
+	grid.ComputeForces(k, c);
+	std::vector<float> fx = grid.ps.fx, fy = grid.ps.fy, fz = grid.ps.fz;
+
+	for (int kernel = SPRING_KERNEL_SCALAR + 1; kernel <= GetBestSpringKernel(); kernel++)
+	{
+		SetSpringKernel((SpringKernel)kernel);
+		CHECK(GetSpringKernel() == kernel);
+		grid.ComputeForces(k, c);
+		CHECK(grid.ps.fx == fx);
+		CHECK(grid.ps.fy == fy);
+		CHECK(grid.ps.fz == fz);
+	}
+	SetSpringKernel(GetBestSpringKernel());
+}
+
+// ColoringFan: A fan of 150 triangles around one particle needs more than 64 colors, and no color may touch a
+// particle twice.
+static void ColoringFan()
+{
+	const int spokes = 150;
+	std::vector<glm::ivec3> tris;
+	for (int s = 0; s < spokes; s++) tris.push_back(glm::ivec3(0, 1 + s, 1 + (s + 1) % spokes));
+
+	std::vector<int> colors;
+	int numColors = ColorElements(spokes + 1, (int)tris.size(), [&](int e, int* verts)
+		{
+			verts[0] = tris[e].x;
+			verts[1] = tris[e].y;
+			verts[2] = tris[e].z;
+			return 3;
+		}, colors);
+	CHECK(numColors >= spokes);
+
+	std::map<std::pair<int, int>, int> touched;
+	for (size_t e = 0; e < tris.size(); e++)
+	{
+		for (int k = 0; k < 3; k++) CHECK(++touched[std::make_pair(tris[e][k], colors[e])] == 1);
+	}
+}
+
+// ThreadPoolJobs: Many small back-to-back jobs on a private pool. Every index runs exactly once, and no task of a
+// job is still running when ParallelFor returns.
+static void ThreadPoolJobs()
+{
+	ThreadPool pool(8);
+	std::atomic<int> running(0);
+	int wrong = 0, late = 0;
+	for (int job = 0; job < 100000; job++)
+	{
+		int count = 1 + job % 37;
+		std::vector<std::atomic<int>> hits(count);
+		for (auto& h : hits) h = 0;
+		pool.ParallelFor(count, 8, [&](int begin, int end)
+			{
+				running++;
+				for (int i = begin; i < end; i++) hits[i]++;
+				running--;
+			});
+		if (running != 0) late++;
+		for (auto& h : hits) wrong += h != 1;
+	}
+	CHECK(wrong == 0);
+	CHECK(late == 0);
+}
+
+// GridThreads: The grid solver gives bit-identical positions for any band count, with and without temporal blocking.
+static void GridThreads()
+{
+	const int N = 128, substeps = 12;
+	GridParams params = {};
+	params.springConst = 1000.0f;
+	params.dampingConst = 3.5f;
+	params.fluidDensity = 1.225f;
+	params.dragConst = 1.0f;
+	params.windVelocity = glm::vec3(0.5f, 0.5f, -2.5f);
+	params.gravityAcce = -9.8f;
+	params.groundPos = -10.0f;
+
+	std::vector<float> reference;
+	for (int block : { 1, 4 })
+	{
+		for (int threads : { 1, 2, 3, 8 })
+		{
+			TestGrid grid(N);
+			params.restLength = grid.rest;
+			params.restLengthDiag = grid.rest * 1.4142136f;
+
+			GridSolver solver;
+			solver.Build(N, N);
+			solver.SetBlocking(block);
+			solver.Step(grid.ps, 1e-4f, substeps, params, threads);
+
+			std::vector<float> state = grid.ps.px;
+			state.insert(state.end(), grid.ps.py.begin(), grid.ps.py.end());
+			state.insert(state.end(), grid.ps.vz.begin(), grid.ps.vz.end());
+			if (reference.empty()) reference = state;
+			bool identical = memcmp(state.data(), reference.data(), state.size() * sizeof(float)) == 0;
+			if (!identical) std::cerr << "block " << block << ", " << threads << " threads differ" << std::endl;
+			CHECK(identical);
+		}
+	}
+}
+
+// MultigridConvergence: Multigrid-preconditioned CG converges and its iteration count barely grows with the grid,
+// where block Jacobi's keeps growing.
+static void MultigridConvergence()
+{
+	int first[2] = { 0, 0 }, last[2] = { 0, 0 };
+	for (int N : { 32, 128 })
+	{
+		for (ImplicitPreconditioner precond : { PRECOND_BLOCK_JACOBI, PRECOND_MULTIGRID })
+		{
+			TestGrid grid(N);
+			ImplicitSolver solver;
+			solver.Build(grid.ps.Size(), { &grid.structural, &grid.shear });
+			solver.SetGrid(N, N);
+			solver.SetPreconditioner(precond);
+			solver.SetMaxIterations(1000);
+			solver.Step(grid.ps, 1.0f / 60.0f, 1000.0f, 3.5f, -9.8f, -10.0f, 1);
+
+			CHECK(solver.GetLastIterations() < solver.GetMaxIterations());
+			CHECK(solver.GetLastResidual() <= solver.GetTolerance());
+			(N == 32 ? first : last)[precond] = solver.GetLastIterations();
+		}
+	}
+	CHECK(last[PRECOND_MULTIGRID] < last[PRECOND_BLOCK_JACOBI] / 2);
+	CHECK(last[PRECOND_MULTIGRID] <= 2 * first[PRECOND_MULTIGRID]);
+}
+
+// WorldThreads: A world limited to one thread steps every cloth with one thread, whether the cloths run
+// concurrently or one is left on its own.
+static void WorldThreads()
+{
+	for (int numCloths : { 1, 3 })
+	{
+		ClothWorld world;
+		world.SetNumThreads(1);
+		for (int c = 0; c < numCloths; c++) world.AddCloth(1.0f, 1.0f, 16, glm::vec3((float)c, 2.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+
+		SimulationClock clock;
+		clock.BeginFrame(1.0 / 60.0);
+		world.Update(clock);
+		for (int c = 0; c < numCloths; c++) CHECK(world.GetCloth(c)->GetNumThreads() == 1);
+	}
+}
+
+// MeshSleep: The sleep tracker of a mesh cloth cannot be turned back on.
+static void MeshSleep()
+{
+	std::vector<glm::vec3> positions = { glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f) };
+	std::vector<glm::ivec3> triangles = { glm::ivec3(0, 2, 3), glm::ivec3(0, 3, 1) };
+	Cloth cloth(positions, triangles, 1.0f, { 0, 1 });
+	cloth.GetSleepTracker().SetEnabled(true);
+	CHECK(!cloth.GetSleepTracker().GetEnabled());
+	CHECK(!cloth.GetSleepTracker().CanSleep());
+}
+
+int main(int argc, char* argv[])
+{
+	std::map<std::string, std::function<void()>> tests = {
+		{ "spring_packed", SpringPacked },
+		{ "spring_simd", SpringSimd },
+		{ "coloring_fan", ColoringFan },
+		{ "thread_pool_jobs", ThreadPoolJobs },
+		{ "grid_threads", GridThreads },
+		{ "multigrid_convergence", MultigridConvergence },
+		{ "world_threads", WorldThreads },
+		{ "mesh_sleep", MeshSleep },
+	};
+
+	if (argc != 2 || !tests.count(argv[1]))
+	{
+		std::cerr << "Usage: " << argv[0] << " <test>\n";
+		for (const auto& test : tests) std::cerr << "  " << test.first << "\n";
+		return EXIT_FAILURE;
+	}
+	tests[argv[1]]();
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,382 @@
+#include "MicroBench.h"
+
+#include "Particle.h"
+#include "SpringDamper.h"
+#include "Triangle.h"
+#include "VertexNormals.h"
+#include "Skin.h"
+#include "Animation.h"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+// Microbenchmarks of the cloth, skinning and animation kernels in isolation, reported as JSON.
+
+#ifndef CLOTH_DATA_DIR
+#define CLOTH_DATA_DIR "."
+#endif
+
+// Cloth grid of N x N particles with structural and shear springs and two triangles per cell.
+// Springs are slightly stretched and the cloth is tilted so every kernel does real work.
+struct ClothGrid
+{
+	ParticleSystem particleSystem;
+	std::vector<Particle> particles;
+	std::vector<SpringDamper> springs;
+	std::vector<Triangle*> triangles;
+	std::vector<glm::ivec3> indices;
+	int width;
+
+	VertexTriangleAdjacency adjacency;
+	std::vector<glm::vec3> faceNormals;
+
+	float FluidDensity = 1.225f;
+	float C_d = 1.0f;
+	glm::vec3 WindVelocity = glm::vec3(0.5f, 0.5f, -2.5f);
+
+	ClothGrid(int N) : width(N)
+	{
+		float gridLength = 4.0f / (N - 1);
+		particleSystem.Resize(N * N, 100.0f / (N * N));
+		particles.reserve(N * N);
+		for (int y = 0; y < N; y++)
+		{
+			for (int x = 0; x < N; x++)
+			{
+				int i = x + y * N;
+				particleSystem.SetPosition(i, glm::vec3(x * gridLength, 3.0f - y * gridLength * 0.8f, y * gridLength * 0.6f));
+				particleSystem.vx[i] = 0.01f * (i % 7);
+				particles.push_back(Particle(&particleSystem, i));
+			}
+		}
+
+		for (int y = 0; y < N - 1; y++)
+		{
+			for (int x = 0; x < N - 1; x++)
+			{
+				int tl = x + y * N, tr = tl + 1, bl = tl + N, br = bl + 1;
+				float rest = gridLength * 0.95f;
+				springs.push_back({ tl, tr, rest });
+				springs.push_back({ tl, bl, rest });
+				springs.push_back({ tl, br, rest * 1.4142136f });
+				springs.push_back({ bl, tr, rest * 1.4142136f });
+				triangles.push_back(new Triangle(&particles[tl], &particles[bl], &particles[br], &FluidDensity, &C_d, &WindVelocity));
+				triangles.push_back(new Triangle(&particles[tl], &particles[br], &particles[tr], &FluidDensity, &C_d, &WindVelocity));
+				indices.push_back(glm::ivec3(tl, bl, br));
+				indices.push_back(glm::ivec3(tl, br, tr));
+			}
+		}
+
+		adjacency.Build(N * N, indices);
+		faceNormals.resize(indices.size());
+	}
+
+	~ClothGrid()
+	{
+		for (Triangle* tri : triangles) delete tri;
+	}
+};
+
+// WriteReplicatedSkin: Writes a copy of a .skin file whose mesh is repeated 'copies' times over the same skeleton.
+static bool WriteReplicatedSkin(const std::string& source, const std::string& target, int copies)
+{
+	std::ifstream in(source);
+	if (!in) return false;
+
+	// Split the file into its sections, one entry per line.
+	std::map<std::string, std::vector<std::string>> sections;
+	std::string bindings;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		std::stringstream header(line);
+		std::string name;
+		header >> name;
+		if (name.empty()) continue;
+
+		if (name == "bindings")
+		{
+			bindings = line + "\n";
+			while (std::getline(in, line)) bindings += line + "\n";
+			break;
+		}
+		std::vector<std::string>& entries = sections[name];
+		while (std::getline(in, line) && line.find('}') == std::string::npos) entries.push_back(line);
+	}
+
+	std::ofstream out(target);
+	if (!out) return false;
+	int numVerts = (int)sections["positions"].size();
+	for (const char* name : { "positions", "normals", "skinweights", "triangles" })
+	{
+		const std::vector<std::string>& entries = sections[name];
+		out << name << " " << entries.size() * copies << " {\n";
+		for (int c = 0; c < copies; c++)
+		{
+			for (const std::string& entry : entries)
+			{
+				if (strcmp(name, "triangles") == 0)
+				{
+					// Each copy indexes its own vertices.
+					std::stringstream tri(entry);
+					int a, b, d;
+					tri >> a >> b >> d;
+					int o = c * numVerts;
+					out << "  " << a + o << " " << b + o << " " << d + o << "\n";
+				}
+				else
+				{
+					out << entry << "\n";
+				}
+			}
+		}
+		out << "}\n";
+	}
+	out << bindings;
+	return true;
+}
+
+// PrintUsage: Lists the command-line options.
+static void PrintUsage(const char* name)
+{
+	std::cout << "Usage: " << name << " [options]\n"
+		<< "  --filter <text>    only run benchmarks whose name contains text\n"
+		<< "  --min-time <s>     minimum time per benchmark (default 0.2)\n"
+		<< "  --max-n <int>      largest cloth grid (default 1024)\n"
+		<< "  --data <dir>       directory holding skelFile, skinFile and animFile (default source tree)\n"
+		<< "  --out <file>       write the JSON report to a file instead of stdout\n";
+}
+
+int main(int argc, char* argv[])
+{
+	std::string filter, outFile;
+	std::string dataDir = CLOTH_DATA_DIR;
+	double minTime = 0.2;
+	int maxN = 1024;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string opt = argv[i];
+		if (i + 1 >= argc || opt == "--help" || opt == "-h")
+		{
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		const char* value = argv[++i];
+		if (opt == "--filter") filter = value;
+		else if (opt == "--min-time") minTime = atof(value);
+		else if (opt == "--max-n") maxN = atoi(value);
+		else if (opt == "--data") dataDir = value;
+		else if (opt == "--out") outFile = value;
+		else
+		{
+			std::cerr << "Unknown option " << opt << std::endl;
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	MicroBench bench(filter, minTime);
+	bench.AddContext("num_cpus", std::to_string(std::thread::hardware_concurrency()));
+	bench.AddContext("spring_kernel", GetSpringKernelName(GetBestSpringKernel()));
+#ifdef NDEBUG
+	bench.AddContext("library_build_type", "release");
+#else
+	bench.AddContext("library_build_type", "debug");
+#endif
+
+	// Cloth kernels over a range of grid sizes.
+	for (int N : { 25, 64, 128, 256, 512, 1024 })
+	{
+		if (N > maxN) break;
+		std::string size = "/" + std::to_string(N);
+
+		// Skip building grids no selected benchmark uses.
+		std::vector<std::string> names = { "aero" + size, "aero_normals" + size, "normals_scatter" + size, "normals_gather" + size, "normals_stencil" + size };
+		for (int k = SPRING_KERNEL_SCALAR; k <= GetBestSpringKernel(); k++)
+		{
+			names.push_back(std::string("spring/") + GetSpringKernelName((SpringKernel)k) + size);
+		}
+		if (std::none_of(names.begin(), names.end(), [&](const std::string& name) { return bench.Matches(name); })) continue;
+
+		ClothGrid grid(N);
+
+		// Every spring kernel the CPU supports, all compute identical forces.
+		for (int k = SPRING_KERNEL_SCALAR; k <= GetBestSpringKernel(); k++)
+		{
+			SetSpringKernel((SpringKernel)k);
+			std::string name = std::string("spring/") + GetSpringKernelName((SpringKernel)k) + size;
+			bench.Run(name, [&](BenchState& state)
+				{
+					state.SetItemsPerIteration(grid.springs.size());
+					while (state.KeepRunning())
+					{
+						ComputeSpringForces(grid.particleSystem, grid.springs, 1000.0f, 3.5f);
+						DoNotOptimize(grid.particleSystem.fx[0]);
+					}
+					grid.particleSystem.ResetForces();
+				});
+		}
+		SetSpringKernel(GetBestSpringKernel());
+
+		bench.Run("aero" + size, [&](BenchState& state)
+			{
+				state.SetItemsPerIteration(grid.triangles.size());
+				while (state.KeepRunning())
+				{
+					for (Triangle* tri : grid.triangles) tri->ComputeAerodynamicForce();
+					DoNotOptimize(grid.particleSystem.fx[0]);
+				}
+				grid.particleSystem.ResetForces();
+			});
+
+		// Aero pass of the last substep, which also stores the face normals for the gather.
+		bench.Run("aero_normals" + size, [&](BenchState& state)
+			{
+				glm::vec3* normals = grid.particleSystem.normals.data();
+				state.SetItemsPerIteration(grid.triangles.size());
+				while (state.KeepRunning())
+				{
+					for (size_t t = 0; t < grid.triangles.size(); t++) grid.triangles[t]->ComputeAerodynamicForce(&grid.faceNormals[t]);
+					GatherVertexNormals(grid.adjacency, grid.faceNormals.data(), normals, 0, grid.particleSystem.Size());
+					DoNotOptimize(grid.particleSystem.fx[0]);
+				}
+				grid.particleSystem.ResetForces();
+			});
+
+		// Reference scatter: every triangle adds its normal to its corners, which needs colored batches to run in parallel.
+		bench.Run("normals_scatter" + size, [&](BenchState& state)
+			{
+				std::vector<glm::vec3>& normals = grid.particleSystem.normals;
+				state.SetItemsPerIteration(grid.particleSystem.Size());
+				while (state.KeepRunning())
+				{
+					for (auto& n : normals) n = glm::vec3(0.0f);
+					for (const glm::ivec3& t : grid.indices)
+					{
+						glm::vec3 p1 = grid.particleSystem.GetPosition(t.x);
+						glm::vec3 n = glm::cross(grid.particleSystem.GetPosition(t.y) - p1, grid.particleSystem.GetPosition(t.z) - p1);
+						normals[t.x] += n;
+						normals[t.y] += n;
+						normals[t.z] += n;
+					}
+					for (auto& n : normals) n = glm::normalize(n);
+					DoNotOptimize(normals[0]);
+				}
+			});
+
+		// Face normals followed by the per-vertex gather through the CSR adjacency.
+		bench.Run("normals_gather" + size, [&](BenchState& state)
+			{
+				glm::vec3* normals = grid.particleSystem.normals.data();
+				state.SetItemsPerIteration(grid.particleSystem.Size());
+				while (state.KeepRunning())
+				{
+					ComputeFaceNormals(grid.particleSystem, grid.indices.data(), grid.faceNormals.data(), 0, (int)grid.indices.size());
+					GatherVertexNormals(grid.adjacency, grid.faceNormals.data(), normals, 0, grid.particleSystem.Size());
+					DoNotOptimize(normals[0]);
+				}
+			});
+
+		// Grid stencil, which Cloth::Update runs when no fused aero pass happened.
+		bench.Run("normals_stencil" + size, [&](BenchState& state)
+			{
+				glm::vec3* normals = grid.particleSystem.normals.data();
+				state.SetItemsPerIteration(grid.particleSystem.Size());
+				while (state.KeepRunning())
+				{
+					ComputeGridNormals(grid.particleSystem, grid.width, grid.width, normals, 0, grid.width);
+					DoNotOptimize(normals[0]);
+				}
+			});
+	}
+
+	// Skinning on the wasp and on larger meshes made of copies of it.
+	if (bench.Matches("skin"))
+	{
+		Skeleton skel(dataDir + "/skelFile/wasp.skel");
+		for (int copies : { 1, 16, 256 })
+		{
+			std::string skinFile = dataDir + "/skinFile/wasp.skin";
+			std::string tempFile = "micro_bench_wasp_x" + std::to_string(copies) + ".skin";
+			if (copies > 1)
+			{
+				if (!WriteReplicatedSkin(skinFile, tempFile, copies)) continue;
+				skinFile = tempFile;
+			}
+
+			Skin skin(skinFile, &skel);
+			if (copies > 1) std::remove(tempFile.c_str());
+
+			bench.Run("skin/wasp_x" + std::to_string(copies), [&](BenchState& state)
+				{
+					state.SetItemsPerIteration(skin.getPositions().size());
+					while (state.KeepRunning())
+					{
+						skin.update();
+						DoNotOptimize(skin.getPositions()[0]);
+					}
+				});
+
+			// Same skinning with the normals gathered from the deformed triangles.
+			skin.setGatherNormals(true);
+			bench.Run("skin_gather/wasp_x" + std::to_string(copies), [&](BenchState& state)
+				{
+					state.SetItemsPerIteration(skin.getPositions().size());
+					while (state.KeepRunning())
+					{
+						skin.update();
+						DoNotOptimize(skin.getNormals()[0]);
+					}
+				});
+		}
+	}
+
+	// Forward kinematics through BallJoint::update on the largest skeleton.
+	if (bench.Matches("fk"))
+	{
+		Skeleton skel(dataDir + "/skelFile/dragon.skel");
+		bench.Run("fk/dragon", [&](BenchState& state)
+			{
+				state.SetItemsPerIteration(skel.getNumOfJoint());
+				while (state.KeepRunning())
+				{
+					skel.update(glm::mat4(1.0f));
+					DoNotOptimize(skel.getWorldMat(0));
+				}
+			});
+	}
+
+	// Channel::evaluate sampled across the clip and into its extrapolated range.
+	if (bench.Matches("channel"))
+	{
+		Animation anim(dataDir + "/animFile/wasp_walk.anim");
+		const int numSamples = 256;
+		float t0 = anim.getTimeStart() - 1.0f;
+		float dt = (anim.getTimeEnd() - anim.getTimeStart() + 2.0f) / numSamples;
+		bench.Run("channel/wasp_walk", [&](BenchState& state)
+			{
+				state.SetItemsPerIteration((int64_t)anim.getNumOfChannel() * numSamples);
+				while (state.KeepRunning())
+				{
+					float sum = 0.0f;
+					for (size_t c = 0; c < anim.getNumOfChannel(); c++)
+					{
+						Channel* channel = anim.getChannel((int)c);
+						for (int s = 0; s < numSamples; s++) sum += channel->evaluate(t0 + s * dt);
+					}
+					DoNotOptimize(sum);
+				}
+			});
+	}
+
+	FILE* file = outFile.empty() ? stdout : fopen(outFile.c_str(), "w");
+	if (file == nullptr)
+	{
+		std::cerr << "Cannot write " << outFile << std::endl;
+		return EXIT_FAILURE;
+	}
+	bench.WriteJSON(file);
+	if (file != stdout) fclose(file);
+	return EXIT_SUCCESS;
+}
@@ -1,7 +1,7 @@
 #pragma once
 
-#include "channel.h"
-#include "skeleton.h"
+#include "Channel.h"
+#include "Skeleton.h"
 
 class Animation
 {
@@ -17,4 +17,9 @@ public:
 
     void load(); // Loads the animation data from the specified file.
     void update(float& t, glm::mat4& T, Skeleton* skel); // Updates the skeleton based on the animation time 't'.
+
+    size_t getNumOfChannel() { return channels.size(); } // Number of keyframed channels.
+    Channel* getChannel(int i) { return channels[i]; } // Channel 'i', e.g. for evaluating it directly.
+    float getTimeStart() { return time_start; }
+    float getTimeEnd() { return time_end; }
 };
\ No newline at end of file
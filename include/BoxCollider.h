@@ -0,0 +1,62 @@
+#pragma once
+
+#include "MeshCollider.h"
+#include "Skeleton.h"
+
+// Oriented boxes of a skeleton's joints (boxmin/boxmax of the .skel file) that cloth particles collide with, a
+// far cheaper stand-in for the skinned mesh. Each frame the owner poses the skeleton and updates the collider,
+// which takes the joints' world transforms and derives how the boxes move. A particle is tested against a box
+// only if it lies in the box's world bounds; inside, it goes to joint space and leaves the box, grown by the
+// thickness, through the nearest face. Like MeshCollider it can be shared by any number of cloths.
+class BoxCollider
+{
+private:
+	struct Box
+	{
+		int joint;
+		glm::vec3 lo, hi; // Corners in joint space.
+		glm::mat4 loc2World, world2Loc;
+		glm::mat4 velocity; // Rate of change of loc2World, applied to a point in joint space it gives its velocity.
+	};
+
+	// World bounds of a box, kept apart from the boxes so that the broadphase reads them back to back.
+	struct Bounds
+	{
+		glm::vec3 lo, hi;
+	};
+
+	Skeleton* skel;
+	std::vector<Box> boxes;
+	std::vector<Bounds> boxBounds;
+	glm::vec3 boundsLo, boundsHi; // Union of the world bounds of the boxes.
+	glm::mat4 placement = glm::mat4(1.0f);
+
+	float thickness = 0.02f;
+	float friction = 0.5f;
+
+	void PoseBox(Box& box, Bounds& bounds, float elapsed);
+
+public:
+	// Takes the boxes of every joint in the skeleton's current pose, empty boxes are skipped.
+	BoxCollider(Skeleton* _skel);
+
+	// Takes the skeleton's pose after elapsed seconds of animation.
+	void Update(float elapsed);
+
+	// Moves a particle at x with velocity v out of the boxes after a substep of length deltaT.
+	// Returns whether it was in contact.
+	bool Collide(glm::vec3& x, glm::vec3& v, float deltaT) const;
+
+	// Whether the particle at x is in contact, without moving it.
+	bool Touches(const glm::vec3& x) const;
+
+	// Moves the whole skeleton in the world, the joint transforms are relative to it. Takes effect on the next update.
+	void SetPlacement(const glm::mat4& m) { placement = m; }
+	int GetNumBoxes() const { return (int)boxes.size(); }
+	glm::vec3 GetMin() const { return boundsLo; }
+	glm::vec3 GetMax() const { return boundsHi; }
+	void SetThickness(float h) { thickness = std::max(0.0f, h); }
+	float GetThickness() const { return thickness; }
+	void SetFriction(float mu) { friction = std::max(0.0f, mu); }
+	float GetFriction() const { return friction; }
+};
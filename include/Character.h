@@ -2,7 +2,7 @@
 
 #include "Animation.h"
 #include "Skeleton.h"
-#include <ctime> // Include for clock_t and clock() to measure time
+#include "SimulationClock.h"
 
 class Character
 {
@@ -10,8 +10,7 @@ private:
     Skeleton* skel; // Pointer to the skeleton of the character
     Animation* anim; // Pointer to the animation applied to the character
 
-    clock_t prevT; // Stores the previous time snapshot
-    float time; // Accumulated time to control the animation
+    float time; // Simulated time of the last fixed step, controls the animation
 
     std::vector<BallJoint*> joints; // Optional: Stores joints for more specific control or access
 
@@ -19,6 +18,9 @@ public:
     // Constructor: Initializes a character with a given skeleton and animation
     Character(Skeleton* _skel, Animation* _anim);
 
-    // Update function to progress the animation based on elapsed time
-    void update();
+    // Update function to progress the animation by the clock's fixed steps, posing the skeleton at the last step
+    void update(const SimulationClock& clock);
+
+    // Poses the skeleton at the interpolated time the cloth is drawn at, once the colliders and the cloth are updated
+    void updateRenderPose(const SimulationClock& clock);
 };
\ No newline at end of file
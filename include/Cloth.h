@@ -3,21 +3,65 @@
 #include "Particle.h"
 #include "SpringDamper.h"
 #include "Triangle.h"
-#include "Ground.h"
+#include "VertexNormals.h"
+#include "ThreadPool.h"
+#include "ImplicitSolver.h"
+#include "XPBDSolver.h"
+#include "ProjectiveSolver.h"
+#include "GridSolver.h"
+#include "SleepTracker.h"
+#include "ClothMesh.h"
+#include "SelfCollision.h"
+#include "MeshCollider.h"
+#include "BoxCollider.h"
+#include "DistanceCollider.h"
+#include "SimulationClock.h"
 
-#include <ctime>
+// Time integration schemes available to the cloth.
+enum SolverMode
+{
+	SOLVER_EXPLICIT,
+	SOLVER_IMPLICIT,
+	SOLVER_XPBD,
+	SOLVER_PROJECTIVE,
+	SOLVER_GRID
+};
+
+// Mass-spring cloth simulation. Holds no OpenGL state, so it can run headless; see ClothRenderer for drawing.
+// A cloth is either a square particle grid or an arbitrary triangle mesh. Mesh cloths have no grid layout, so they
+// cannot use the grid solver, the multigrid preconditioner or sleeping tiles; their sleep tracker ignores
+// SetEnabled(true).
 
 class Cloth
 {
 private:
 	std::vector<glm::vec3> positions;
-	std::vector<glm::vec3> normals;
+	std::vector<glm::vec3> prevPositions;
 	std::vector<glm::ivec3> indices;
 
-	std::vector<Particle*> particles;
-	std::vector<SpringDamper*> connections;
+	ParticleSystem particleSystem;
+	std::vector<Particle> particles;
+	std::vector<SpringDamper> structuralSprings;
+	std::vector<SpringDamper> shearSprings;
 	std::vector<Triangle*> triangles;
 
+	// Conflict-free color batches: batch c of an array is [offsets[c], offsets[c + 1]).
+	std::vector<int> structuralBatches;
+	std::vector<int> shearBatches;
+	std::vector<int> triangleBatches;
+
+	// Resting tiles of the explicit solver and the elements that still touch an awake particle,
+	// in the same color batches. Only used while any tile sleeps.
+	SleepTracker sleepTracker;
+	std::vector<SpringDamper> activeStructuralSprings;
+	std::vector<SpringDamper> activeShearSprings;
+	std::vector<int> activeTriangles;
+	std::vector<int> activeStructuralBatches;
+	std::vector<int> activeShearBatches;
+	std::vector<int> activeTriangleBatches;
+
+	int numThreads;
+
 	std::vector<int> fixedParticleIdx;
 
 	glm::vec3 topLeftPos;
@@ -27,8 +71,53 @@ private:
 	float size, mass;
 	int numOfParticles;
 
+	// Without explicit topology no spring, triangle or particle view lists are built and only the grid solver runs.
+	bool implicitTopology;
+
+	// Built from a triangle mesh, springs have individual rest lengths and particles individual masses.
+	bool meshTopology;
+
+	// Particle index of every input vertex of a mesh cloth after reordering.
+	std::vector<int> meshOrder;
+
 	int numOfOversamples;
 
+	// Adaptive substepping for the explicit solver.
+	bool adaptiveSubsteps;
+	int minSubsteps, maxSubsteps;
+	int maxSpringsPerParticle;
+	int lastSubsteps;
+	float averageSubsteps;
+	long long totalSubsteps;
+
+	// Set while the frame's last step runs, so its last aero pass also stores the face normals.
+	bool accumulateNormals;
+	bool normalsAccumulated;
+
+	// Face normals in triangle order and the incident triangles of every particle, for the vertex normal gather.
+	std::vector<glm::vec3> faceNormals;
+	VertexTriangleAdjacency normalAdjacency;
+
+	SolverMode solverMode;
+	ImplicitSolver implicitSolver;
+	int implicitSubsteps;
+	XPBDSolver xpbdSolver;
+	int xpbdSubsteps;
+	int xpbdIterations;
+	ProjectiveSolver projectiveSolver;
+	int projectiveIterations;
+	GridSolver gridSolver;
+
+	// Particle-triangle and edge-edge contacts within the cloth, off by default. Not available to the grid solver.
+	SelfCollision selfCollision;
+
+	// External bodies the cloth collides with, owned by the caller. Particles of sleeping tiles that touch one are
+	// flagged and woken after the step.
+	std::vector<const MeshCollider*> meshColliders;
+	std::vector<const BoxCollider*> boxColliders;
+	std::vector<const DistanceCollider*> distanceColliders;
+	std::vector<unsigned char> colliderWake;
+
 	//Add force
 	float FluidDensity;
 	float C_d;
@@ -41,69 +130,126 @@ private:
 
 	//particle
 	float particleMass;
+	std::vector<float> particleMasses; // Mass of every particle of a mesh cloth, also of the pinned ones.
     float gravityAcce;
 	float groundPos;
 
-	GLuint programID;
-	GLuint vao, vbos[2], ebo;
-
-	clock_t prevT;
-	clock_t interval = 0;
-	int FPSCount = 0;
-	int FPS = 0;
-
-	Ground* ground;
+	void SetDefaultCoefficients();
+	void InitializeMesh(std::vector<glm::vec3> meshPositions, std::vector<glm::ivec3> meshTriangles, std::vector<int> fixedParticles, MeshOrdering ordering);
+	void BuildElementSolvers();
+	void ColorBatches();
+	void UpdateActiveElements();
+	void Step(float deltaT);
+	int ComputeSubstepCount(float deltaT);
+	void StepExplicit(float deltaT);
+	void StepImplicit(float deltaT);
+	void StepXPBD(float deltaT);
+	void StepProjective(float deltaT);
+	void StepGrid(float deltaT);
+	void SolveSelfCollision(float deltaT);
+	void SolveColliders(float deltaT);
+	bool HasColliders() const { return !meshColliders.empty() || !boxColliders.empty() || !distanceColliders.empty(); }
+	void CountSubsteps(int substeps);
+	void ComputeAerodynamicForces(bool lastSubstep);
+	void ParallelForBatches(const std::vector<int>& offsets, const std::function<void(int, int)>& body);
 
 public:
-	Cloth(float _size, float _mass, int N, glm::vec3 pos, glm::vec3 hori, glm::vec3 vert, GLuint ID);
+	Cloth(float _size, float _mass, int N, glm::vec3 pos, glm::vec3 hori, glm::vec3 vert, bool _implicitTopology = false);
+	// Cloth from a triangle mesh, e.g. the positions and triangles of a .skin file. The listed vertices are pinned.
+	// The particles are renumbered by the ordering first, GetMeshOrder maps input vertices to particles.
+	Cloth(const std::vector<glm::vec3>& meshPositions, const std::vector<glm::ivec3>& meshTriangles, float _mass, const std::vector<int>& fixedParticles = {},
+		MeshOrdering ordering = MESH_ORDER_RCM);
 	~Cloth();
 
 	void Initialize();
 
-	void Update();
-	void Draw(const glm::mat4& viewProjMtx);
+	void Update(const SimulationClock& clock);
 
-	void SetMass(float m) 
-	{ 
-		mass = m; 
-		particleMass = mass / (numOfParticles * numOfParticles);
-	}
+	// Render state after the last Update: positions interpolated between steps, normals and triangle indices.
+	const std::vector<glm::vec3>& GetPositions() const { return positions; }
+	const std::vector<glm::vec3>& GetNormals() const { return particleSystem.normals; }
+	const std::vector<glm::ivec3>& GetIndices() const { return indices; }
+	int GetNumParticles() const { return particleSystem.Size(); }
+	int GetNumElements() const { return (int)(structuralSprings.size() + shearSprings.size() + triangles.size()); }
+	bool HasImplicitTopology() const { return implicitTopology; }
+	bool HasMeshTopology() const { return meshTopology; }
+	const std::vector<int>& GetMeshOrder() const { return meshOrder; }
+
+	// Access locality of the spring and triangle passes in their current order.
+	MeshLocalityReport GetLocalityReport() const;
+
+	void SetMass(float m);
 	float GetMass() { return mass; }
 
-	void SetFluidDensity(float rho) { FluidDensity = rho; }
+	// Any change of the forces wakes every resting tile.
+	void SetFluidDensity(float rho) { FluidDensity = rho; sleepTracker.WakeAll(); }
 	float GetFluidDensity() { return FluidDensity; }
-	void SetDragConst(float C) { C_d = C; }
+	void SetDragConst(float C) { C_d = C; sleepTracker.WakeAll(); }
 	float GetDragConst() { return C_d; }
-	void SetWindVelocity(glm::vec3 v) { WindVelocity = v; }
+	void SetWindVelocity(glm::vec3 v) { if (v != WindVelocity) sleepTracker.WakeAll(); WindVelocity = v; }
 	glm::vec3 GetWindVelocity() { return WindVelocity; }
-	void SetSpringConst(float k) { springConst = k; }
+	void SetSpringConst(float k) { springConst = k; sleepTracker.WakeAll(); }
 	float GetSpringConst() { return springConst; }
-	void SetDampingConst(float k) { dampingConst = k; }
+	void SetDampingConst(float k) { dampingConst = k; sleepTracker.WakeAll(); }
 	float GetDampingConst() { return dampingConst; }
-	void SetRestLength(float l) 
-	{ 
-		restLength = l;
-		restLengthDiag = l * 1.4142136f;
-	}
+	// Mesh cloths scale every rest length so that the shortest edge gets length l.
+	void SetRestLength(float l);
 	float GetRestLength() { return restLength; }
-	void SetGravityAcce(float g) { gravityAcce = g; }
+	void SetGravityAcce(float g) { gravityAcce = g; sleepTracker.WakeAll(); }
 	float GetGravityAcce() { return gravityAcce; }
-	void SetGroundPos(float h) 
-	{ 
-		groundPos = h;
-		ground->SetGroundLevel(h);
-	}
-	float GetGroundPos() { return groundPos; }
+	void SetGroundPos(float h) { groundPos = h; sleepTracker.WakeAll(); }
+	float GetGroundPos() const { return groundPos; }
 
-	glm::vec3 GetFixedParticlePos(int i) { return positions[fixedParticleIdx[i]]; }
+	glm::vec3 GetFixedParticlePos(int i) { return particleSystem.GetPosition(fixedParticleIdx[i]); }
 	void SetFixedParticlePos(int i, glm::vec3 pos) 
 	{
 		if (pos.y < groundPos) pos.y = 2 * groundPos - pos.y;
-		positions[fixedParticleIdx[i]] = pos; 
+		particleSystem.SetPosition(fixedParticleIdx[i], pos);
+		sleepTracker.WakeParticle(fixedParticleIdx[i]);
 	}
 	int GetFixedParticleNum() { return fixedParticleIdx.size(); }
+	// Pins or releases particle i, a released particle gets its own mass back.
+	void SetFixed(int i, bool isFixed);
+	float GetParticleMass(int i) const { return meshTopology ? particleMasses[i] : particleMass; }
+
+	void SetNumThreads(int n) { numThreads = std::max(1, std::min(n, ThreadPool::Shared().GetNumThreads())); }
+	int GetNumThreads() { return numThreads; }
+
+	void SetSolverMode(SolverMode mode)
+	{
+		if (implicitTopology) solverMode = SOLVER_GRID;
+		else solverMode = meshTopology && mode == SOLVER_GRID ? SOLVER_EXPLICIT : mode;
+	}
+	SolverMode GetSolverMode() { return solverMode; }
+	void SetAdaptiveSubsteps(bool b) { adaptiveSubsteps = b; }
+	bool GetAdaptiveSubsteps() { return adaptiveSubsteps; }
+	void SetSubstepRange(int lo, int hi) { minSubsteps = std::max(1, lo); maxSubsteps = std::max(minSubsteps, hi); }
+	void SetNumOfOversamples(int n) { numOfOversamples = std::max(1, n); }
+	int GetNumOfOversamples() { return numOfOversamples; }
+	int GetLastSubsteps() { return lastSubsteps; }
+	float GetAverageSubsteps() { return averageSubsteps; }
+	long long GetTotalSubsteps() { return totalSubsteps; }
+	void SetImplicitSubsteps(int n) { implicitSubsteps = std::max(1, n); }
+	int GetImplicitSubsteps() { return implicitSubsteps; }
+	ImplicitSolver& GetImplicitSolver() { return implicitSolver; }
+	void SetXPBDSubsteps(int n) { xpbdSubsteps = std::max(1, n); }
+	int GetXPBDSubsteps() { return xpbdSubsteps; }
+	void SetXPBDIterations(int n) { xpbdIterations = std::max(1, n); }
+	int GetXPBDIterations() { return xpbdIterations; }
+	void SetProjectiveIterations(int n) { projectiveIterations = std::max(1, n); }
+	int GetProjectiveIterations() { return projectiveIterations; }
+	ProjectiveSolver& GetProjectiveSolver() { return projectiveSolver; }
+	GridSolver& GetGridSolver() { return gridSolver; }
+	SleepTracker& GetSleepTracker() { return sleepTracker; }
+	SelfCollision& GetSelfCollision() { return selfCollision; }
 
-	int GetFPS() { return FPS; }
+	// Colliders stay owned by the caller and must outlive the cloth or be removed first. Not used by the grid solver.
+	void AddCollider(const MeshCollider* collider);
+	void RemoveCollider(const MeshCollider* collider);
+	void AddCollider(const BoxCollider* collider);
+	void RemoveCollider(const BoxCollider* collider);
+	void AddCollider(const DistanceCollider* collider);
+	void RemoveCollider(const DistanceCollider* collider);
 
 	void TranslateFixedParticles(int axis, float shift);
 	void RotateFixedParticles(int axis, float shift);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "core.h"
+#include "Cloth.h"
+#include "Ground.h"
+
+// OpenGL renderer for a Cloth: streams its positions and normals into vertex buffers and draws it with the ground.
+class ClothRenderer
+{
+private:
+	const Cloth* cloth;
+
+	GLuint programID;
+	GLuint vao, vbos[2], ebo;
+
+	Ground* ground;
+
+public:
+	ClothRenderer(const Cloth* _cloth, GLuint ID);
+	~ClothRenderer();
+
+	void Update();
+	void Draw(const glm::mat4& viewProjMtx);
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Cloth.h"
+
+// A set of independent cloths (flags, curtains, capes) stepped together on the shared thread pool.
+// Every update sorts the cloths by their estimated cost, elements times the substeps they took last time.
+// A cloth costing at least a thread's share of the whole world steps alone with every thread. The rest are
+// handed out largest first, a whole cloth at a time, to whichever thread is free next, and each runs its
+// passes serially on that thread. Every cloth thus uses at most the world's thread count, whatever its own.
+// Environment coefficients and colliders set on the world apply to all of its cloths.
+class ClothWorld
+{
+private:
+	std::vector<std::unique_ptr<Cloth>> cloths;
+	std::vector<int> order;
+	int numThreads;
+
+	// Shared coefficients, applied to every cloth added later as well.
+	glm::vec3 windVelocity = glm::vec3(0.5f, 0.5f, -2.5f);
+	float fluidDensity = 1.225f, dragConst = 1.0f;
+	float gravityAcce = 2.0f, groundPos = 0.0f;
+	SolverMode solverMode = SOLVER_EXPLICIT;
+	std::vector<const MeshCollider*> meshColliders;
+	std::vector<const BoxCollider*> boxColliders;
+	std::vector<const DistanceCollider*> distanceColliders;
+
+	// Throughput of the last update and since the last reset.
+	double lastSeconds = 0.0;
+	double lastParticleSubsteps = 0.0;
+	double totalSeconds = 0.0;
+	double totalParticleSubsteps = 0.0;
+	int lastConcurrent = 0;
+
+	double EstimateCost(Cloth& cloth) const;
+	void ApplyShared(Cloth& cloth) const;
+
+public:
+	ClothWorld();
+
+	// Creates a cloth with the world's shared coefficients. The world owns it.
+	Cloth* AddCloth(float size, float mass, int N, glm::vec3 pos, glm::vec3 hori, glm::vec3 vert, bool implicitTopology = false);
+	Cloth* AddCloth(const std::vector<glm::vec3>& meshPositions, const std::vector<glm::ivec3>& meshTriangles, float mass, const std::vector<int>& fixedParticles = {},
+		MeshOrdering ordering = MESH_ORDER_RCM);
+	void RemoveCloth(Cloth* cloth);
+	int GetNumCloths() const { return (int)cloths.size(); }
+	Cloth* GetCloth(int i) { return cloths[i].get(); }
+	int GetNumParticles() const;
+
+	// Advances every cloth by this frame's fixed steps.
+	void Update(const SimulationClock& clock);
+
+	void SetNumThreads(int n) { numThreads = std::max(1, std::min(n, ThreadPool::Shared().GetNumThreads())); }
+	int GetNumThreads() const { return numThreads; }
+
+	void SetWindVelocity(glm::vec3 v);
+	glm::vec3 GetWindVelocity() const { return windVelocity; }
+	void SetFluidDensity(float rho);
+	float GetFluidDensity() const { return fluidDensity; }
+	void SetDragConst(float C);
+	float GetDragConst() const { return dragConst; }
+	void SetGravityAcce(float g);
+	float GetGravityAcce() const { return gravityAcce; }
+	void SetGroundPos(float h);
+	float GetGroundPos() const { return groundPos; }
+	void SetSolverMode(SolverMode mode);
+	SolverMode GetSolverMode() const { return solverMode; }
+
+	// Colliders shared by every cloth, owned by the caller. Update them before the world each frame.
+	void AddCollider(const MeshCollider* collider);
+	void RemoveCollider(const MeshCollider* collider);
+	bool HasCollider(const MeshCollider* collider) const { return std::find(meshColliders.begin(), meshColliders.end(), collider) != meshColliders.end(); }
+	void AddCollider(const BoxCollider* collider);
+	void RemoveCollider(const BoxCollider* collider);
+	bool HasCollider(const BoxCollider* collider) const { return std::find(boxColliders.begin(), boxColliders.end(), collider) != boxColliders.end(); }
+	void AddCollider(const DistanceCollider* collider);
+	void RemoveCollider(const DistanceCollider* collider);
+	bool HasCollider(const DistanceCollider* collider) const { return std::find(distanceColliders.begin(), distanceColliders.end(), collider) != distanceColliders.end(); }
+
+	// Aggregate throughput in particle-substeps per second, of the last update and since the last reset.
+	double GetLastThroughput() const { return lastSeconds > 0.0 ? lastParticleSubsteps / lastSeconds : 0.0; }
+	double GetAverageThroughput() const { return totalSeconds > 0.0 ? totalParticleSubsteps / totalSeconds : 0.0; }
+	double GetLastUpdateSeconds() const { return lastSeconds; }
+	double GetTotalParticleSubsteps() const { return totalParticleSubsteps; }
+	// Cloths that ran concurrently in the last update, the rest ran alone with every thread.
+	int GetLastConcurrent() const { return lastConcurrent; }
+	void ResetStatistics() { totalSeconds = 0.0; totalParticleSubsteps = 0.0; }
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Greedy graph coloring of simulation elements (springs, triangles) so that no two elements of the same color
+// share a particle. Elements of one color can then accumulate forces in parallel without atomics.
+// vertsOf(e, verts) writes the particle indices of element e into verts and returns how many it wrote (at most 4).
+// Returns the number of colors used, and the color of each element in colors. The palette grows 64 colors at a
+// time, so high-valence particles such as the center of a fan never force two touching elements into one color.
+template<typename VertsOf>
+int ColorElements(int numParticles, int numElements, VertsOf vertsOf, std::vector<int>& colors)
+{
+	// Bit c % 64 of used[p * words + c / 64] is set once an element of color c touches particle p.
+	int words = 1;
+	std::vector<uint64_t> used(numParticles, 0);
+	colors.assign(numElements, 0);
+
+	int numColors = 0;
+	for (int e = 0; e < numElements; e++)
+	{
+		int verts[4];
+		int n = vertsOf(e, verts);
+
+		// Lowest color not used by any of the element's particles, or the first color of a new word.
+		int c = words * 64;
+		for (int w = 0; w < words && c == words * 64; w++)
+		{
+			uint64_t taken = 0;
+			for (int k = 0; k < n; k++) taken |= used[(size_t)verts[k] * words + w];
+			for (int b = 0; b < 64; b++)
+			{
+				if (!((taken >> b) & 1))
+				{
+					c = w * 64 + b;
+					break;
+				}
+			}
+		}
+		if (c == words * 64)
+		{
+			std::vector<uint64_t> grown((size_t)numParticles * (words + 1), 0);
+			for (int p = 0; p < numParticles; p++)
+			{
+				for (int w = 0; w < words; w++) grown[(size_t)p * (words + 1) + w] = used[(size_t)p * words + w];
+			}
+			used.swap(grown);
+			words++;
+		}
+
+		colors[e] = c;
+		for (int k = 0; k < n; k++) used[(size_t)verts[k] * words + c / 64] |= (uint64_t)1 << (c % 64);
+		if (c + 1 > numColors) numColors = c + 1;
+	}
+
+#ifndef NDEBUG
+	// Every particle is touched at most once per color.
+	std::vector<int> lastElement((size_t)numParticles * numColors, -1);
+	for (int e = 0; e < numElements; e++)
+	{
+		int verts[4];
+		int n = vertsOf(e, verts);
+		for (int k = 0; k < n; k++)
+		{
+			int& last = lastElement[(size_t)verts[k] * numColors + colors[e]];
+			assert(last < 0 || last == e);
+			last = e;
+		}
+	}
+#endif
+	return numColors;
+}
+
+// Stable-sorts elements by color so each color forms a contiguous batch.
+// offsets receives numColors + 1 entries, batch c being [offsets[c], offsets[c + 1]).
+template<typename T>
+void SortByColor(std::vector<T>& elements, const std::vector<int>& colors, int numColors, std::vector<int>& offsets)
+{
+	// Counting sort on the color.
+	offsets.assign(numColors + 1, 0);
+	for (int c : colors) offsets[c + 1]++;
+	for (int c = 0; c < numColors; c++) offsets[c + 1] += offsets[c];
+
+	std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+	std::vector<T> sorted(elements.size());
+	for (size_t e = 0; e < elements.size(); e++)
+	{
+		sorted[cursor[colors[e]]++] = elements[e];
+	}
+	elements.swap(sorted);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "DistanceField.h"
+#include "MeshCollider.h"
+
+// Static triangle mesh that cloth particles collide with through a precomputed signed distance field, for props
+// that never move such as tables or mannequins. Each particle costs one interpolation in the field however many
+// triangles the mesh has. Particles closer than the thickness, or inside the mesh by less than the band, move out
+// along the gradient and lose their velocity into the surface, with Coulomb friction on the sliding velocity.
+// The field is built at construction, or loaded from a cache file written by an earlier build of the same mesh.
+class DistanceCollider
+{
+private:
+	DistanceField field;
+	bool fromCache = false;
+
+	float thickness = 0.02f;
+	float friction = 0.5f;
+
+public:
+	// Builds the field with the given cell size and a band of a few cells. With a cache file, a field built for the
+	// same mesh and cell size is loaded from it instead, and a new build is saved to it.
+	DistanceCollider(const std::vector<glm::vec3>& positions, const std::vector<glm::ivec3>& triangles, float cellSize,
+		const std::string& cacheFile = "", int numThreads = 1);
+
+	// Moves a particle at x with velocity v out of the mesh after a substep of length deltaT.
+	// Returns whether it was in contact.
+	bool Collide(glm::vec3& x, glm::vec3& v, float deltaT) const;
+
+	// Whether the particle at x is in contact, without moving it.
+	bool Touches(const glm::vec3& x) const;
+
+	const DistanceField& GetField() const { return field; }
+	bool IsFromCache() const { return fromCache; }
+	// The thickness is kept within the band, beyond it the field has no distances.
+	void SetThickness(float h) { thickness = glm::clamp(h, 0.0f, 0.5f * field.GetBand()); }
+	float GetThickness() const { return thickness; }
+	void SetFriction(float mu) { friction = std::max(0.0f, mu); }
+	float GetFriction() const { return friction; }
+};
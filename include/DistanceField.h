@@ -0,0 +1,59 @@
+#pragma once
+
+#include "coreMath.h"
+
+#include <cstdint>
+
+// Narrow-band signed distance to a static triangle mesh, sampled on a grid of cubic cells. Only blocks of
+// DISTANCE_BLOCK³ cells near the surface are stored; each keeps the distances at all of its corner nodes,
+// including the ones it shares with the next blocks, so any point is interpolated from a single block. Distances
+// are clamped to the band. Blocks that are not stored only know their side: outside they read a band away,
+// inside they keep the distance and the direction to the surface at their center. The sign comes from the
+// angle-weighted pseudo-normal of the closest feature with coincident vertices welded, positive outside a closed
+// mesh wound counter-clockwise. Building is slow, so the field can be saved and loaded again as long as the mesh
+// and the parameters are unchanged.
+class DistanceField
+{
+public:
+	static const int DISTANCE_BLOCK = 8;
+	static const int BLOCK_NODES = DISTANCE_BLOCK + 1;
+	// Block table entry of a block that is not stored and lies outside, entries below it are interior blocks.
+	static const int DISTANCE_OUTSIDE = -1;
+
+private:
+	glm::vec3 origin; // Corner of the first cell.
+	float cellSize = 1.0f;
+	float band = 0.0f;
+	glm::ivec3 blockDims = glm::ivec3(0);
+
+	// Slot of every block in blockData, DISTANCE_OUTSIDE, or DISTANCE_OUTSIDE - 1 - k for interior block k.
+	std::vector<int> blockIndex;
+	// BLOCK_NODES³ distances per stored block, x fastest.
+	std::vector<float> blockData;
+	// Direction to the surface and signed distance at the center of every interior block.
+	std::vector<glm::vec4> interior;
+
+	uint64_t key = 0;
+
+public:
+	// Samples the mesh with cells of the given size, storing the blocks within band of a triangle.
+	void Build(const std::vector<glm::vec3>& positions, const std::vector<glm::ivec3>& triangles, float _cellSize, float _band, int numThreads);
+
+	// Writes the field to a binary file. Returns false if the file cannot be written.
+	bool Save(const std::string& fileName) const;
+	// Reads a field saved for the same key. Returns false, leaving the field unchanged, if the file is missing,
+	// corrupt or was built from something else.
+	bool Load(const std::string& fileName, uint64_t expectedKey);
+
+	// Identifies a field by the mesh and the parameters it would be built with.
+	static uint64_t Key(const std::vector<glm::vec3>& positions, const std::vector<glm::ivec3>& triangles, float cellSize, float band);
+
+	// Interpolated distance at p and its gradient.
+	float Sample(const glm::vec3& p, glm::vec3& gradient) const;
+
+	bool IsBuilt() const { return !blockIndex.empty(); }
+	float GetCellSize() const { return cellSize; }
+	float GetBand() const { return band; }
+	int GetNumBlocks() const { return (int)(blockData.size() / (BLOCK_NODES * BLOCK_NODES * BLOCK_NODES)); }
+	size_t GetMemoryBytes() const { return blockIndex.size() * sizeof(int) + blockData.size() * sizeof(float) + interior.size() * sizeof(glm::vec4); }
+};
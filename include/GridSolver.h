@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Particle.h"
+
+// Constants of a grid cloth, the same ones Cloth applies to its explicit spring and triangle lists.
+struct GridParams
+{
+	float springConst, dampingConst;
+	float restLength, restLengthDiag;
+	float fluidDensity, dragConst;
+	glm::vec3 windVelocity;
+	float gravityAcce, groundPos;
+};
+
+// Pointers into one row of particle data, either in the particle system or in a private copy of the row.
+struct GridRow
+{
+	float* px, * py, * pz;
+	float* vx, * vy, * vz;
+	const float* w;
+};
+
+// Explicit solver for a width x height particle grid whose springs and triangles are implicit in the layout:
+// structural springs to the neighbours at +-1 and +-width, shear springs across both diagonals of every cell,
+// and every cell split into (topLeft, bottomLeft, bottomRight) and (topLeft, bottomRight, topRight) for the drag.
+// A substep is one sweep down the rows. The forces of a cell row are computed into short row buffers,
+// each particle row is integrated in place as soon as both of its cell rows are done.
+// Rows are split into bands across threads. Every band keeps private copies of the rows just outside it,
+// so a particle's result does not depend on the band it falls in and any thread count gives identical results.
+// With temporal blocking a band advances several substeps in one pass, each substep sweeping a row behind
+// the previous one, and recomputes a halo that shrinks by a row per substep. Results stay identical.
+class GridSolver
+{
+private:
+	// A range of rows with its scratch: element forces of a cell row, two rolling force rows per substep and the halo rows.
+	struct Band
+	{
+		int begin, end;
+		int depth;
+		std::vector<float> scratch;
+		std::vector<float> halo;
+		std::vector<GridRow> rows;
+	};
+
+	int width = 0, height = 0;
+	std::vector<Band> bands;
+
+	// Temporal blocking: substeps per pass over the rows.
+	int blockSubsteps = 1;
+
+	void SetupBands(int numBands, int depth);
+	GridRow GetRow(ParticleSystem& ps, Band& band, int y);
+	void CopyHalo(ParticleSystem& ps, Band& band);
+	void AdvanceBand(ParticleSystem& ps, Band& band, int substeps, float h, const GridParams& params);
+
+public:
+	// Sizes the solver for a grid. Must be called again if the grid dimensions change.
+	void Build(int width, int height);
+
+	// Advances all particles by 'substeps' explicit substeps of length h.
+	void Step(ParticleSystem& ps, float h, int substeps, const GridParams& params, int numThreads);
+	void Substep(ParticleSystem& ps, float h, const GridParams& params, int numThreads) { Step(ps, h, 1, params, numThreads); }
+
+	// Temporal blocking, off with a single substep per block.
+	void SetBlocking(int blockSubsteps);
+	int GetBlockSubsteps() const { return blockSubsteps; }
+
+	// Largest relative stretch of any structural or shear spring.
+	static float MaxStrain(const ParticleSystem& ps, int width, int height, float restLength, float restLengthDiag);
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "SpringDamper.h"
+#include "Multigrid.h"
+
+// Preconditioners of the implicit solver's conjugate gradient.
+enum ImplicitPreconditioner
+{
+	PRECOND_BLOCK_JACOBI,
+	PRECOND_MULTIGRID
+};
+
+// Backward-Euler integrator in the style of Baraff & Witkin, "Large Steps in Cloth Simulation".
+// Each step solves (M - h dF/dv - h^2 dF/dx) dv = h (F + h dF/dx v) with preconditioned conjugate gradient.
+// Block Jacobi needs more iterations the finer the cloth, since a disturbance only travels one particle per
+// iteration. On a particle grid a multigrid V-cycle can precondition instead, which keeps the count nearly flat.
+// The sparse 3x3-block matrix structure is built once from the spring topology and only refilled every step.
+// Pinned particles (inverse mass 0) are handled by filtering their velocity change out of the CG iterates.
+class ImplicitSolver
+{
+private:
+	int numParticles = 0;
+	std::vector<const std::vector<SpringDamper>*> springGroups;
+
+	// Block CSR matrix: row r holds blocks [rowStart[r], rowStart[r + 1]) with column indices in cols.
+	std::vector<int> rowStart;
+	std::vector<int> cols;
+	std::vector<glm::mat3> blocks;
+	std::vector<int> diagBlock;
+
+	// For every spring (all groups concatenated), the positions of its (i, j) and (j, i) blocks.
+	std::vector<int> springBlockIJ, springBlockJI;
+
+	// Solver vectors, kept between steps to avoid reallocating.
+	std::vector<glm::vec3> rhs, dv, r, z, p, q;
+	std::vector<glm::mat3> precond;
+	std::vector<float> filter;
+
+	ImplicitPreconditioner preconditioner = PRECOND_MULTIGRID;
+	GridMultigrid multigrid;
+
+	int maxIterations = 100;
+	float tolerance = 1e-4f;
+	int lastIterations = 0;
+	float lastResidual = 0.0f;
+
+	void Multiply(const std::vector<glm::vec3>& x, std::vector<glm::vec3>& y, int numThreads);
+	void Precondition(bool useMultigrid, int numThreads);
+
+public:
+	// Builds the block structure for the given springs. Must be called again if the spring topology changes.
+	void Build(int numParticles, const std::vector<const std::vector<SpringDamper>*>& springGroups);
+
+	// Makes the multigrid preconditioner available for particles laid out as a width x height grid, x + y * width.
+	void SetGrid(int width, int height) { multigrid.Build(width, height); }
+
+	// Advances the particles by one implicit step. External forces (e.g. aerodynamics) must already be accumulated in ps.
+	void Step(ParticleSystem& ps, float deltaTime, float springConst, float dampingConst, float gravityAcce, float groundPos, int numThreads);
+
+	void SetMaxIterations(int n) { maxIterations = n; }
+	int GetMaxIterations() { return maxIterations; }
+	void SetTolerance(float t) { tolerance = t; }
+	float GetTolerance() { return tolerance; }
+
+	// Multigrid falls back to block Jacobi without a grid or for springs outside the 9-point stencil.
+	void SetPreconditioner(ImplicitPreconditioner p) { preconditioner = p; }
+	ImplicitPreconditioner GetPreconditioner() { return preconditioner; }
+	GridMultigrid& GetMultigrid() { return multigrid; }
+
+	int GetLastIterations() { return lastIterations; }
+	float GetLastResidual() { return lastResidual; }
+};
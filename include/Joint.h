@@ -2,7 +2,6 @@
 
 #include "DOF.h"
 #include "Tokenizer.h"
-#include "Cube.h"
 
 // Project 1
 
@@ -12,8 +11,8 @@ private:
 	// The positional offset of this joint from its parent.
 	glm::vec3 offset;
 
-	// The maximum and minimum bounds of the joint's rotation box.
-	glm::vec3 boxmax, boxmin;
+	// The maximum and minimum bounds of the joint's box, the .skel defaults unless the file sets them.
+	glm::vec3 boxmax = glm::vec3(0.1f), boxmin = glm::vec3(-0.1f);
 
 	// Transformation matrix from this joint's local space to its parent's space.
 	glm::mat4 loc2Parent = glm::mat4(1.0);
@@ -33,8 +32,6 @@ private:
 	// The name of the joint for identification.
 	std::string jointName;
 
-	Cube* cube;
-
 public:
 	// Constructor and destructor.
 	BallJoint();
@@ -48,9 +45,6 @@ public:
 	// Updates the joint's transformation matrices based on the parent's world transform.
 	void update(const glm::mat4& toWorld);
 
-	// Renders the joint
-	void draw(const glm::mat4& viewProjMtx, GLuint shader);
-
 	// Adds a child joint to this joint.
 	void addChild(BallJoint* child);
 
@@ -76,4 +70,8 @@ public:
 
 	// Gets the maximum rotation limits of the joint in Euler angles (X, Y, Z).
 	glm::vec3 getRotMax();
+
+	// Returns the corners of the joint's box in its local space.
+	glm::vec3 getBoxMin() { return boxmin; }
+	glm::vec3 getBoxMax() { return boxmax; }
 };
\ No newline at end of file
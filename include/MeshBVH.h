@@ -0,0 +1,49 @@
+#pragma once
+
+#include "coreMath.h"
+
+// Barycentric weights of the point of triangle abc closest to p.
+glm::vec3 ClosestOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+
+// Bounding volume hierarchy over a triangle mesh whose topology stays fixed while its vertices move, e.g. a
+// skinned character. The tree is built once from a median split of the triangle centroids and afterwards only
+// refit: the boxes are recomputed from the new positions, children before parents. Nodes are numbered level by
+// level from the deepest one up to the root, which comes last, so every level is a contiguous range that is
+// refit in parallel once the levels below it are done.
+class MeshBVH
+{
+private:
+	// Leaves cover triangles [first, first + count) of tris. Inner nodes have count 0 and their children at first and first + 1.
+	struct Node
+	{
+		glm::vec3 lo;
+		int first;
+		glm::vec3 hi;
+		int count;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<int> levelStart; // Nodes of level k (deepest first) are levelStart[k] .. levelStart[k + 1].
+
+	// Triangles in leaf order and their index in the mesh.
+	std::vector<glm::ivec3> tris;
+	std::vector<int> triIndex;
+
+	void RefitNode(Node& node, const std::vector<glm::vec3>& positions) const;
+
+public:
+	void Build(const std::vector<glm::vec3>& positions, const std::vector<glm::ivec3>& triangles);
+
+	// Recomputes every box from the positions, which must have the vertex count the tree was built with.
+	void Refit(const std::vector<glm::vec3>& positions, int numThreads);
+
+	// Closest point of the mesh to p within maxDistance. Returns false if there is none, otherwise the mesh
+	// index of the triangle, the barycentric weights of the point and its squared distance.
+	bool FindClosest(const glm::vec3& p, float maxDistance, const std::vector<glm::vec3>& positions, int& triangle, glm::vec3& bary, float& distance2) const;
+
+	bool IsBuilt() const { return !nodes.empty(); }
+	int GetNumNodes() const { return (int)nodes.size(); }
+	int GetNumLevels() const { return (int)levelStart.size() - 1; }
+	glm::vec3 GetMin() const { return nodes.back().lo; }
+	glm::vec3 GetMax() const { return nodes.back().hi; }
+};
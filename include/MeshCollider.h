@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MeshBVH.h"
+
+// Velocity v of a particle pushed out by depth along the contact normal, against a surface moving with
+// surfaceVelocity: the approach is removed and the sliding slowed by Coulomb friction over a substep of deltaT.
+void ContactVelocity(glm::vec3& v, const glm::vec3& surfaceVelocity, const glm::vec3& normal, float depth, float friction, float deltaT);
+
+// Moving triangle mesh that cloth particles collide with, e.g. a skinned character under a cape. The owner hands
+// it the deformed vertices once per frame, which refits the hierarchy and derives the vertex velocities from the
+// displacement. The surface is two-sided, so open parts such as wings work as well as closed ones: a particle
+// stays on the side it came from, judged from its velocity relative to the surface. Particles closer than the
+// thickness, or that crossed the surface by up to the reach, are pushed back out along the closest feature and
+// lose their velocity into the surface, with Coulomb friction on the sliding velocity.
+// Cloths only read it while they step, so one collider can be shared by any number of cloths.
+class MeshCollider
+{
+private:
+	std::vector<glm::ivec3> triangles;
+	std::vector<glm::vec3> positions, velocities;
+	MeshBVH bvh;
+
+	float thickness = 0.02f;
+	float reach; // Defaults to the mean edge length.
+	float friction = 0.5f;
+
+public:
+	// Builds the hierarchy once, the triangles never change afterwards.
+	MeshCollider(const std::vector<glm::vec3>& _positions, const std::vector<glm::ivec3>& _triangles);
+
+	// Takes the positions after elapsed seconds of animation and refits the hierarchy.
+	void Update(const std::vector<glm::vec3>& newPositions, float elapsed, int numThreads);
+
+	// Moves a particle at x with velocity v out of the mesh after a substep of length deltaT.
+	// Returns whether it was in contact.
+	bool Collide(glm::vec3& x, glm::vec3& v, float deltaT) const;
+
+	// Whether the particle at x is in contact, without moving it.
+	bool Touches(const glm::vec3& x) const;
+
+	const MeshBVH& GetBVH() const { return bvh; }
+	void SetThickness(float h) { thickness = std::max(0.0f, h); }
+	float GetThickness() const { return thickness; }
+	void SetReach(float r) { reach = std::max(0.0f, r); }
+	float GetReach() const { return reach; }
+	void SetFriction(float mu) { friction = std::max(0.0f, mu); }
+	float GetFriction() const { return friction; }
+};
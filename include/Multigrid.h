@@ -0,0 +1,65 @@
+#pragma once
+
+#include "coreMath.h"
+
+// Geometric multigrid V-cycle for 3x3-block systems on a width x height particle grid, numbered x + y * width,
+// where every particle couples at most to its eight neighbours (structural and shear springs).
+// Every level halves the grid: coarse node (X, Y) sits on fine node (2X, 2Y), prolongation is bilinear and
+// restriction its transpose. Coarse operators are Galerkin products R A P, so they keep the 9-point stencil.
+// Smoothing is block Gauss-Seidel in four colors (x & 1, y & 1), whose nodes never touch each other, so each
+// color runs in parallel. Pre-smoothing sweeps the colors forward and post-smoothing backward, which keeps the
+// V-cycle symmetric and usable as a conjugate gradient preconditioner.
+class GridMultigrid
+{
+private:
+	// Block CSR matrix. Coarse rows hold their 9-point stencil in (dy, dx) order, clipped at the borders.
+	struct Level
+	{
+		int width, height;
+		std::vector<int> rowStart, cols;
+		std::vector<glm::mat3> blocks;
+		std::vector<int> slot; // Coarse levels: block of stencil entry k = (dx + 1) + 3 * (dy + 1) of every row, -1 if clipped.
+		std::vector<glm::mat3> diagInv;
+		std::vector<glm::vec3> x, b, r;
+	};
+
+	std::vector<Level> levels;
+
+	// The finest operator belongs to the caller. Rows with a filter of 0 are replaced by identity rows.
+	const int* fineRowStart = nullptr;
+	const int* fineCols = nullptr;
+	const glm::mat3* fineBlocks = nullptr;
+	const float* fineFilter = nullptr;
+
+	// Gauss-Seidel sweeps before and after the coarse correction, and symmetric sweeps on the coarsest level.
+	int smoothSweeps = 1;
+	int coarseSweeps = 8;
+
+	void BuildLevel(Level& level, int width, int height);
+	void Coarsen(int l, int numThreads);
+	void Smooth(int l, const glm::vec3* b, glm::vec3* x, bool forward, int numThreads);
+	void Residual(int l, const glm::vec3* b, const glm::vec3* x, glm::vec3* r, int numThreads);
+	void Restrict(int l, const glm::vec3* r, int numThreads);
+	void Prolong(int l, glm::vec3* x, int numThreads);
+	void Cycle(int l, const glm::vec3* b, glm::vec3* x, int numThreads);
+
+	// Calls f(column, block) for every entry of row i of level l.
+	template <typename F> void ForRow(int l, int i, F f) const;
+
+public:
+	// Sets up the hierarchy for a grid. Must be called again if the grid dimensions change.
+	void Build(int width, int height);
+	bool IsBuilt() const { return !levels.empty(); }
+	int GetNumLevels() const { return (int)levels.size(); }
+
+	// Takes the fine operator and computes the coarse ones. Returns false if it has an entry outside the 9-point stencil.
+	// The arrays are referenced, not copied, and must stay valid while the cycle is applied.
+	bool Setup(int numRows, const std::vector<int>& rowStart, const std::vector<int>& cols, const std::vector<glm::mat3>& blocks,
+		const std::vector<float>& filter, int numThreads);
+
+	// z = V(r), one V-cycle from a zero initial guess.
+	void Apply(const std::vector<glm::vec3>& r, std::vector<glm::vec3>& z, int numThreads);
+
+	void SetSmoothSweeps(int n) { smoothSweeps = std::max(1, n); }
+	int GetSmoothSweeps() const { return smoothSweeps; }
+};
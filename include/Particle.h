@@ -1,41 +1,58 @@
 #pragma once
 
-#include "core.h"
+#include "coreMath.h"
 
 #define EPSILON 1e-6
 #define MAX_FORCE 1e9
 
-class Particle
+// Structure-of-arrays storage for every particle of a cloth.
+// Each attribute lives in its own contiguous array so the per-substep passes stream linearly through memory.
+// An inverse mass of 0 marks a pinned particle.
+class ParticleSystem
 {
-private:
-	glm::vec3* position;
-	glm::vec3* normal;
-	glm::vec3 velocity;
-	glm::vec3 force;
-	glm::vec3 prevForce;
-	bool isFixed = false;
+public:
+	std::vector<float> px, py, pz;
+	std::vector<float> vx, vy, vz;
+	std::vector<float> fx, fy, fz;
+	std::vector<float> invMass;
 
-	const float* mass;
-	const float* gravityAcce;
-	const float* groundPos;
+	std::vector<glm::vec3> normals;
 
-public:
-	Particle(glm::vec3* _position, glm::vec3* normal, float* mass, float* gravityAcce, float* groundPos);
+	void Resize(int n, float mass);
+	int Size() const { return (int)invMass.size(); }
+
+	void SetMass(float mass);
+	void SetFixed(int i, bool isFixed, float mass);
+	bool IsFixed(int i) const { return invMass[i] == 0.0f; }
+
+	glm::vec3 GetPosition(int i) const { return glm::vec3(px[i], py[i], pz[i]); }
+	void SetPosition(int i, const glm::vec3& pos) { px[i] = pos.x; py[i] = pos.y; pz[i] = pos.z; }
+	glm::vec3 GetVelocity(int i) const { return glm::vec3(vx[i], vy[i], vz[i]); }
 
-	void ApplyForce(glm::vec3 f);
-	void ApplyGravity();
-	void Integrate(float deltaTime);
+	void ApplyForce(int i, const glm::vec3& f) { fx[i] += f.x; fy[i] += f.y; fz[i] += f.z; }
 
-	void ResetForce();
+	void Integrate(float deltaTime, float gravityAcce, float groundPos) { Integrate(deltaTime, gravityAcce, groundPos, 0, Size()); }
+	void Integrate(float deltaTime, float gravityAcce, float groundPos, int begin, int end);
+	void ResetForces();
 
-	glm::vec3 GetVelocity();
-	glm::vec3 GetPosition();
+	void GatherPositions(std::vector<glm::vec3>& out) const;
+};
+
+// Thin view of a single particle inside a ParticleSystem.
+class Particle
+{
+private:
+	ParticleSystem* system;
+	int index;
+
+public:
+	Particle(ParticleSystem* _system, int _index) : system(_system), index(_index) {}
 
-	void ResetNormal();
-	void AddNormal(glm::vec3 n);
+	void ApplyForce(glm::vec3 f) { system->ApplyForce(index, f); }
 
-	void GroundCollision();
+	glm::vec3 GetVelocity() const { return system->GetVelocity(index); }
+	glm::vec3 GetPosition() const { return system->GetPosition(index); }
+	int GetIndex() const { return index; }
 
-	void SetPosition(glm::vec3 pos) { *position = pos; }
-	void SetFixed(bool _isFixed) { isFixed = _isFixed; }
-};
\ No newline at end of file
+	void SetPosition(glm::vec3 pos) { system->SetPosition(index, pos); }
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Hot-path phases that can be timed.
+enum ProfilePhase
+{
+	PROFILE_SPRINGS,
+	PROFILE_AERO,
+	PROFILE_INTEGRATE,
+	PROFILE_SOLVE,
+	PROFILE_COLLISION,
+	PROFILE_NORMALS,
+	PROFILE_UPLOAD,
+	PROFILE_SKIN,
+	PROFILE_FK,
+	PROFILE_ANIMATION,
+	NUM_PROFILE_PHASES
+};
+
+// One timed scope, in nanoseconds since the profiler started.
+struct ProfileEvent
+{
+	int64_t start, end;
+	int phase;
+	int thread;
+};
+
+// Fixed-size single-producer ring of events owned by one thread.
+// The owner publishes events with a release store of head; the collector reads up to head and
+// discards anything the owner may have overwritten meanwhile, so neither side ever takes a lock.
+struct ProfileRing
+{
+	static const int CAPACITY = 1 << 13;
+
+	ProfileEvent events[CAPACITY];
+	std::atomic<uint64_t> head{ 0 };
+	uint64_t tail = 0; // Only touched by the collector.
+	int thread;
+};
+
+// Collects scoped timings from every thread into per-frame totals, rolling histories and an event log.
+class Profiler
+{
+private:
+	std::atomic<bool> enabled{ false };
+	std::chrono::steady_clock::time_point epoch;
+
+	// Rings of every thread that has recorded an event, registered once per thread.
+	std::mutex ringsMutex;
+	std::vector<ProfileRing*> rings;
+
+	// Totals in seconds since the last ResetTotals, and of the frame being collected.
+	double totals[NUM_PROFILE_PHASES];
+	double frameTotals[NUM_PROFILE_PHASES];
+
+	// Per-frame milliseconds of the last HISTORY_SIZE frames, oldest at historyOffset.
+	std::vector<float> history[NUM_PROFILE_PHASES];
+	int historyOffset = 0;
+
+	// Most recent events for export, oldest at logOffset once the log is full.
+	std::vector<ProfileEvent> log;
+	size_t logOffset = 0;
+
+	ProfileRing* GetThreadRing();
+	void Collect();
+
+public:
+	static const int HISTORY_SIZE = 240;
+	static const size_t LOG_SIZE = 1 << 16;
+
+	Profiler();
+	~Profiler();
+
+	// Profiler shared by the whole program.
+	static Profiler& Shared();
+
+	void SetEnabled(bool b) { enabled.store(b, std::memory_order_relaxed); }
+	bool IsEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+	int64_t Now() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count(); }
+	void Record(ProfilePhase phase, int64_t start, int64_t end);
+
+	// Drains every thread's ring and closes the current frame in the histories.
+	void EndFrame();
+
+	double GetTotal(ProfilePhase phase) const { return totals[phase]; }
+	void ResetTotals();
+
+	const float* GetHistory(ProfilePhase phase) const { return history[phase].data(); }
+	int GetHistoryOffset() const { return historyOffset; }
+	float GetLastFrameTime(ProfilePhase phase) const;
+
+	static const char* GetPhaseName(ProfilePhase phase);
+
+	// Export the event log as CSV rows or as Chrome trace-event JSON (chrome://tracing, Perfetto).
+	bool WriteCSV(const std::string& fileName);
+	bool WriteChromeTrace(const std::string& fileName);
+};
+
+// Times the enclosing scope into the shared profiler. Costs one relaxed load while profiling is off.
+class ScopedTimer
+{
+private:
+	ProfilePhase phase;
+	int64_t start;
+
+public:
+	ScopedTimer(ProfilePhase _phase) : phase(_phase), start(Profiler::Shared().IsEnabled() ? Profiler::Shared().Now() : -1) {}
+	~ScopedTimer()
+	{
+		if (start >= 0) Profiler::Shared().Record(phase, start, Profiler::Shared().Now());
+	}
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "SpringDamper.h"
+#include "SparseCholesky.h"
+
+// Projective dynamics (Bouaziz et al., "Projective Dynamics: Fusing Constraint Projections for Fast Simulation").
+// Every spring is a projective constraint. A local step projects each spring onto its rest length in parallel,
+// and a global step solves (M / h^2 + k L) x = M / h^2 s + k sum(A^T p) with a prefactored sparse LDL^T.
+// The system matrix depends only on the topology, pinning, masses, springConst and h, so it is factored once
+// and refactored only when one of those changes. Spring damping is applied explicitly.
+class ProjectiveSolver
+{
+private:
+	int numParticles = 0;
+	std::vector<ConstraintGroup> groups;
+
+	// Row of every free particle in the system, -1 for pinned particles.
+	std::vector<int> freeRow;
+	std::vector<int> freeParticles;
+
+	SparseMatrix A;
+	SparseLDLT ldlt;
+
+	// Parameters the current factorization was computed for.
+	bool factored = false;
+	float factoredK = 0.0f, factoredH = 0.0f;
+	std::vector<float> factoredInvMass;
+
+	// Per-spring projections of the local step.
+	std::vector<std::vector<glm::vec3>> projections;
+
+	// Inertial target, start-of-step positions and the global step right-hand sides.
+	std::vector<glm::vec3> inertia, prevPos;
+	std::vector<double> rhs[3], work[3];
+
+	int numFactorizations = 0;
+
+	void BuildPattern(const ParticleSystem& ps);
+	void FillMatrix(const ParticleSystem& ps, float springConst, float h);
+
+public:
+	// Sets up the constraints. Must be called again if the spring topology changes.
+	void Build(int numParticles, const std::vector<ConstraintGroup>& groups);
+
+	// Advances the particles by one step of length h with the given number of local/global iterations.
+	// External forces (e.g. aerodynamics) must already be accumulated in ps.
+	void Step(ParticleSystem& ps, float h, int iterations, float springConst, float dampingConst, float gravityAcce, float groundPos, int numThreads);
+
+	int GetNumFactorizations() { return numFactorizations; }
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "SleepTracker.h"
+
+#include <atomic>
+#include <memory>
+
+// Proximity-based self-contact of a cloth: particle-triangle and edge-edge pairs closer than the thickness are
+// pushed apart, their approaching normal velocity is removed and the sliding velocity damped by Coulomb friction.
+// The broadphase is a uniform spatial hash of the particles and one of the edges, filled by a parallel counting
+// sort over the hash buckets. Cells are two edges long, so every triangle and every edge looks at a few
+// cells around it and the cost grows linearly with the cloth. It collects the pairs within the thickness plus a skin, and those pairs
+// are tested every substep until some particle has moved half the skin, when the hash and the pairs are rebuilt
+// (a Verlet list). A cloth at rest keeps its pairs, a fast one rebuilds them every substep or two.
+// Pairs and contacts are found in parallel chunks and resolved one after another in a fixed order, so the result
+// does not depend on the number of threads.
+class SelfCollision
+{
+private:
+	struct Contact
+	{
+		int p[4]; // Particle and triangle corners, or the two ends of both edges.
+		float w[4]; // Weights of the closest points, negative on the second side.
+		glm::vec3 normal;
+	};
+
+	int numParticles = 0;
+	std::vector<glm::ivec3> tris;
+	std::vector<glm::ivec2> edges;
+	float meanEdgeLength = 0.0f;
+
+	// Spatial hash of cells of cellSize: every item in the buckets of the cells it overlaps, sorted by item.
+	struct HashEntry
+	{
+		int item;
+		glm::ivec3 cell;
+	};
+	struct Hash
+	{
+		std::vector<int> bucketStart;
+		std::vector<HashEntry> entries;
+		std::unique_ptr<std::atomic<int>[]> counts;
+		int numBuckets = 0;
+	};
+	float cellSize = 1.0f;
+	Hash particleHash, edgeHash;
+
+	// Candidate pairs, (particle, triangle) and (edge, edge), and the positions they were found at.
+	std::vector<glm::ivec2> trianglePairs, edgePairs;
+	std::vector<glm::vec3> buildPositions;
+	bool stale = true;
+	int numBuilds = 0;
+
+	// Results of the parallel chunks, gathered in chunk order.
+	std::vector<std::vector<glm::ivec2>> chunkPairs;
+	std::vector<std::vector<Contact>> chunkContacts;
+	std::vector<float> chunkMax;
+
+	// Sleeping particles touched by a contact, woken by the owner after the step.
+	std::vector<int> wakeList;
+
+	bool enabled = false;
+	float thickness = 0.0f;
+	float skin = 0.0f; // Same as the thickness.
+	float friction = 0.3f;
+	int lastContacts = 0;
+
+	void ResizeHash(Hash& hash, int expectedEntries);
+	template <typename F> void FillHash(Hash& hash, int count, F cellRange, int numThreads);
+	template <typename F> void ForEntriesInCells(const Hash& hash, const glm::ivec3& cmin, const glm::ivec3& cmax, F f) const;
+	void FindTrianglePairs(const ParticleSystem& ps, int begin, int end, float radius, std::vector<glm::ivec2>& out) const;
+	void FindEdgePairs(const ParticleSystem& ps, int begin, int end, float radius, std::vector<glm::ivec2>& out) const;
+	float MaxDisplacement2(const ParticleSystem& ps, int numThreads);
+	void BuildPairs(const ParticleSystem& ps, int numThreads);
+	bool TriangleContact(const ParticleSystem& ps, const glm::ivec2& pair, Contact& contact) const;
+	bool EdgeContact(const ParticleSystem& ps, const glm::ivec2& pair, Contact& contact) const;
+	void Resolve(ParticleSystem& ps, const Contact& c, float deltaT, const SleepTracker* sleep);
+
+public:
+	// Takes the triangles to test and their edges, every edge once. Grid cloths thus include the cell diagonals.
+	void Build(const ParticleSystem& ps, const std::vector<glm::ivec3>& triangles);
+
+	// Finds and resolves the contacts after a substep of length deltaT. Particles of sleeping tiles are not moved,
+	// they are collected in GetWakeList instead.
+	void Solve(ParticleSystem& ps, float deltaT, const SleepTracker* sleep, int numThreads);
+
+	const std::vector<int>& GetWakeList() const { return wakeList; }
+	void ClearWakeList() { wakeList.clear(); }
+
+	void SetEnabled(bool b) { enabled = b; }
+	bool GetEnabled() const { return enabled; }
+	void SetThickness(float h) { thickness = std::max(0.0f, h); skin = thickness; stale = true; }
+	// Follows a change of the cloth's rest length, the thickness and the cells keep their size relative to the edges.
+	void Rescale(float scale) { meanEdgeLength *= scale; SetThickness(thickness * scale); }
+	float GetThickness() const { return thickness; }
+	void SetFriction(float mu) { friction = std::max(0.0f, mu); }
+	float GetFriction() const { return friction; }
+	float GetCellSize() const { return cellSize; }
+	int GetLastContacts() const { return lastContacts; }
+	int GetNumPairs() const { return (int)(trianglePairs.size() + edgePairs.size()); }
+	int GetNumBuilds() const { return numBuilds; }
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+
+// Fixed-timestep simulation clock shared by everything that advances in time.
+// Wall-clock frame time goes into an accumulator that is consumed in whole fixed steps, so the simulation
+// is reproducible regardless of frame rate. The remainder is exposed as an interpolation factor for rendering.
+class SimulationClock
+{
+private:
+	double fixedDt;
+	int maxStepsPerFrame;
+
+	double accumulator = 0.0;
+	int steps = 0;
+	long long totalSteps = 0;
+
+	std::chrono::steady_clock::time_point prevT;
+	bool started = false;
+
+	// Frames per second, measured in wall time.
+	double fpsInterval = 0.0;
+	int fpsCount = 0;
+	int fps = 0;
+
+public:
+	SimulationClock(double fixedDt = 1.0 / 60.0, int maxStepsPerFrame = 4);
+
+	// Starts a frame using the wall time elapsed since the previous frame.
+	void BeginFrame();
+	// Starts a frame of the given length in seconds, e.g. for headless runs.
+	void BeginFrame(double frameTime);
+
+	// Number of fixed steps to take this frame.
+	int GetSteps() const { return steps; }
+	float GetFixedDt() const { return (float)fixedDt; }
+	void SetFixedDt(double dt) { fixedDt = dt; }
+	void SetMaxStepsPerFrame(int n) { maxStepsPerFrame = n; }
+
+	// Simulated time after this frame's steps.
+	double GetTime() const { return totalSteps * fixedDt; }
+	// Fraction of a step between the last two simulated states that the rendered frame corresponds to.
+	float GetAlpha() const { return (float)(accumulator / fixedDt); }
+
+	int GetFPS() const { return fps; }
+};
@@ -17,14 +17,12 @@ private:
 	// Project 2
 	std::vector<BallJoint*> joints;
 
-	GLuint shaderID;
-
 public:
 	// Constructor and Destructor.
 	//Project 1
 	//Skeleton(std::string _fileName, const glm::mat4& _toWorld);
 	
-	Skeleton(std::string _fileName, GLuint _shaderID);
+	Skeleton(std::string _fileName);
 	~Skeleton();
 
 	// Loads the skeleton data from a file.
@@ -33,14 +31,14 @@ public:
 	// Updates the skeleton's pose based on the given world transformation.
 	void update(const glm::mat4& _toWorld);
 
-	// Draws the skeleton using the given view projection matrix and shader.
-	//void draw(const glm::mat4& viewProjMtx, GLuint shader);
+	// Returns the transformation the skeleton was last updated with (drawing lives in SkeletonRenderer).
+	glm::mat4 getToWorld() { return toWorld; }
 
-	void draw(const glm::mat4& viewProjMtx);
 	// Project 2
 	glm::mat4 getWorldMat(int jointNum);
 
 	size_t getNumOfJoint() { return joints.size(); }
+	BallJoint* getJoint(int jointNum) { return joints[jointNum]; }
 
 	std::string getJointName(int jointNum);
 	void getJointRot(int jointNum, glm::vec3& rot);
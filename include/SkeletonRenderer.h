@@ -0,0 +1,22 @@
+#pragma once
+
+#include "core.h"
+#include "Skeleton.h"
+#include "Cube.h"
+
+// OpenGL renderer for a Skeleton: draws every joint as a box.
+class SkeletonRenderer
+{
+private:
+	Skeleton* skel;
+	GLuint shaderID;
+
+	// One box per joint, in the skeleton's joint order.
+	std::vector<Cube*> cubes;
+
+public:
+	SkeletonRenderer(Skeleton* _skel, GLuint _shaderID);
+	~SkeletonRenderer();
+
+	void draw(const glm::mat4& viewProjMtx);
+};
@@ -1,13 +1,12 @@
 #pragma once
-#include "core.h"
+#include "coreMath.h"
 #include "Skeleton.h"
+#include "VertexNormals.h"
 
 class Skin
 {
 private:
 	std::string fileName;
-	GLuint shaderID;
-	GLuint vao, vbos[2], ebo;
 
 	std::vector<glm::vec3> positions;
 	std::vector<glm::vec3> normals;
@@ -22,14 +21,28 @@ private:
 
 	Skeleton* skel;
 
+	// Optional normals recomputed from the skinned positions instead of skinning the loaded normals.
+	bool gatherNormals;
+	std::vector<glm::vec3> faceNormals;
+	VertexTriangleAdjacency adjacency;
+
 public:
-	Skin(std::string _fileName, Skeleton* _skel, GLint _programID);
+	Skin(std::string _fileName, Skeleton* _skel);
 	~Skin();
 
 	void load();
 	void checkNormals();
 	void invBindingMat();
 	void setSkeleton(Skeleton* _skel) { skel = _skel; }
+	void setGatherNormals(bool _gatherNormals) { gatherNormals = _gatherNormals; }
+	bool getGatherNormals() const { return gatherNormals; }
 	void update();
-	void draw(const glm::mat4& viewProjMtx);
+
+	// Bind pose as loaded from the file.
+	const std::vector<glm::vec3>& getBindPositions() const { return positions; }
+
+	// Skinned state after the last update, drawn by SkinRenderer.
+	const std::vector<glm::vec3>& getPositions() const { return currPositions; }
+	const std::vector<glm::vec3>& getNormals() const { return currNormals; }
+	const std::vector<glm::ivec3>& getTriangles() const { return triangles; }
 };
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "core.h"
+#include "Skin.h"
+
+// OpenGL renderer for a Skin: uploads the skinned positions and normals and draws the mesh.
+class SkinRenderer
+{
+private:
+	const Skin* skin;
+
+	GLuint shaderID;
+	GLuint vao, vbos[2], ebo;
+
+public:
+	SkinRenderer(const Skin* _skin, GLuint _programID);
+	~SkinRenderer();
+
+	void update();
+	void draw(const glm::mat4& viewProjMtx);
+};
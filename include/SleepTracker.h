@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Particle.h"
+
+// A contiguous run of particle indices [begin, end).
+struct ParticleSpan
+{
+	int begin, end;
+};
+
+// Sleep state of a particle grid split into square tiles.
+// A tile whose particles have had little kinetic energy and little unbalanced force (the spring and drag forces
+// plus gravity, minus what the ground holds up) for a number of steps falls asleep: its velocities are zeroed,
+// its particles are no longer integrated and the elements among them can be skipped.
+// A sleeping tile wakes when a neighbouring tile is moving, when one of its particles is moved from outside,
+// or when everything is woken, e.g. after a change of the wind.
+class SleepTracker
+{
+private:
+	struct Tile
+	{
+		int spanBegin, spanEnd; // Particle runs in spans.
+		int neighborBegin, neighborEnd; // Adjacent tiles in neighbors.
+		int restSteps; // Consecutive steps spent below both thresholds.
+		bool awake;
+		bool moving; // Above a threshold in the last evaluation.
+	};
+
+	std::vector<Tile> tiles;
+	std::vector<ParticleSpan> spans;
+	std::vector<int> neighbors;
+	std::vector<int> particleTile;
+
+	// Rebuilt on every change of the sleep state.
+	std::vector<int> awakeTiles;
+	std::vector<ParticleSpan> awakeSpans, borderSpans;
+	int numAwakeParticles = 0;
+	int numSleeping = 0;
+	bool changed = true;
+
+	bool enabled = true;
+	bool alwaysAwake = false;
+	float energyThreshold = 2e-3f; // Kinetic energy per unit mass, 0.5 v^2.
+	float forceThreshold = 0.2f; // Unbalanced force per unit mass.
+	int sleepSteps = 60;
+
+	void SetAwake(int t, bool awake);
+	void RebuildSpans();
+
+public:
+	// Splits a width x height grid into tileSize x tileSize tiles, all awake.
+	void BuildGrid(int width, int height, int tileSize);
+
+	// Flags the awake tiles above a threshold. Must run while the particle forces of a substep are accumulated.
+	void Evaluate(const ParticleSystem& ps, float gravityAcce, float groundPos, int numThreads);
+
+	// Puts tiles that rested long enough to sleep and wakes sleeping tiles next to moving ones.
+	void Update(ParticleSystem& ps);
+
+	void WakeParticle(int i);
+	void WakeAll();
+
+	// Whether the sleep state changed since the last call, e.g. so the owner can rebuild its element lists.
+	bool TakeChanged() { bool c = changed; changed = false; return c; }
+
+	bool IsAwake(int particle) const { return tiles[particleTile[particle]].awake; }
+	bool AnySleeping() const { return numSleeping > 0; }
+	int GetNumTiles() const { return (int)tiles.size(); }
+	int GetNumSleeping() const { return numSleeping; }
+	int GetNumAwakeParticles() const { return numAwakeParticles; }
+
+	// Particles of awake tiles, and particles of sleeping tiles next to an awake one, sorted and merged.
+	const std::vector<ParticleSpan>& GetAwakeSpans() const { return awakeSpans; }
+	const std::vector<ParticleSpan>& GetBorderSpans() const { return borderSpans; }
+
+	// Turns sleep off until the next BuildGrid, for tiles that do not follow the particle adjacency (e.g. a mesh
+	// numbered into one row), where a sleeping tile could miss a moving neighbour. SetEnabled(true) then does nothing.
+	void KeepAwake() { alwaysAwake = true; SetEnabled(false); }
+	bool CanSleep() const { return !alwaysAwake; }
+
+	void SetEnabled(bool b) { enabled = b && !alwaysAwake; if (!enabled) WakeAll(); }
+	bool GetEnabled() const { return enabled; }
+	void SetThresholds(float energy, float force) { energyThreshold = energy; forceThreshold = force; }
+	float GetEnergyThreshold() const { return energyThreshold; }
+	float GetForceThreshold() const { return forceThreshold; }
+	void SetSleepSteps(int n) { sleepSteps = std::max(1, n); }
+	int GetSleepSteps() const { return sleepSteps; }
+};
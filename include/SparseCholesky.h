@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+// Sparse symmetric positive definite matrix in compressed sparse column form.
+// Both triangles are stored; the factorization only reads the entries it needs.
+struct SparseMatrix
+{
+	int n = 0;
+	std::vector<int> colStart;
+	std::vector<int> rows;
+	std::vector<double> values;
+};
+
+// Fill-reducing ordering by approximate minimum degree on the quotient graph of the matrix.
+// Returns the permutation perm, where perm[k] is the original index of the k-th pivot.
+std::vector<int> MinimumDegreeOrdering(const SparseMatrix& A);
+
+// Sparse LDL^T factorization with a fill-reducing permutation, after T. Davis' LDL package.
+// Analyze computes the ordering and the elimination tree once per sparsity pattern,
+// Factorize recomputes the numeric factor for new values with the same pattern.
+class SparseLDLT
+{
+private:
+	int n = 0;
+	std::vector<int> perm, permInv;
+
+	// Elimination tree and the column structure of L.
+	std::vector<int> parent, colCount, colStart;
+	std::vector<int> Li;
+	std::vector<double> Lx, D;
+
+	// Scratch space for the numeric factorization.
+	std::vector<double> Y;
+	std::vector<int> pattern, flag, lnz;
+
+public:
+	void Analyze(const SparseMatrix& A);
+	bool Factorize(const SparseMatrix& A);
+
+	// Solves A x = b in place.
+	void Solve(std::vector<double>& x, std::vector<double>& work) const;
+
+	int GetNumNonZeros() const { return (int)Li.size(); }
+};
@@ -2,18 +2,39 @@
 
 #include "Particle.h"
 
-class SpringDamper
+// Packed spring-damper record: the two particle indices it connects and its rest length.
+// Spring and damping constants are shared by every spring of a cloth and passed to the force pass.
+struct SpringDamper
 {
-private:
-	const float *SpringConst, *DampingConst;
-	const float *RestLength;
-	Particle *P1, *P2;
+	int i, j;
+	float restLength;
+};
 
-	glm::vec3 prevDir;
+// Springs of one type together with their conflict-free color batches.
+struct ConstraintGroup
+{
+	const std::vector<SpringDamper>* springs;
+	const std::vector<int>* batches;
+};
+
+// Instruction set used by the spring force pass. The best one supported by the CPU is picked at startup.
+enum SpringKernel
+{
+	SPRING_KERNEL_SCALAR,
+	SPRING_KERNEL_SSE4,
+	SPRING_KERNEL_AVX2
+};
 
-public:
-	SpringDamper(Particle* _P1, Particle* _P2, float* SpringConst, float* DampingConst, float* RestLength);
+// Computes the spring and damping forces of a contiguous batch of springs and accumulates them into the particle forces.
+void ComputeSpringForces(ParticleSystem& ps, const SpringDamper* springs, int count, float springConst, float dampingConst);
 
-	void ComputeForce();
+inline void ComputeSpringForces(ParticleSystem& ps, const std::vector<SpringDamper>& springs, float springConst, float dampingConst)
+{
+	ComputeSpringForces(ps, springs.data(), (int)springs.size(), springConst, dampingConst);
+}
 
-};
\ No newline at end of file
+// Kernel selection. SetSpringKernel falls back to the best supported kernel if the requested one is unavailable.
+SpringKernel GetBestSpringKernel();
+SpringKernel GetSpringKernel();
+void SetSpringKernel(SpringKernel kernel);
+const char* GetSpringKernelName(SpringKernel kernel);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that split index ranges between themselves.
+// The calling thread takes part in the work, so a pool of N threads starts N - 1 workers.
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wakeCond, doneCond;
+	bool stop = false;
+
+	// A parallel-for job. Workers copy it under the mutex, the generation tells jobs apart.
+	struct Job
+	{
+		const std::function<void(int, int)>* body = nullptr;
+		int count = 0;
+		int numTasks = 0;
+		unsigned long long generation = 0;
+	};
+
+	// Current job. Its next unclaimed task sits in the low 32 bits of nextTask and its generation in the high 32 bits,
+	// so a worker still holding an older job can never claim a task of the current one.
+	Job job;
+	std::atomic<unsigned long long> nextTask;
+	int pendingTasks = 0;
+
+	std::mutex submitMutex;
+
+	void WorkerLoop();
+	void RunTasks(const Job& current);
+
+public:
+	ThreadPool(int numThreads);
+	~ThreadPool();
+
+	// Pool shared by all simulation objects, sized to the hardware concurrency.
+	static ThreadPool& Shared();
+
+	int GetNumThreads() const { return (int)workers.size() + 1; }
+
+	// Splits [0, count) into at most maxTasks contiguous ranges and runs body(begin, end) on each.
+	// Returns once every range is done. Calls from inside a task run serially.
+	void ParallelFor(int count, int maxTasks, const std::function<void(int, int)>& body);
+
+	// Runs body over the consecutive batches [offsets[c], offsets[c + 1]) one after another,
+	// splitting each batch into at most maxTasks ranges of at least grain elements.
+	void ParallelForBatches(const std::vector<int>& offsets, int maxTasks, int grain, const std::function<void(int, int)>& body);
+};
@@ -7,7 +7,7 @@
 #include <cctype>
 #include <cstring>
 
-#include "core.h"
+#include "coreMath.h"
 
 // The Tokenizer class for reading simple ascii data files. The GetToken function
 // just grabs tokens separated by whitespace, but the GetInt and GetFloat functions
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "particle.h"
+#include "Particle.h"
 
 class Triangle
 {
@@ -14,7 +14,7 @@ private:
 public:
 	Triangle(Particle* _P1, Particle* _P2, Particle* _P3, float* _FluidDensity, float* _C, glm::vec3* _WindVelocity);
 
-	void ComputeAerodynamicForce();
-	void ComputeNormal();
+	void ComputeAerodynamicForce(glm::vec3* faceNormal = nullptr);
+	glm::ivec3 GetIndices() const { return glm::ivec3(P1->GetIndex(), P2->GetIndex(), P3->GetIndex()); }
 
 };
\ No newline at end of file
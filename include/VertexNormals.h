@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Particle.h"
+
+// Incident triangles of every vertex in compressed sparse row form:
+// the triangles around vertex v are triangles[offsets[v]] ... triangles[offsets[v + 1] - 1], in increasing order.
+struct VertexTriangleAdjacency
+{
+	std::vector<int> offsets;
+	std::vector<int> triangles;
+
+	void Build(int numVertices, const std::vector<glm::ivec3>& tris);
+	int NumVertices() const { return (int)offsets.size() - 1; }
+};
+
+// Area-weighted normals (unnormalized cross products) of triangles [begin, end).
+void ComputeFaceNormals(const glm::vec3* positions, const glm::ivec3* tris, glm::vec3* faceNormals, int begin, int end);
+void ComputeFaceNormals(const ParticleSystem& ps, const glm::ivec3* tris, glm::vec3* faceNormals, int begin, int end);
+
+// Sums the face normals around each vertex in [begin, end) and normalizes the result.
+// Every vertex only writes its own normal, so ranges can run in parallel without synchronization.
+void GatherVertexNormals(const VertexTriangleAdjacency& adjacency, const glm::vec3* faceNormals, glm::vec3* normals, int begin, int end);
+
+// Vertex normals of rows [rowBegin, rowEnd) of a width x height particle grid triangulated like the cloth,
+// each cell split into (topLeft, bottomLeft, bottomRight) and (topLeft, bottomRight, topRight).
+// Same result as gathering the face normals, but computed from the positions alone without any adjacency.
+void ComputeGridNormals(const ParticleSystem& ps, int width, int height, glm::vec3* normals, int rowBegin, int rowEnd);
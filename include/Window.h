@@ -7,9 +7,13 @@
 #include "Skeleton.h"
 
 #include "Skin.h"
+#include "SkinRenderer.h"
+#include "SkeletonRenderer.h"
 #include "Character.h"
 
-#include "Cloth.h"
+#include "ClothWorld.h"
+#include "ClothRenderer.h"
+#include "Profiler.h"
 
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
@@ -25,16 +29,25 @@ public:
     // Objects to render
     //static Cube* cube;
     static Skeleton* skel;
+    static SkeletonRenderer* skelRenderer;
 
     // Project 2
     static bool drawSkelFlag;
 	static Skin* skin;
+	static SkinRenderer* skinRenderer;
 
     // Project 3
     static Character* character;
 
     // Project 4
-	static Cloth* cloth;
+	static ClothWorld* clothWorld;
+	static Cloth* cloth; // Owned by clothWorld.
+	static MeshCollider* skinCollider; // Follows the skin, attached to the cloths from the UI.
+	static BoxCollider* boxCollider; // Follows the skeleton's joint boxes, attached to the cloths from the UI.
+	static ClothRenderer* clothRenderer;
+
+    // Fixed-timestep clock driving the character and the cloth
+    static SimulationClock simClock;
     
     // Shader Program
     static GLuint shaderProgram;
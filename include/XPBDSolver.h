@@ -0,0 +1,26 @@
+#pragma once
+
+#include "SpringDamper.h"
+
+// Extended position-based dynamics (Macklin et al., "XPBD: Position-Based Simulation of Compliant Constrained Dynamics").
+// Every spring becomes a distance constraint with compliance 1 / springConst and damping dampingConst.
+// Constraints are projected with colored Gauss-Seidel: batches run in order, the constraints inside a batch in parallel.
+class XPBDSolver
+{
+private:
+	std::vector<ConstraintGroup> groups;
+	std::vector<std::vector<float>> lambdas;
+
+	// Positions at the start of the substep.
+	std::vector<float> prevX, prevY, prevZ;
+
+	void SolveGroup(ParticleSystem& ps, int g, float alphaTilde, float gamma, int numThreads);
+
+public:
+	// Sets up the constraints. Must be called again if the spring topology changes.
+	void Build(int numParticles, const std::vector<ConstraintGroup>& groups);
+
+	// Advances the particles by one substep of length h with the given number of constraint iterations.
+	// External forces (e.g. aerodynamics) must already be accumulated in ps.
+	void Substep(ParticleSystem& ps, float h, int iterations, float springConst, float dampingConst, float gravityAcce, float groundPos, int numThreads);
+};
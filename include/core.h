@@ -2,26 +2,4 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
-#include <glm/glm.hpp>
-#include <glm/gtx/transform.hpp>
-#include "glm/gtx/euler_angles.hpp"
-
-// Project 4
-#include <glm/gtc/type_ptr.hpp>
-
-#include <glm/gtc/matrix_transform.hpp>
-
-#include <vector>
-#include <ctype.h>
-
-#include <algorithm>
-#include <string>
-#include <iostream>
-#include <memory>
-
-#include <stdlib.h>
-#include <stdio.h>
-
-#include <map>
-#include <utility>
-#include <tuple>
\ No newline at end of file
+#include "coreMath.h"
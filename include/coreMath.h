@@ -0,0 +1,28 @@
+#pragma once
+
+// Math and standard library headers shared by every module, without any OpenGL dependency.
+// The simulation core includes this directly so it can be built headless.
+
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+#include "glm/gtx/euler_angles.hpp"
+
+// Project 4
+#include <glm/gtc/type_ptr.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <ctype.h>
+
+#include <algorithm>
+#include <string>
+#include <iostream>
+#include <memory>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <map>
+#include <utility>
+#include <tuple>
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Animation.h"
+#include "Profiler.h"
 
 // Constructor: Loads animation data from a file.
 Animation::Animation(std::string _fileName)
@@ -65,6 +66,8 @@ void Animation::load()
 // Update the animation state based on the current time 't'.
 void Animation::update(float& t, glm::mat4& T, Skeleton* skel)
 {
+    ScopedTimer timer(PROFILE_ANIMATION);
+
     // Clamp 't' to the animation range to prevent out-of-bounds behavior.
     if (t < time_start || t > time_end) t = time_start;
 
@@ -0,0 +1,95 @@
+#include "BoxCollider.h"
+
+#include "Profiler.h"
+
+// Constructor: One box per joint with a nonempty box, at rest in the skeleton's current pose.
+BoxCollider::BoxCollider(Skeleton* _skel)
+{
+    skel = _skel;
+    for (int j = 0; j < (int)skel->getNumOfJoint(); j++)
+    {
+        Box box;
+        box.joint = j;
+        box.lo = skel->getJoint(j)->getBoxMin();
+        box.hi = skel->getJoint(j)->getBoxMax();
+        if (box.hi.x <= box.lo.x || box.hi.y <= box.lo.y || box.hi.z <= box.lo.z) continue;
+        box.velocity = glm::mat4(0.0f);
+        boxes.push_back(box);
+    }
+    boxBounds.resize(boxes.size());
+    Update(0.0f);
+}
+
+// PoseBox: Takes the joint's world transform, its rate of change over the elapsed time and the world bounds.
+// The bounds are the box's center plus its half extents projected on the world axes.
+void BoxCollider::PoseBox(Box& box, Bounds& bounds, float elapsed)
+{
+    glm::mat4 m = placement * skel->getWorldMat(box.joint);
+    if (elapsed > 0.0f) box.velocity = (m - box.loc2World) / elapsed;
+    box.loc2World = m;
+    box.world2Loc = glm::inverse(m);
+
+    glm::vec3 center = glm::vec3(m * glm::vec4(0.5f * (box.lo + box.hi), 1.0f));
+    glm::vec3 half = 0.5f * (box.hi - box.lo);
+    glm::vec3 extent = glm::abs(glm::vec3(m[0])) * half.x + glm::abs(glm::vec3(m[1])) * half.y + glm::abs(glm::vec3(m[2])) * half.z;
+    bounds.lo = center - extent;
+    bounds.hi = center + extent;
+}
+
+// Update: Poses every box. A frame without simulation steps keeps the previous velocities.
+void BoxCollider::Update(float elapsed)
+{
+    ScopedTimer timer(PROFILE_COLLISION);
+    boundsLo = glm::vec3(std::numeric_limits<float>::max());
+    boundsHi = glm::vec3(-std::numeric_limits<float>::max());
+    for (int b = 0; b < (int)boxes.size(); b++)
+    {
+        PoseBox(boxes[b], boxBounds[b], elapsed);
+        boundsLo = glm::min(boundsLo, boxBounds[b].lo);
+        boundsHi = glm::max(boundsHi, boxBounds[b].hi);
+    }
+}
+
+// Collide: Skips the particle unless it is within the thickness of the bounds of all boxes, then of a box.
+// Inside a box grown by the thickness, it moves out through the face it is closest to, along that face's normal,
+// and its velocity is corrected relative to the box. A later box sees the pushed particle.
+bool BoxCollider::Collide(glm::vec3& x, glm::vec3& v, float deltaT) const
+{
+    glm::vec3 margin(thickness);
+    if (glm::any(glm::lessThan(x, boundsLo - margin)) || glm::any(glm::greaterThan(x, boundsHi + margin))) return false;
+
+    bool hit = false;
+    for (int b = 0; b < (int)boxes.size(); b++)
+    {
+        if (glm::any(glm::lessThan(x, boxBounds[b].lo - margin)) || glm::any(glm::greaterThan(x, boxBounds[b].hi + margin))) continue;
+        const Box& box = boxes[b];
+
+        glm::vec3 local = glm::vec3(box.world2Loc * glm::vec4(x, 1.0f));
+        glm::vec3 lo = box.lo - margin, hi = box.hi + margin;
+        if (glm::any(glm::lessThan(local, lo)) || glm::any(glm::greaterThan(local, hi))) continue;
+
+        // Face with the smallest push out, sign -1 for the lo face and +1 for the hi face.
+        int axis = 0;
+        float sign = -1.0f, depth = local.x - lo.x;
+        for (int k = 0; k < 3; k++)
+        {
+            if (local[k] - lo[k] < depth) { axis = k; sign = -1.0f; depth = local[k] - lo[k]; }
+            if (hi[k] - local[k] < depth) { axis = k; sign = 1.0f; depth = hi[k] - local[k]; }
+        }
+        local[axis] = sign < 0.0f ? lo[axis] : hi[axis];
+
+        glm::vec3 normal = sign * glm::normalize(glm::vec3(box.loc2World[axis]));
+        glm::vec3 surfaceVelocity = glm::vec3(box.velocity * glm::vec4(local, 1.0f));
+        x = glm::vec3(box.loc2World * glm::vec4(local, 1.0f));
+        ContactVelocity(v, surfaceVelocity, normal, depth, friction, deltaT);
+        hit = true;
+    }
+    return hit;
+}
+
+// Touches: Same test as Collide on a copy of the particle.
+bool BoxCollider::Touches(const glm::vec3& x) const
+{
+    glm::vec3 y = x, v(0.0f);
+    return Collide(y, v, 1.0f);
+}
@@ -6,23 +6,31 @@ Character::Character(Skeleton* _skel, Animation* _anim)
     skel = _skel; // Assign the skeleton
     anim = _anim; // Assign the animation
     time = 0.0f; // Start time at zero
-
-    prevT = clock(); // Initialize prevT with the current clock time
 }
 
-// Update function to advance the character's animation based on elapsed time
-void Character::update()
+// Update function to advance the character's animation by the clock's fixed steps
+void Character::update(const SimulationClock& clock)
 {
-    clock_t currT = clock(); // Get current clock time
-    // Calculate elapsed time since last update, convert from clock ticks to seconds
-    time += ((float)currT - (float)prevT) / CLOCKS_PER_SEC;
-    prevT = currT; // Update prevT for the next call
+    // Advance in whole fixed steps so the animation stays in lockstep with the cloth
+    time += clock.GetSteps() * clock.GetFixedDt();
 
     glm::mat4 T; // Transformation matrix
 
-    // Update the animation state based on the accumulated time
+    // Pose the skeleton at the time of the last step, the pose the colliders and the cloth steps see.
+    // The animation wraps around by resetting the time to its start.
     anim->update(time, T, skel);
 
     // Update the skeleton with the new transformation matrix (if used)
     skel->update(T);
+}
+
+// updateRenderPose: Poses the skeleton where the cloth is drawn, between the last two steps, a fraction
+// 1 - alpha of a step before the last one. The step time is left unchanged.
+void Character::updateRenderPose(const SimulationClock& clock)
+{
+    float t = time - (1.0f - clock.GetAlpha()) * clock.GetFixedDt();
+
+    glm::mat4 T;
+    anim->update(t, T, skel);
+    skel->update(T);
 }
\ No newline at end of file
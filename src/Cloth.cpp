@@ -1,7 +1,16 @@
 #include "Cloth.h"
 
+#include "Coloring.h"
+#include "Profiler.h"
+
+// Minimum number of elements per task when a pass is split across threads.
+#define PARALLEL_GRAIN 512
+
+// Edge length in particles of the tiles that sleep and wake together.
+#define SLEEP_TILE_SIZE 8
+
 // Constructor: Sets up the cloth simulation with given parameters.
-Cloth::Cloth(float _size, float _mass, int N, glm::vec3 pos, glm::vec3 hori, glm::vec3 vert, GLuint ID)
+Cloth::Cloth(float _size, float _mass, int N, glm::vec3 pos, glm::vec3 hori, glm::vec3 vert, bool _implicitTopology)
 {
     size = _size; // Total size of the cloth.
     mass = _mass; // Total mass of the cloth.
@@ -9,26 +18,47 @@ Cloth::Cloth(float _size, float _mass, int N, glm::vec3 pos, glm::vec3 hori, glm
     topLeftPos = pos; // Top-left position of the cloth in world space.
     horiDir = glm::normalize(hori); // Normalized horizontal direction of the cloth.
     vertDir = glm::normalize(vert); // Normalized vertical direction of the cloth.
+    implicitTopology = _implicitTopology; // Skip the explicit element lists, e.g. for very large cloths.
+    meshTopology = false;
+
+    numThreads = ThreadPool::Shared().GetNumThreads(); // Use every available hardware thread by default.
 
-    programID = ID; // OpenGL shader program ID for rendering.
+    solverMode = implicitTopology ? SOLVER_GRID : SOLVER_EXPLICIT; // Explicit integration with oversampling by default.
+    implicitSubsteps = 1; // One backward-Euler step per frame.
+    xpbdSubsteps = 4; // XPBD substeps per frame.
+    xpbdIterations = 2; // Constraint iterations per XPBD substep.
+    projectiveIterations = 5; // Local/global iterations per projective dynamics step.
 
     Initialize(); // Call initialization function to set up particles and connections.
+}
+
+// Constructor: Sets up a cloth from a triangle mesh, deriving its springs and particle masses from the mesh.
+Cloth::Cloth(const std::vector<glm::vec3>& meshPositions, const std::vector<glm::ivec3>& meshTriangles, float _mass, const std::vector<int>& fixedParticles,
+    MeshOrdering ordering)
+{
+    mass = _mass; // Total mass of the cloth.
+    numOfParticles = 0; // No grid.
+    size = 0.0f;
+    topLeftPos = horiDir = vertDir = glm::vec3(0.0f);
+    implicitTopology = false;
+    meshTopology = true;
 
-    prevT = clock(); // Record the current time for future time step calculations.
+    numThreads = ThreadPool::Shared().GetNumThreads(); // Use every available hardware thread by default.
+
+    solverMode = SOLVER_EXPLICIT;
+    implicitSubsteps = 1;
+    xpbdSubsteps = 4;
+    xpbdIterations = 2;
+    projectiveIterations = 5;
+
+    InitializeMesh(meshPositions, meshTriangles, fixedParticles, ordering);
 }
 
-// Destructor: Cleans up dynamically allocated memory and OpenGL resources.
+// Destructor: Cleans up dynamically allocated memory.
 Cloth::~Cloth()
 {
-    // Delete all particle, spring damper, and triangle objects.
-    for (auto it : particles) { delete it; }
-    for (auto it : connections) { delete it; }
+    // Delete all triangle objects. Particles and springs are stored by value.
     for (auto it : triangles) { delete it; }
-
-    // Delete OpenGL buffers and VAO.
-    glDeleteBuffers(2, vbos);
-    glDeleteBuffers(1, &ebo);
-    glDeleteVertexArrays(1, &vao);
 }
 
 // Initialize: Sets up the cloth simulation, creating particles, spring dampers, and triangles.
@@ -37,35 +67,22 @@ void Cloth::Initialize()
     // Calculate the length of each grid cell in the cloth.
     float gridLength = size / (numOfParticles - 1);
 
-    // Reserve space for positions and normals.
+    // Reserve space for positions.
     positions.resize(numOfParticles * numOfParticles);
-    normals.resize(numOfParticles * numOfParticles);
 
-    // Constants for aerodynamic force calculation.
-    FluidDensity = 1.225;
-    C_d = 1.0f;
-    WindVelocity = glm::vec3(0.5f, 0.5f, -2.5f);
+    SetDefaultCoefficients();
 
-    // Constants for spring damper calculation.
-    springConst = 1000.0f;
-    dampingConst = 3.5f; 
+    // Rest lengths of the grid springs.
     restLength = gridLength;
     restLengthDiag = gridLength * sqrt(2.0f); // Diagonal length for diagonal springs.
 
     // Particle properties.
     particleMass = mass / (numOfParticles * numOfParticles);
-    gravityAcce = 2.0f;
-    groundPos = 0.0f;
+    particleSystem.Resize(numOfParticles * numOfParticles, particleMass);
 
     // Ensure the ground position is below the lowest point of the cloth.
     if (groundPos > topLeftPos.y) groundPos = topLeftPos.y - EPSILON;
 
-    // Create a ground object for collision detection.
-    ground = new Ground(glm::vec3(-5.0f, groundPos, -5.0f), 10.0f, programID);
-
-    // Oversampling factor for numerical integration stability.
-    numOfOversamples = 20;
-
     // Calculate the direction normal to the cloth plane.
     glm::vec3 planeDir = glm::cross(horiDir, vertDir);
     planeDir.y = 0.0f; // Ensure it's horizontally aligned.
@@ -79,6 +96,8 @@ void Cloth::Initialize()
     // Create particles.
     // Loop over each grid cell and initialize particles at grid points.
     // Particles below the ground level are adjusted to sit on an imaginary plane.
+    prevPositions.resize(numOfParticles * numOfParticles);
+    if (!implicitTopology) particles.reserve(numOfParticles * numOfParticles);
     for (int y = 0; y < numOfParticles; y++)
     {
         for (int x = 0; x < numOfParticles; x++)
@@ -92,16 +111,17 @@ void Cloth::Initialize()
             {
                 int j = i - numOfParticles; // Previous row index.
                 positions[i] = positions[j] + gridLength * planeDir; // Adjust position.
-                normals[i] = glm::vec3(0.0f, -1.0f, 0.0f); // Normal pointing down.
+                particleSystem.normals[i] = glm::vec3(0.0f, -1.0f, 0.0f); // Normal pointing down.
             }
             else
             {
-                normals[i] = norm; // Normal pointing up for particles above ground.
+                particleSystem.normals[i] = norm; // Normal pointing up for particles above ground.
             }
 
-            // Create a new particle at the calculated position.
-            Particle* P = new Particle(&positions[i], &normals[i], &particleMass, &gravityAcce, &groundPos);
-            particles.push_back(P); // Add to particle list.
+            // Store the particle position and create a view onto it.
+            particleSystem.SetPosition(i, positions[i]);
+            prevPositions[i] = positions[i];
+            if (!implicitTopology) particles.push_back(Particle(&particleSystem, i)); // Add to particle list.
         }
     }
 
@@ -120,18 +140,38 @@ void Cloth::Initialize()
             // Define triangles for the square cell.
             indices.push_back(glm::ivec3(topLeftIdx, bottomLeftIdx, bottomRightIdx));
             indices.push_back(glm::ivec3(topLeftIdx, bottomRightIdx, topRightIdx));
+            if (implicitTopology) continue;
 
             // Create triangle objects for aerodynamic calculations.
             Triangle* tri;
-            tri = new Triangle(particles[topLeftIdx], particles[bottomLeftIdx], particles[bottomRightIdx], &FluidDensity, &C_d, &WindVelocity);
+            tri = new Triangle(&particles[topLeftIdx], &particles[bottomLeftIdx], &particles[bottomRightIdx], &FluidDensity, &C_d, &WindVelocity);
             triangles.push_back(tri);
-            tri = new Triangle(particles[topLeftIdx], particles[bottomRightIdx], particles[topRightIdx], &FluidDensity, &C_d, &WindVelocity);
+            tri = new Triangle(&particles[topLeftIdx], &particles[bottomRightIdx], &particles[topRightIdx], &FluidDensity, &C_d, &WindVelocity);
             triangles.push_back(tri);
         }
     }
 
+    // Set fixed points along one edge of the cloth to simulate attachment.
+    for (int i = 0; i < numOfParticles; i++)
+    {
+        fixedParticleIdx.push_back(i); // Store indices of fixed particles.
+        particleSystem.SetFixed(i, true, particleMass); // Mark particle as fixed, preventing it from moving.
+    }
+
+    // Resting regions of the cloth fall asleep tile by tile.
+    sleepTracker.BuildGrid(numOfParticles, numOfParticles, SLEEP_TILE_SIZE);
+
+    // The grid solver derives every spring and triangle from the particle layout.
+    gridSolver.Build(numOfParticles, numOfParticles);
+    if (implicitTopology)
+    {
+        maxSpringsPerParticle = numOfParticles > 2 ? 8 : 3;
+        return;
+    }
+
     // Create spring dampers for structural stability.
-    // Connects particles with spring dampers along grid edges and diagonals.
+    // Connects particles with spring dampers along grid edges (structural) and diagonals (shear).
+    // Each type is stored in its own packed array so the force pass streams through them.
     for (int y = 0; y < numOfParticles - 1; y++)
     {
         for (int x = 0; x < numOfParticles - 1; x++)
@@ -143,160 +183,722 @@ void Cloth::Initialize()
             int bottomRightIdx = bottomLeftIdx + 1;
 
             // Create spring dampers for each edge and diagonal.
-            SpringDamper* sp;
-            sp = new SpringDamper(particles[topLeftIdx], particles[topRightIdx], &springConst, &dampingConst, &restLength);
-            connections.push_back(sp);
-            sp = new SpringDamper(particles[topLeftIdx], particles[bottomRightIdx], &springConst, &dampingConst, &restLengthDiag);
-            connections.push_back(sp);
-            sp = new SpringDamper(particles[topLeftIdx], particles[bottomLeftIdx], &springConst, &dampingConst, &restLength);
-            connections.push_back(sp);
-            sp = new SpringDamper(particles[bottomLeftIdx], particles[topRightIdx], &springConst, &dampingConst, &restLengthDiag);
-            connections.push_back(sp);
+            structuralSprings.push_back({ topLeftIdx, topRightIdx, restLength });
+            shearSprings.push_back({ topLeftIdx, bottomRightIdx, restLengthDiag });
+            structuralSprings.push_back({ topLeftIdx, bottomLeftIdx, restLength });
+            shearSprings.push_back({ bottomLeftIdx, topRightIdx, restLengthDiag });
 
             // Add additional dampers for the last column and row edges.
             if (x == numOfParticles - 2)
             {
-                sp = new SpringDamper(particles[topRightIdx], particles[bottomRightIdx], &springConst, &dampingConst, &restLength);
-                connections.push_back(sp);
+                structuralSprings.push_back({ topRightIdx, bottomRightIdx, restLength });
             }
             if (y == numOfParticles - 2)
             {
-                sp = new SpringDamper(particles[bottomLeftIdx], particles[bottomRightIdx], &springConst, &dampingConst, &restLength);
-                connections.push_back(sp);
+                structuralSprings.push_back({ bottomLeftIdx, bottomRightIdx, restLength });
             }
         }
     }
 
-    // Set fixed points along one edge of the cloth to simulate attachment.
-    for (int i = 0; i < numOfParticles; i++)
+    BuildElementSolvers();
+
+    // The multigrid preconditioner coarsens the particle grid.
+    implicitSolver.SetGrid(numOfParticles, numOfParticles);
+}
+
+// SetDefaultCoefficients: Sets the force constants, the environment and the substepping to their defaults.
+void Cloth::SetDefaultCoefficients()
+{
+    // Constants for aerodynamic force calculation.
+    FluidDensity = 1.225;
+    C_d = 1.0f;
+    WindVelocity = glm::vec3(0.5f, 0.5f, -2.5f);
+
+    // Constants for spring damper calculation.
+    springConst = 1000.0f;
+    dampingConst = 3.5f; 
+
+    gravityAcce = 2.0f;
+    groundPos = 0.0f;
+
+    // Oversampling factor for numerical integration stability, used when adaptive substepping is off.
+    numOfOversamples = 20;
+
+    // Adaptive substepping derives the count from a stability estimate every frame, within these bounds.
+    adaptiveSubsteps = true;
+    minSubsteps = 1;
+    maxSubsteps = 200;
+    lastSubsteps = numOfOversamples;
+    averageSubsteps = (float)numOfOversamples;
+    totalSubsteps = 0;
+    accumulateNormals = false;
+    normalsAccumulated = false;
+}
+
+// InitializeMesh: Sets up the particles, springs and triangles of a mesh cloth.
+void Cloth::InitializeMesh(std::vector<glm::vec3> meshPositions, std::vector<glm::ivec3> meshTriangles, std::vector<int> fixedParticles, MeshOrdering ordering)
+{
+    SetDefaultCoefficients();
+
+    // Renumber the vertices for locality before anything refers to them, the index buffer included.
+    meshOrder = ComputeMeshOrdering(meshPositions, meshTriangles, ordering);
+    ApplyMeshOrdering(meshOrder, meshPositions, meshTriangles, fixedParticles);
+
+    // Unique edges, springs across shared edges and Voronoi masses, all from one pass over the triangles.
+    ClothMeshTopology topology;
+    topology.Build(meshPositions, meshTriangles, mass);
+    structuralSprings = std::move(topology.structural);
+    shearSprings = std::move(topology.bending);
+
+    // Element passes sweep the particles front to back, coloring keeps this order within each batch.
+    SortByLowestParticle(structuralSprings);
+    SortByLowestParticle(shearSprings);
+    SortByLowestParticle(meshTriangles);
+
+    // The shortest edge limits how far a particle may move per substep.
+    restLength = (float)EPSILON;
+    if (!structuralSprings.empty())
     {
-        fixedParticleIdx.push_back(i); // Store indices of fixed particles.
-        particles[i]->SetFixed(true); // Mark particle as fixed, preventing it from moving.
+        restLength = std::min_element(structuralSprings.begin(), structuralSprings.end(), [](const SpringDamper& a, const SpringDamper& b) { return a.restLength < b.restLength; })->restLength;
+        restLength = std::max(restLength, (float)EPSILON);
     }
-    
+    restLengthDiag = restLength * sqrt(2.0f);
+
+    // Every particle gets its own mass, particleMass is only their average.
+    int n = (int)meshPositions.size();
+    particleMass = mass / std::max(1, n);
+    particleSystem.Resize(n, particleMass);
+    particleMasses.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        particleMasses[i] = std::max(topology.masses[i], (float)EPSILON);
+        particleSystem.invMass[i] = 1.0f / particleMasses[i];
+    }
+
+    positions = meshPositions;
+    prevPositions = meshPositions;
+    particles.reserve(n);
+    float lowest = std::numeric_limits<float>::max();
+    for (int i = 0; i < n; i++)
+    {
+        particleSystem.SetPosition(i, positions[i]);
+        particles.push_back(Particle(&particleSystem, i));
+        lowest = std::min(lowest, positions[i].y);
+    }
+
+    // Ensure the ground position is below the lowest point of the cloth.
+    if (n > 0 && groundPos > lowest) groundPos = lowest - EPSILON;
+
+    // Triangles for the aerodynamic force, in the order of the index buffer.
+    indices = meshTriangles;
+    for (const glm::ivec3& t : indices)
+    {
+        triangles.push_back(new Triangle(&particles[t.x], &particles[t.y], &particles[t.z], &FluidDensity, &C_d, &WindVelocity));
+    }
+
+    for (int i : fixedParticles)
+    {
+        fixedParticleIdx.push_back(i);
+        particleSystem.SetFixed(i, true, particleMasses[i]);
+    }
+
+    // Tiles need the grid layout. The tracker only keeps one row of tiles in index order, and every particle of a
+    // mesh cloth stays awake for good.
+    sleepTracker.BuildGrid(n, 1, SLEEP_TILE_SIZE);
+    sleepTracker.KeepAwake();
 
-    // OpenGL setup for rendering the cloth.
-    glGenVertexArrays(1, &vao); // Generate a VAO for the cloth.
-    glGenBuffers(2, vbos); // Generate VBOs for positions and normals.
-    glGenBuffers(1, &ebo); // Generate an EBO for indices.
+    BuildElementSolvers();
 
-    // Bind and configure the VAO and VBOs for position and normal data.
-    // This includes uploading the initial positions and normals to the GPU.
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbos[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), nullptr, GL_STREAM_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+    // Initial normals from the rest shape.
+    std::vector<glm::ivec3> sortedIndices;
+    for (Triangle* tri : triangles) sortedIndices.push_back(tri->GetIndices());
+    ComputeFaceNormals(particleSystem, sortedIndices.data(), faceNormals.data(), 0, (int)sortedIndices.size());
+    GatherVertexNormals(normalAdjacency, faceNormals.data(), particleSystem.normals.data(), 0, n);
+}
+
+// BuildElementSolvers: Colors the springs and triangles and sets up everything that depends on them.
+void Cloth::BuildElementSolvers()
+{
+    // Group springs and triangles into batches that can be processed in parallel.
+    ColorBatches();
+
+    // Vertex normals gather the face normals of the color-sorted triangles.
+    std::vector<glm::ivec3> sortedIndices;
+    for (Triangle* tri : triangles) sortedIndices.push_back(tri->GetIndices());
+    normalAdjacency.Build(particleSystem.Size(), sortedIndices);
+    faceNormals.assign(triangles.size(), glm::vec3(0.0f));
+
+    // The stiffest particle is the one with the most springs attached, this bounds the stable time step.
+    std::vector<int> springsPerParticle(particleSystem.Size(), 0);
+    for (auto& sp : structuralSprings) { springsPerParticle[sp.i]++; springsPerParticle[sp.j]++; }
+    for (auto& sp : shearSprings) { springsPerParticle[sp.i]++; springsPerParticle[sp.j]++; }
+    maxSpringsPerParticle = springsPerParticle.empty() ? 0 : *std::max_element(springsPerParticle.begin(), springsPerParticle.end());
+
+    // The implicit solver reuses the sparsity pattern of the springs for the lifetime of the cloth.
+    implicitSolver.Build(particleSystem.Size(), { &structuralSprings, &shearSprings });
+
+    // XPBD projects the springs as distance constraints, one color batch at a time.
+    xpbdSolver.Build(particleSystem.Size(), { { &structuralSprings, &structuralBatches }, { &shearSprings, &shearBatches } });
+    projectiveSolver.Build(particleSystem.Size(), { { &structuralSprings, &structuralBatches }, { &shearSprings, &shearBatches } });
+
+    // Self-contact tests the triangles against the particles and the triangle edges against each other.
+    selfCollision.Build(particleSystem, sortedIndices);
+    selfCollision.SetThickness(0.25f * restLength);
+}
+
+void Cloth::Update(const SimulationClock& clock)
+{
+    // Take this frame's fixed steps, remembering the state before the last one for interpolation.
+    // The aero pass of the last substep also stores the face normals from its cross products.
+    int steps = clock.GetSteps();
+    normalsAccumulated = false;
+    for (int i = 0; i < steps; i++)
+    {
+        if (i == steps - 1)
+        {
+            particleSystem.GatherPositions(prevPositions);
+            accumulateNormals = true;
+        }
+        Step(clock.GetFixedDt());
+        accumulateNormals = false;
+    }
+
+    // Without a step the cloth has not moved and the normals are still valid.
+    if (steps > 0)
+    {
+        ScopedTimer timer(PROFILE_NORMALS);
+        glm::vec3* normals = particleSystem.normals.data();
+        int numParticlesTotal = particleSystem.Size();
+        int tasks = std::min(numThreads, numParticlesTotal / PARALLEL_GRAIN);
+
+        // Every particle writes only its own normal, so both paths split freely across threads without batches.
+        if (normalsAccumulated && sleepTracker.AnySleeping())
+        {
+            // Only particles next to an awake triangle can have a new normal: the awake tiles and their border.
+            for (auto* spans : { &sleepTracker.GetAwakeSpans(), &sleepTracker.GetBorderSpans() })
+            {
+                ThreadPool::Shared().ParallelFor((int)spans->size(), tasks, [&](int begin, int end)
+                    {
+                        for (int k = begin; k < end; k++) GatherVertexNormals(normalAdjacency, faceNormals.data(), normals, (*spans)[k].begin, (*spans)[k].end);
+                    });
+            }
+        }
+        else if (normalsAccumulated)
+        {
+            ThreadPool::Shared().ParallelFor(numParticlesTotal, tasks, [&](int begin, int end)
+                {
+                    GatherVertexNormals(normalAdjacency, faceNormals.data(), normals, begin, end);
+                });
+        }
+        else
+        {
+            // No face normals from the aero pass, the grid stencil reads the neighbours directly.
+            ThreadPool::Shared().ParallelFor(numOfParticles, tasks, [&](int begin, int end)
+                {
+                    ComputeGridNormals(particleSystem, numOfParticles, numOfParticles, normals, begin, end);
+                });
+        }
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbos[1]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normals.size(), nullptr, GL_STREAM_DRAW);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+    // Interleave the particle positions for rendering, interpolated between the last two simulated states.
+    particleSystem.GatherPositions(positions);
+    float alpha = clock.GetAlpha();
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        positions[i] = glm::mix(prevPositions[i], positions[i], alpha);
+    }
+}
 
-    // Bind and upload indices for the triangles to the EBO.
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(glm::ivec3) * indices.size(), indices.data(), GL_STATIC_DRAW);
+// Step: Advances the simulation by one fixed step with the selected solver.
+void Cloth::Step(float deltaT)
+{
+    // Only the explicit solver lets tiles sleep, the others always move the whole cloth.
+    if (solverMode != SOLVER_EXPLICIT) sleepTracker.WakeAll();
+    if (sleepTracker.TakeChanged()) UpdateActiveElements();
 
-    // Unbind from the VAO to prevent accidental modifications.
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    if (solverMode == SOLVER_IMPLICIT)
+    {
+        StepImplicit(deltaT);
+    }
+    else if (solverMode == SOLVER_XPBD)
+    {
+        StepXPBD(deltaT);
+    }
+    else if (solverMode == SOLVER_PROJECTIVE)
+    {
+        StepProjective(deltaT);
+    }
+    else if (solverMode == SOLVER_GRID)
+    {
+        StepGrid(deltaT);
+    }
+    else
+    {
+        StepExplicit(deltaT);
+    }
 }
 
-void Cloth::Update()
+// ComputeSubstepCount: Number of explicit substeps needed to advance deltaT stably.
+// The critical step of a damped mass-spring system is h = 2 / w * (sqrt(1 + z^2) - z), where the highest
+// frequency w is bounded by w^2 <= 2 * n * k / m (Gershgorin on the stiffness matrix, n springs per particle)
+// and z is the matching damping ratio. The step is further limited so no particle moves more than a fraction
+// of the rest length per substep, and shrunk while springs are strongly stretched.
+int Cloth::ComputeSubstepCount(float deltaT)
 {
-    // Measure the current time to calculate the frame rate and the time step.
-    clock_t currT = clock();
-    FPSCount++; // Increment the frame-per-second count.
-    interval += currT - prevT; // Accumulate the time since the last frame.
-    // Update the FPS counter once every second.
-    if (interval >= 1000)
+    if (!adaptiveSubsteps) return numOfOversamples;
+
+    // Lightest free particle and fastest particle, sleeping particles stand still.
+    float maxInvMass = 0.0f;
+    float maxSpeed2 = 0.0f;
+    for (const ParticleSpan& span : sleepTracker.GetAwakeSpans())
+    {
+        for (int i = span.begin; i < span.end; i++)
+        {
+            maxInvMass = std::max(maxInvMass, particleSystem.invMass[i]);
+            glm::vec3 v = particleSystem.GetVelocity(i);
+            maxSpeed2 = std::max(maxSpeed2, glm::dot(v, v));
+        }
+    }
+    if (maxInvMass == 0.0f || deltaT <= 0.0f) return minSubsteps;
+
+    // Largest relative stretch of any spring.
+    float maxStrain = implicitTopology ? GridSolver::MaxStrain(particleSystem, numOfParticles, numOfParticles, restLength, restLengthDiag) : 0.0f;
+    bool sleeping = sleepTracker.AnySleeping();
+    for (auto* springs : { sleeping ? &activeStructuralSprings : &structuralSprings, sleeping ? &activeShearSprings : &shearSprings })
     {
-        FPS = FPSCount; // Set the FPS value.
-        interval = 0; // Reset the time interval.
-        FPSCount = 0; // Reset the frame count.
+        for (const SpringDamper& sp : *springs)
+        {
+            float len = glm::length(particleSystem.GetPosition(sp.j) - particleSystem.GetPosition(sp.i));
+            maxStrain = std::max(maxStrain, std::abs(len - sp.restLength) / sp.restLength);
+        }
     }
-    float deltaT = (float)(currT - prevT) / 1000.0f; // Calculate the time step in seconds.
-    prevT = currT; // Update the previous time marker.
 
-    deltaT /= (float)numOfOversamples; // Adjust deltaT for oversampling.
+    // Critical time step of the stiffest, lightest particle.
+    float omega = sqrtf(2.0f * maxSpringsPerParticle * springConst * maxInvMass);
+    float zeta = maxSpringsPerParticle * dampingConst * maxInvMass / std::max(omega, (float)EPSILON);
+    float hCrit = omega > 0.0f ? 2.0f / omega * (sqrtf(1.0f + zeta * zeta) - zeta) : deltaT;
+
+    // Safety margin, shrunk further while the cloth is strongly stretched.
+    float h = 0.5f * hCrit / (1.0f + maxStrain);
+
+    // CFL-style limit: move at most half a rest length per substep.
+    float maxSpeed = sqrtf(maxSpeed2);
+    if (maxSpeed > EPSILON) h = std::min(h, 0.5f * restLength / maxSpeed);
+
+    int substeps = (int)std::ceil(deltaT / h);
+    return std::max(minSubsteps, std::min(maxSubsteps, substeps));
+}
+
+// StepExplicit: Advances the cloth by deltaT with explicit substeps, their number chosen by ComputeSubstepCount.
+void Cloth::StepExplicit(float deltaT)
+{
+    int substeps = ComputeSubstepCount(deltaT);
+    CountSubsteps(substeps);
+
+    // While tiles sleep, only the elements touching an awake particle and the awake particles are processed.
+    bool sleeping = sleepTracker.AnySleeping();
+    const std::vector<SpringDamper>& structural = sleeping ? activeStructuralSprings : structuralSprings;
+    const std::vector<SpringDamper>& shear = sleeping ? activeShearSprings : shearSprings;
+    const std::vector<ParticleSpan>& awakeSpans = sleepTracker.GetAwakeSpans();
+    const std::vector<ParticleSpan>& borderSpans = sleepTracker.GetBorderSpans();
+
+    deltaT /= (float)substeps; // Adjust deltaT for oversampling.
     // Perform physics calculations with oversampling for increased stability.
-    for (int i = 0; i < numOfOversamples; i++)
+    for (int i = 0; i < substeps; i++)
     {
-        // Compute forces for all spring dampers.
-        for (auto sp : connections)
+        // Compute forces for all spring dampers, one batched pass per spring type and color.
         {
-            sp->ComputeForce();
+            ScopedTimer timer(PROFILE_SPRINGS);
+            ParallelForBatches(sleeping ? activeStructuralBatches : structuralBatches, [&](int begin, int end)
+                {
+                    ComputeSpringForces(particleSystem, structural.data() + begin, end - begin, springConst, dampingConst);
+                });
+            ParallelForBatches(sleeping ? activeShearBatches : shearBatches, [&](int begin, int end)
+                {
+                    ComputeSpringForces(particleSystem, shear.data() + begin, end - begin, springConst, dampingConst);
+                });
         }
 
         // Compute aerodynamic forces for all triangles.
-        for (auto tri : triangles)
+        ComputeAerodynamicForces(i == substeps - 1);
+
+        // The last substep's forces decide which tiles are still moving.
+        if (i == substeps - 1) sleepTracker.Evaluate(particleSystem, gravityAcce, groundPos, numThreads);
+
+        // Integrate the motion of all particles in linear passes over the particle arrays.
         {
-            tri->ComputeAerodynamicForce();
+            ScopedTimer timer(PROFILE_INTEGRATE);
+            if (!sleeping)
+            {
+                int numParticlesTotal = particleSystem.Size();
+                ThreadPool::Shared().ParallelFor(numParticlesTotal, std::min(numThreads, numParticlesTotal / PARALLEL_GRAIN), [&](int begin, int end)
+                    {
+                        particleSystem.Integrate(deltaT, gravityAcce, groundPos, begin, end);
+                    });
+            }
+            else
+            {
+                // Awake tiles are integrated run by run. Sleeping particles next to them only drop the forces they received.
+                int numSpans = (int)awakeSpans.size();
+                ThreadPool::Shared().ParallelFor(numSpans, std::min(numThreads, sleepTracker.GetNumAwakeParticles() / PARALLEL_GRAIN), [&](int begin, int end)
+                    {
+                        for (int k = begin; k < end; k++) particleSystem.Integrate(deltaT, gravityAcce, groundPos, awakeSpans[k].begin, awakeSpans[k].end);
+                    });
+                for (const ParticleSpan& span : borderSpans)
+                {
+                    std::fill(particleSystem.fx.begin() + span.begin, particleSystem.fx.begin() + span.end, 0.0f);
+                    std::fill(particleSystem.fy.begin() + span.begin, particleSystem.fy.begin() + span.end, 0.0f);
+                    std::fill(particleSystem.fz.begin() + span.begin, particleSystem.fz.begin() + span.end, 0.0f);
+                }
+            }
         }
 
-        // Integrate the motion of all particles.
-        for (auto P : particles)
+        SolveSelfCollision(deltaT);
+        SolveColliders(deltaT);
+    }
+
+    // Sleeping tiles that a contact reached wake up, they held still during the step.
+    for (int i : selfCollision.GetWakeList()) sleepTracker.WakeParticle(i);
+    selfCollision.ClearWakeList();
+    if (HasColliders() && sleeping)
+    {
+        for (int i = 0; i < particleSystem.Size(); i++)
         {
-            P->Integrate(deltaT);
+            if (!colliderWake[i]) continue;
+            sleepTracker.WakeParticle(i);
+            colliderWake[i] = 0;
         }
     }
 
-    // Reset all normals to zero before recomputing them.
-    for (auto& n : normals)
+    // Tiles that rested long enough fall asleep, tiles next to moving ones wake up for the next step.
+    sleepTracker.Update(particleSystem);
+}
+
+// StepImplicit: Advances the cloth by deltaT with implicitSubsteps backward-Euler steps.
+// Each step is unconditionally stable, so a single large step per frame is usually enough even for stiff springs.
+void Cloth::StepImplicit(float deltaT)
+{
+    CountSubsteps(implicitSubsteps);
+    deltaT /= (float)implicitSubsteps;
+    for (int i = 0; i < implicitSubsteps; i++)
     {
-        n = glm::vec3(0.0f);
+        // Aerodynamic forces are treated explicitly, springs implicitly.
+        ComputeAerodynamicForces(i == implicitSubsteps - 1);
+        {
+            ScopedTimer timer(PROFILE_SOLVE);
+            implicitSolver.Step(particleSystem, deltaT, springConst, dampingConst, gravityAcce, groundPos, numThreads);
+        }
+        SolveSelfCollision(deltaT);
+        SolveColliders(deltaT);
     }
+}
 
-    // Compute normals for all triangles to reflect changes in the cloth's shape.
-    for (auto tri : triangles)
+// StepXPBD: Advances the cloth by deltaT with xpbdSubsteps position-based substeps.
+void Cloth::StepXPBD(float deltaT)
+{
+    CountSubsteps(xpbdSubsteps);
+    deltaT /= (float)xpbdSubsteps;
+    for (int i = 0; i < xpbdSubsteps; i++)
     {
-        tri->ComputeNormal();
+        // Aerodynamic forces enter the prediction step, springs are solved as constraints.
+        ComputeAerodynamicForces(i == xpbdSubsteps - 1);
+        {
+            ScopedTimer timer(PROFILE_SOLVE);
+            xpbdSolver.Substep(particleSystem, deltaT, xpbdIterations, springConst, dampingConst, gravityAcce, groundPos, numThreads);
+        }
+        SolveSelfCollision(deltaT);
+        SolveColliders(deltaT);
     }
+}
 
-    // Normalize all normals after computation.
-    for (auto& n : normals)
+// StepProjective: Advances the cloth by one projective dynamics step.
+// The simulation clock's step is fixed, so the prefactored global matrix stays valid from frame to frame.
+void Cloth::StepProjective(float deltaT)
+{
+    CountSubsteps(1);
+    ComputeAerodynamicForces(true);
     {
-        n = glm::normalize(n);
+        ScopedTimer timer(PROFILE_SOLVE);
+        projectiveSolver.Step(particleSystem, deltaT, projectiveIterations, springConst, dampingConst, gravityAcce, groundPos, numThreads);
     }
+    SolveSelfCollision(deltaT);
+    SolveColliders(deltaT);
+}
+
+// StepGrid: Advances the cloth by deltaT with explicit substeps of the grid stencil solver.
+// Springs, drag and integration run in a single sweep per substep, their number chosen by ComputeSubstepCount.
+void Cloth::StepGrid(float deltaT)
+{
+    int substeps = ComputeSubstepCount(deltaT);
+    CountSubsteps(substeps);
+    deltaT /= (float)substeps;
+
+    GridParams params = { springConst, dampingConst, restLength, restLengthDiag, FluidDensity, C_d, WindVelocity, gravityAcce, groundPos };
+    ScopedTimer timer(PROFILE_SOLVE);
+    gridSolver.Step(particleSystem, deltaT, substeps, params, numThreads);
+}
 
-    // Transfer updated positions and normals to their respective VBOs for rendering.
-    glBindBuffer(GL_ARRAY_BUFFER, vbos[0]);
-    void* ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-    memcpy(ptr, positions.data(), sizeof(glm::vec3) * positions.size());
-    glUnmapBuffer(GL_ARRAY_BUFFER);
+// SolveSelfCollision: Separates the cloth where it touches itself after a substep of length deltaT.
+void Cloth::SolveSelfCollision(float deltaT)
+{
+    if (!selfCollision.GetEnabled()) return;
+    ScopedTimer timer(PROFILE_COLLISION);
+    selfCollision.Solve(particleSystem, deltaT, &sleepTracker, numThreads);
+}
+
+// SolveColliders: Pushes the particles out of the external colliders after a substep of length deltaT.
+// Every particle is independent, so they are split across threads. Sleeping particles are not moved, only flagged.
+void Cloth::SolveColliders(float deltaT)
+{
+    if (!HasColliders()) return;
+    ScopedTimer timer(PROFILE_COLLISION);
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbos[1]);
-    ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-    memcpy(ptr, normals.data(), sizeof(glm::vec3) * normals.size());
-    glUnmapBuffer(GL_ARRAY_BUFFER);
+    int n = particleSystem.Size();
+    bool sleeping = sleepTracker.AnySleeping();
+    colliderWake.resize(n, 0);
+    ThreadPool::Shared().ParallelFor(n, std::min(numThreads, n / PARALLEL_GRAIN), [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                if (particleSystem.invMass[i] == 0.0f) continue;
+                glm::vec3 x = particleSystem.GetPosition(i);
+                if (sleeping && !sleepTracker.IsAwake(i))
+                {
+                    for (const MeshCollider* collider : meshColliders) colliderWake[i] |= collider->Touches(x);
+                    for (const BoxCollider* collider : boxColliders) colliderWake[i] |= collider->Touches(x);
+                    for (const DistanceCollider* collider : distanceColliders) colliderWake[i] |= collider->Touches(x);
+                    continue;
+                }
+
+                glm::vec3 v = particleSystem.GetVelocity(i);
+                bool hit = false;
+                for (const MeshCollider* collider : meshColliders) hit |= collider->Collide(x, v, deltaT);
+                for (const BoxCollider* collider : boxColliders) hit |= collider->Collide(x, v, deltaT);
+                for (const DistanceCollider* collider : distanceColliders) hit |= collider->Collide(x, v, deltaT);
+                if (!hit) continue;
+                particleSystem.SetPosition(i, x);
+                particleSystem.vx[i] = v.x;
+                particleSystem.vy[i] = v.y;
+                particleSystem.vz[i] = v.z;
+            }
+        });
 }
 
-void Cloth::Draw(const glm::mat4& viewProjMtx)
+// AddCollider: Lets the cloth collide with a mesh, once.
+void Cloth::AddCollider(const MeshCollider* collider)
 {
-    // Use the specified shader program for drawing.
-    glUseProgram(programID);
+    if (std::find(meshColliders.begin(), meshColliders.end(), collider) == meshColliders.end()) meshColliders.push_back(collider);
+    sleepTracker.WakeAll();
+}
 
-    glm::mat4 model(1.0); // Model matrix for the cloth.
-    glm::vec3 color(0.9f, 0.01f, 0.01f); // Color of the cloth.
+// RemoveCollider: Stops colliding with a mesh.
+void Cloth::RemoveCollider(const MeshCollider* collider)
+{
+    meshColliders.erase(std::remove(meshColliders.begin(), meshColliders.end(), collider), meshColliders.end());
+    sleepTracker.WakeAll();
+}
 
-    // Pass view projection matrix, model matrix, and color to the shader.
-    glUniformMatrix4fv(glGetUniformLocation(programID, "viewProj"), 1, GL_FALSE, (float*)&viewProjMtx);
-    glUniformMatrix4fv(glGetUniformLocation(programID, "model"), 1, GL_FALSE, (float*)&model);
-    glUniform3fv(glGetUniformLocation(programID, "DiffuseColor"), 1, &color[0]);
+// AddCollider: Lets the cloth collide with a skeleton's boxes, once.
+void Cloth::AddCollider(const BoxCollider* collider)
+{
+    if (std::find(boxColliders.begin(), boxColliders.end(), collider) == boxColliders.end()) boxColliders.push_back(collider);
+    sleepTracker.WakeAll();
+}
 
-    // Bind the VAO for the cloth.
-    glBindVertexArray(vao);
+// RemoveCollider: Stops colliding with a skeleton's boxes.
+void Cloth::RemoveCollider(const BoxCollider* collider)
+{
+    boxColliders.erase(std::remove(boxColliders.begin(), boxColliders.end(), collider), boxColliders.end());
+    sleepTracker.WakeAll();
+}
 
-    // Draw the cloth using triangles, as specified by the indices in the EBO.
-    glDrawElements(GL_TRIANGLES, indices.size() * 3, GL_UNSIGNED_INT, 0);
+// AddCollider: Lets the cloth collide with a distance field, once.
+void Cloth::AddCollider(const DistanceCollider* collider)
+{
+    if (std::find(distanceColliders.begin(), distanceColliders.end(), collider) == distanceColliders.end()) distanceColliders.push_back(collider);
+    sleepTracker.WakeAll();
+}
 
-    // Unbind the VAO and the shader program.
-    glBindVertexArray(0);
-    glUseProgram(0);
+// RemoveCollider: Stops colliding with a distance field.
+void Cloth::RemoveCollider(const DistanceCollider* collider)
+{
+    distanceColliders.erase(std::remove(distanceColliders.begin(), distanceColliders.end(), collider), distanceColliders.end());
+    sleepTracker.WakeAll();
+}
 
-    // Draw the ground for context.
-    ground->Draw(viewProjMtx);
+// CountSubsteps: Records the number of substeps taken by the last step for display and throughput statistics.
+void Cloth::CountSubsteps(int substeps)
+{
+    lastSubsteps = substeps;
+    averageSubsteps = 0.95f * averageSubsteps + 0.05f * substeps; // Running average for display.
+    totalSubsteps += substeps;
 }
+
+// ComputeAerodynamicForces: Accumulates the wind drag of all triangles into the particle forces.
+// On the last substep of a frame the same sweep also stores the face normals for the vertex normal gather.
+// Those normals are one substep behind the final positions.
+void Cloth::ComputeAerodynamicForces(bool lastSubstep)
+{
+    ScopedTimer timer(PROFILE_AERO);
+
+    bool withNormals = lastSubstep && accumulateNormals;
+    if (withNormals) normalsAccumulated = true;
+
+    // Triangles of sleeping tiles keep the face normals they had when they fell asleep.
+    if (sleepTracker.AnySleeping())
+    {
+        ParallelForBatches(activeTriangleBatches, [&](int begin, int end)
+            {
+                for (int k = begin; k < end; k++)
+                {
+                    int t = activeTriangles[k];
+                    triangles[t]->ComputeAerodynamicForce(withNormals ? &faceNormals[t] : nullptr);
+                }
+            });
+        return;
+    }
+
+    ParallelForBatches(triangleBatches, [&](int begin, int end)
+        {
+            for (int t = begin; t < end; t++) triangles[t]->ComputeAerodynamicForce(withNormals ? &faceNormals[t] : nullptr);
+        });
+}
+
+// ColorBatches: Reorders springs and triangles into color batches where no two elements share a particle.
+void Cloth::ColorBatches()
+{
+    int numParticlesTotal = particleSystem.Size();
+    std::vector<int> colors;
+    int numColors;
+
+    // Springs touch their two endpoints.
+    numColors = ColorElements(numParticlesTotal, (int)structuralSprings.size(), [&](int e, int* verts)
+        {
+            verts[0] = structuralSprings[e].i;
+            verts[1] = structuralSprings[e].j;
+            return 2;
+        }, colors);
+    SortByColor(structuralSprings, colors, numColors, structuralBatches);
+
+    numColors = ColorElements(numParticlesTotal, (int)shearSprings.size(), [&](int e, int* verts)
+        {
+            verts[0] = shearSprings[e].i;
+            verts[1] = shearSprings[e].j;
+            return 2;
+        }, colors);
+    SortByColor(shearSprings, colors, numColors, shearBatches);
+
+    // Triangles touch their three corners, which are listed in the same order in the index buffer.
+    numColors = ColorElements(numParticlesTotal, (int)triangles.size(), [&](int e, int* verts)
+        {
+            verts[0] = indices[e].x;
+            verts[1] = indices[e].y;
+            verts[2] = indices[e].z;
+            return 3;
+        }, colors);
+    SortByColor(triangles, colors, numColors, triangleBatches);
+}
+
+// UpdateActiveElements: Keeps the springs and triangles that touch an awake particle, batch by batch in their
+// original order, so every batch stays free of conflicts.
+void Cloth::UpdateActiveElements()
+{
+    activeStructuralSprings.clear();
+    activeShearSprings.clear();
+    activeTriangles.clear();
+    activeStructuralBatches.assign(1, 0);
+    activeShearBatches.assign(1, 0);
+    activeTriangleBatches.assign(1, 0);
+    if (!sleepTracker.AnySleeping()) return;
+
+    auto filterSprings = [&](const std::vector<SpringDamper>& springs, const std::vector<int>& batches, std::vector<SpringDamper>& active, std::vector<int>& activeBatches)
+    {
+        for (size_t c = 0; c + 1 < batches.size(); c++)
+        {
+            for (int e = batches[c]; e < batches[c + 1]; e++)
+            {
+                if (sleepTracker.IsAwake(springs[e].i) || sleepTracker.IsAwake(springs[e].j)) active.push_back(springs[e]);
+            }
+            activeBatches.push_back((int)active.size());
+        }
+    };
+    filterSprings(structuralSprings, structuralBatches, activeStructuralSprings, activeStructuralBatches);
+    filterSprings(shearSprings, shearBatches, activeShearSprings, activeShearBatches);
+
+    for (size_t c = 0; c + 1 < triangleBatches.size(); c++)
+    {
+        for (int t = triangleBatches[c]; t < triangleBatches[c + 1]; t++)
+        {
+            glm::ivec3 tri = triangles[t]->GetIndices();
+            if (sleepTracker.IsAwake(tri.x) || sleepTracker.IsAwake(tri.y) || sleepTracker.IsAwake(tri.z)) activeTriangles.push_back(t);
+        }
+        activeTriangleBatches.push_back((int)activeTriangles.size());
+    }
+}
+
+// ParallelForBatches: Runs body over the color batches one after another, splitting each batch across threads.
+void Cloth::ParallelForBatches(const std::vector<int>& offsets, const std::function<void(int, int)>& body)
+{
+    ThreadPool::Shared().ParallelForBatches(offsets, numThreads, PARALLEL_GRAIN, body);
+}
+
+// GetLocalityReport: Measures the spring and triangle passes in their colored order.
+MeshLocalityReport Cloth::GetLocalityReport() const
+{
+    std::vector<glm::ivec3> sortedIndices;
+    for (Triangle* tri : triangles) sortedIndices.push_back(tri->GetIndices());
+    return MeasureLocality({ &structuralSprings, &shearSprings }, sortedIndices);
+}
+
+// SetMass: Changes the total mass. Mesh particles keep their share of it.
+void Cloth::SetMass(float m)
+{
+    if (meshTopology)
+    {
+        float scale = m / mass;
+        for (int i = 0; i < particleSystem.Size(); i++)
+        {
+            particleMasses[i] *= scale;
+            if (!particleSystem.IsFixed(i)) particleSystem.invMass[i] = 1.0f / particleMasses[i];
+        }
+        particleMass = m / std::max(1, particleSystem.Size());
+    }
+    else
+    {
+        particleMass = m / (numOfParticles * numOfParticles);
+        particleSystem.SetMass(particleMass);
+    }
+    mass = m;
+    sleepTracker.WakeAll();
+}
+
+// SetFixed: Pins or releases a particle with its own mass.
+void Cloth::SetFixed(int i, bool isFixed)
+{
+    particleSystem.SetFixed(i, isFixed, GetParticleMass(i));
+    sleepTracker.WakeParticle(i);
+}
+
+// SetRestLength: Sets the rest length of the grid springs, or scales the mesh so that its shortest edge has length l.
+void Cloth::SetRestLength(float l)
+{
+    if (meshTopology)
+    {
+        float scale = l / restLength;
+        for (auto& sp : structuralSprings) sp.restLength *= scale;
+        for (auto& sp : shearSprings) sp.restLength *= scale;
+    }
+    else
+    {
+        for (auto& sp : structuralSprings) sp.restLength = l;
+        for (auto& sp : shearSprings) sp.restLength = l * 1.4142136f;
+    }
+    if (restLength > 0.0f) selfCollision.Rescale(l / restLength);
+    restLength = l;
+    restLengthDiag = l * 1.4142136f;
+    sleepTracker.WakeAll();
+}
+
 void Cloth::TranslateFixedParticles(int axis, float shift)
 {
     // Create a translation vector along the specified axis.
@@ -306,7 +908,8 @@ void Cloth::TranslateFixedParticles(int axis, float shift)
     // Apply the translation to all fixed particles.
     for (int i : fixedParticleIdx)
     {
-        positions[i] += delta; // Update the position of each fixed particle.
+        particleSystem.SetPosition(i, particleSystem.GetPosition(i) + delta); // Update the position of each fixed particle.
+        sleepTracker.WakeParticle(i);
     }
 }
 
@@ -328,8 +931,10 @@ void Cloth::RotateFixedParticles(int axis, float shift)
         rotateMat = glm::eulerAngleZ(shift);
     }
 
+    if (fixedParticleIdx.empty()) return;
+
     // Calculate the midpoint between the first and last fixed particles.
-    glm::vec3 midPoint = (positions[fixedParticleIdx.front()] + positions[fixedParticleIdx.back()]) / 2.0f;
+    glm::vec3 midPoint = (particleSystem.GetPosition(fixedParticleIdx.front()) + particleSystem.GetPosition(fixedParticleIdx.back())) / 2.0f;
 
     // Create a transformation matrix that rotates around the midpoint.
     glm::mat4 TransMat = glm::translate(midPoint) * rotateMat * glm::translate(-midPoint);
@@ -337,6 +942,7 @@ void Cloth::RotateFixedParticles(int axis, float shift)
     // Apply the rotation to all fixed particles.
     for (int i : fixedParticleIdx)
     {
-        positions[i] = TransMat * glm::vec4(positions[i], 1.0f); // Update the position of each fixed particle.
+        particleSystem.SetPosition(i, TransMat * glm::vec4(particleSystem.GetPosition(i), 1.0f)); // Update the position of each fixed particle.
+        sleepTracker.WakeParticle(i);
     }
 }
@@ -0,0 +1,403 @@
+#include "ClothMesh.h"
+
+// An edge slot of the hash map: the sorted vertex pair, the vertex opposite the edge in its first triangle
+// and how many triangles share it.
+struct EdgeSlot
+{
+    uint64_t key;
+    int opposite;
+    int count;
+};
+
+// Keys are never 0, a vertex pair with a == b is skipped before it reaches the map.
+#define EDGE_EMPTY 0
+
+// EdgeKey: Packs the sorted vertex pair of an edge into one 64-bit key.
+static inline uint64_t EdgeKey(int a, int b)
+{
+    uint32_t lo = (uint32_t)std::min(a, b), hi = (uint32_t)std::max(a, b);
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// VoronoiAreas: Mixed Voronoi area of every vertex. A non-obtuse triangle gives each corner its Voronoi region,
+// (|ab|^2 cot c + |ac|^2 cot b) / 8 for corner a. An obtuse triangle gives half its area to the obtuse corner and
+// a quarter to each other one, as the Voronoi region would reach outside the triangle.
+static void VoronoiAreas(const std::vector<glm::vec3>& positions, const std::vector<glm::ivec3>& tris, std::vector<float>& areas)
+{
+    areas.assign(positions.size(), 0.0f);
+    for (const glm::ivec3& t : tris)
+    {
+        int v[3] = { t.x, t.y, t.z };
+        glm::vec3 p[3] = { positions[t.x], positions[t.y], positions[t.z] };
+        float area = 0.5f * glm::length(glm::cross(p[1] - p[0], p[2] - p[0]));
+        if (area <= EPSILON) continue;
+
+        // Dot products at each corner, negative at an obtuse corner.
+        float d[3];
+        int obtuse = -1;
+        for (int k = 0; k < 3; k++)
+        {
+            d[k] = glm::dot(p[(k + 1) % 3] - p[k], p[(k + 2) % 3] - p[k]);
+            if (d[k] < 0.0f) obtuse = k;
+        }
+
+        if (obtuse >= 0)
+        {
+            for (int k = 0; k < 3; k++) areas[v[k]] += k == obtuse ? 0.5f * area : 0.25f * area;
+            continue;
+        }
+
+        // cot of corner k is d[k] / (2 * area).
+        for (int k = 0; k < 3; k++)
+        {
+            int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+            float e1 = glm::dot(p[k1] - p[k], p[k1] - p[k]);
+            float e2 = glm::dot(p[k2] - p[k], p[k2] - p[k]);
+            areas[v[k]] += (e1 * d[k2] + e2 * d[k1]) / (16.0f * area);
+        }
+    }
+}
+
+// Build: One pass over the triangle edges. The first visit of an edge adds its structural spring and remembers the
+// opposite vertex, the second visit adds the spring between the two opposite vertices.
+void ClothMeshTopology::Build(const std::vector<glm::vec3>& positions, const std::vector<glm::ivec3>& tris, float totalMass)
+{
+    structural.clear();
+    bending.clear();
+    nonManifoldEdges = 0;
+
+    // At most three edges per triangle, the table is kept at most half full.
+    size_t capacity = 16;
+    while (capacity < 6 * tris.size()) capacity *= 2;
+    std::vector<EdgeSlot> table(capacity, { EDGE_EMPTY, -1, 0 });
+    const size_t mask = capacity - 1;
+    structural.reserve(3 * tris.size() / 2 + 1);
+    bending.reserve(3 * tris.size() / 2 + 1);
+
+    auto restLength = [&](int a, int b) { return glm::length(positions[b] - positions[a]); };
+    for (const glm::ivec3& t : tris)
+    {
+        int v[3] = { t.x, t.y, t.z };
+        for (int k = 0; k < 3; k++)
+        {
+            int a = v[k], b = v[(k + 1) % 3], opposite = v[(k + 2) % 3];
+            if (a == b) continue;
+
+            uint64_t key = EdgeKey(a, b);
+            size_t h = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+            while (table[h].key != EDGE_EMPTY && table[h].key != key) h = (h + 1) & mask;
+
+            EdgeSlot& slot = table[h];
+            if (slot.key == EDGE_EMPTY)
+            {
+                slot = { key, opposite, 1 };
+                structural.push_back({ std::min(a, b), std::max(a, b), restLength(a, b) });
+                continue;
+            }
+
+            if (++slot.count == 2 && slot.opposite != opposite && opposite != a && opposite != b)
+            {
+                bending.push_back({ slot.opposite, opposite, restLength(slot.opposite, opposite) });
+            }
+            if (slot.count == 3) nonManifoldEdges++;
+        }
+    }
+
+    // Vertices outside every triangle have no area, they get the average mass.
+    std::vector<float> areas;
+    VoronoiAreas(positions, tris, areas);
+    double totalArea = 0.0;
+    for (float a : areas) totalArea += a;
+
+    int n = (int)positions.size();
+    masses.resize(n);
+    float averageMass = n > 0 ? totalMass / n : 0.0f;
+    for (int i = 0; i < n; i++)
+    {
+        masses[i] = areas[i] > 0.0f && totalArea > 0.0 ? (float)(totalMass * areas[i] / totalArea) : averageMass;
+    }
+}
+
+// Bits per axis of the space-filling curve keys.
+#define CURVE_BITS 10
+
+// Geometry of the simulated cache of MeasureLocality.
+#define CACHE_SETS 64
+#define CACHE_WAYS 8
+#define CACHE_LINE_FLOATS 16
+
+// QuantizePosition: Grid cell of a position inside the bounding box, CURVE_BITS bits per axis.
+static inline void QuantizePosition(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& scale, uint32_t X[3])
+{
+    const float maxCell = (float)((1u << CURVE_BITS) - 1);
+    for (int a = 0; a < 3; a++) X[a] = (uint32_t)glm::clamp((p[a] - lo[a]) * scale[a], 0.0f, maxCell);
+}
+
+// InterleaveBits: Key with bit b of axis a at position 3 * b + (2 - a).
+static inline uint32_t InterleaveBits(const uint32_t X[3])
+{
+    uint32_t key = 0;
+    for (int b = CURVE_BITS - 1; b >= 0; b--)
+    {
+        for (int a = 0; a < 3; a++) key = (key << 1) | ((X[a] >> b) & 1);
+    }
+    return key;
+}
+
+// HilbertTranspose: Turns cell coordinates into the transposed Hilbert index in place (Skilling 2004), whose
+// interleaved bits are the position along the curve.
+static inline void HilbertTranspose(uint32_t X[3])
+{
+    const uint32_t M = 1u << (CURVE_BITS - 1);
+
+    // Inverse undo of the excess work.
+    for (uint32_t Q = M; Q > 1; Q >>= 1)
+    {
+        uint32_t P = Q - 1;
+        for (int i = 0; i < 3; i++)
+        {
+            if (X[i] & Q) X[0] ^= P;
+            else
+            {
+                uint32_t t = (X[0] ^ X[i]) & P;
+                X[0] ^= t;
+                X[i] ^= t;
+            }
+        }
+    }
+
+    // Gray encode.
+    for (int i = 1; i < 3; i++) X[i] ^= X[i - 1];
+    uint32_t t = 0;
+    for (uint32_t Q = M; Q > 1; Q >>= 1)
+    {
+        if (X[2] & Q) t ^= Q - 1;
+    }
+    for (int i = 0; i < 3; i++) X[i] ^= t;
+}
+
+// CurveOrdering: Sorts the vertices along the Morton or Hilbert curve through their bounding box.
+static std::vector<int> CurveOrdering(const std::vector<glm::vec3>& positions, bool hilbert)
+{
+    int n = (int)positions.size();
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (const glm::vec3& p : positions)
+    {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+
+    // One scale for all axes keeps the cells cubic.
+    float extent = std::max(std::max(hi.x - lo.x, hi.y - lo.y), std::max(hi.z - lo.z, (float)EPSILON));
+    glm::vec3 scale(((1u << CURVE_BITS) - 1) / extent);
+
+    std::vector<std::pair<uint32_t, int>> keys(n);
+    for (int i = 0; i < n; i++)
+    {
+        uint32_t X[3];
+        QuantizePosition(positions[i], lo, scale, X);
+        if (hilbert) HilbertTranspose(X);
+        keys[i] = { InterleaveBits(X), i };
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<int> newIndex(n);
+    for (int k = 0; k < n; k++) newIndex[keys[k].second] = k;
+    return newIndex;
+}
+
+// RCMOrdering: Reverse Cuthill-McKee. Every connected component is numbered breadth first from a vertex far from
+// the others, visiting the neighbours of each vertex by increasing degree, and the whole order is reversed.
+static std::vector<int> RCMOrdering(int n, const std::vector<glm::ivec3>& tris)
+{
+    // Vertex adjacency in compressed rows, built with a counting sort over the triangle edges.
+    std::vector<int> rowStart(n + 1, 0);
+    for (const glm::ivec3& t : tris)
+    {
+        for (int k = 0; k < 3; k++) rowStart[t[k] + 1] += 2;
+    }
+    for (int v = 0; v < n; v++) rowStart[v + 1] += rowStart[v];
+    std::vector<int> adjacent(rowStart[n]);
+    std::vector<int> next(rowStart.begin(), rowStart.end() - 1);
+    for (const glm::ivec3& t : tris)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            adjacent[next[t[k]]++] = t[(k + 1) % 3];
+            adjacent[next[t[k]]++] = t[(k + 2) % 3];
+        }
+    }
+
+    // An interior edge is listed by both of its triangles, keep it once.
+    std::vector<int> degree(n);
+    for (int v = 0; v < n; v++)
+    {
+        auto begin = adjacent.begin() + rowStart[v], end = adjacent.begin() + rowStart[v + 1];
+        std::sort(begin, end);
+        degree[v] = (int)(std::unique(begin, end) - begin);
+    }
+    for (int v = 0; v < n; v++)
+    {
+        auto begin = adjacent.begin() + rowStart[v];
+        std::sort(begin, begin + degree[v], [&](int a, int b) { return degree[a] < degree[b] || (degree[a] == degree[b] && a < b); });
+    }
+
+    // Breadth-first numbering from start, returns the last vertex reached.
+    std::vector<int> order;
+    order.reserve(n);
+    std::vector<int> visit(n, -1);
+    auto breadthFirst = [&](int start, int stamp, bool record)
+    {
+        size_t head = order.size();
+        size_t first = head;
+        order.push_back(start);
+        visit[start] = stamp;
+        int last = start;
+        while (head < order.size())
+        {
+            int v = order[head++];
+            last = v;
+            for (int a = rowStart[v]; a < rowStart[v] + degree[v]; a++)
+            {
+                int w = adjacent[a];
+                if (visit[w] == stamp) continue;
+                visit[w] = stamp;
+                order.push_back(w);
+            }
+        }
+        if (!record) order.resize(first);
+        return last;
+    };
+
+    // Components are started from their lowest-degree vertex in index order, then moved to the far end of a
+    // breadth-first pass from there, a cheap pseudo-peripheral vertex.
+    std::vector<int> byDegree(n);
+    for (int v = 0; v < n; v++) byDegree[v] = v;
+    std::stable_sort(byDegree.begin(), byDegree.end(), [&](int a, int b) { return degree[a] < degree[b]; });
+    int stamp = 0;
+    for (int v : byDegree)
+    {
+        if (visit[v] >= 0 && visit[v] % 2 == 1) continue;
+        int far = breadthFirst(v, 2 * stamp, false);
+        breadthFirst(far, 2 * stamp + 1, true);
+        stamp++;
+    }
+
+    std::vector<int> newIndex(n);
+    for (int k = 0; k < n; k++) newIndex[order[k]] = n - 1 - k;
+    return newIndex;
+}
+
+// ComputeMeshOrdering: New index of every vertex under the chosen ordering.
+std::vector<int> ComputeMeshOrdering(const std::vector<glm::vec3>& positions, const std::vector<glm::ivec3>& tris, MeshOrdering ordering)
+{
+    int n = (int)positions.size();
+    if (ordering == MESH_ORDER_MORTON || ordering == MESH_ORDER_HILBERT) return CurveOrdering(positions, ordering == MESH_ORDER_HILBERT);
+    if (ordering == MESH_ORDER_RCM) return RCMOrdering(n, tris);
+
+    std::vector<int> identity(n);
+    for (int i = 0; i < n; i++) identity[i] = i;
+    return identity;
+}
+
+// ApplyMeshOrdering: Moves vertex i to newIndex[i] and renames every reference to it.
+void ApplyMeshOrdering(const std::vector<int>& newIndex, std::vector<glm::vec3>& positions, std::vector<glm::ivec3>& tris, std::vector<int>& vertices)
+{
+    std::vector<glm::vec3> moved(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) moved[newIndex[i]] = positions[i];
+    positions.swap(moved);
+
+    for (glm::ivec3& t : tris) t = glm::ivec3(newIndex[t.x], newIndex[t.y], newIndex[t.z]);
+    for (int& v : vertices) v = newIndex[v];
+}
+
+// SortByLowestParticle: Orders springs by (lower, upper) endpoint, each stored lower end first.
+void SortByLowestParticle(std::vector<SpringDamper>& springs)
+{
+    for (SpringDamper& sp : springs)
+    {
+        if (sp.i > sp.j) std::swap(sp.i, sp.j);
+    }
+    std::sort(springs.begin(), springs.end(), [](const SpringDamper& a, const SpringDamper& b) { return a.i < b.i || (a.i == b.i && a.j < b.j); });
+}
+
+// SortByLowestParticle: Orders triangles by their lowest corner, keeping the winding of every triangle.
+void SortByLowestParticle(std::vector<glm::ivec3>& tris)
+{
+    auto lowest = [](const glm::ivec3& t) { return std::min(t.x, std::min(t.y, t.z)); };
+    std::stable_sort(tris.begin(), tris.end(), [&](const glm::ivec3& a, const glm::ivec3& b) { return lowest(a) < lowest(b); });
+}
+
+// CacheModel: Set-associative LRU cache over the cache lines of a float array.
+struct CacheModel
+{
+    int64_t tags[CACHE_SETS][CACHE_WAYS];
+    int64_t lastUse[CACHE_SETS][CACHE_WAYS];
+    int64_t clock = 0;
+    long long misses = 0;
+
+    CacheModel()
+    {
+        for (int s = 0; s < CACHE_SETS; s++)
+        {
+            for (int w = 0; w < CACHE_WAYS; w++) { tags[s][w] = -1; lastUse[s][w] = -1; }
+        }
+    }
+
+    void Access(int particle)
+    {
+        int64_t line = particle / CACHE_LINE_FLOATS;
+        int s = (int)(line % CACHE_SETS);
+        int victim = 0;
+        clock++;
+        for (int w = 0; w < CACHE_WAYS; w++)
+        {
+            if (tags[s][w] == line)
+            {
+                lastUse[s][w] = clock;
+                return;
+            }
+            if (lastUse[s][w] < lastUse[s][victim]) victim = w;
+        }
+        misses++;
+        tags[s][victim] = line;
+        lastUse[s][victim] = clock;
+    }
+};
+
+// MeasureLocality: Index spans of the springs and simulated misses of a pass over the springs and one over the triangles.
+MeshLocalityReport MeasureLocality(const std::vector<const std::vector<SpringDamper>*>& springs, const std::vector<glm::ivec3>& tris)
+{
+    MeshLocalityReport report;
+
+    CacheModel springCache;
+    long long numSprings = 0;
+    double spanSum = 0.0;
+    for (const std::vector<SpringDamper>* group : springs)
+    {
+        for (const SpringDamper& sp : *group)
+        {
+            int span = std::abs(sp.i - sp.j);
+            spanSum += span;
+            report.bandwidth = std::max(report.bandwidth, span);
+            springCache.Access(sp.i);
+            springCache.Access(sp.j);
+        }
+        numSprings += group->size();
+    }
+    if (numSprings > 0)
+    {
+        report.averageSpan = spanSum / numSprings;
+        report.springMisses = (double)springCache.misses / numSprings;
+    }
+
+    CacheModel triangleCache;
+    for (const glm::ivec3& t : tris)
+    {
+        triangleCache.Access(t.x);
+        triangleCache.Access(t.y);
+        triangleCache.Access(t.z);
+    }
+    if (!tris.empty()) report.triangleMisses = (double)triangleCache.misses / tris.size();
+    return report;
+}
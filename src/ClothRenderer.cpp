@@ -0,0 +1,102 @@
+#include "ClothRenderer.h"
+
+#include "Profiler.h"
+
+// Constructor: Creates the vertex buffers for the cloth and the ground plane below it.
+ClothRenderer::ClothRenderer(const Cloth* _cloth, GLuint ID)
+{
+    cloth = _cloth; // Cloth whose state is drawn.
+    programID = ID; // OpenGL shader program ID for rendering.
+
+    const std::vector<glm::vec3>& positions = cloth->GetPositions();
+    const std::vector<glm::vec3>& normals = cloth->GetNormals();
+    const std::vector<glm::ivec3>& indices = cloth->GetIndices();
+
+    // Create a ground object to show where the cloth collides.
+    ground = new Ground(glm::vec3(-5.0f, cloth->GetGroundPos(), -5.0f), 10.0f, programID);
+
+    // OpenGL setup for rendering the cloth.
+    glGenVertexArrays(1, &vao); // Generate a VAO for the cloth.
+    glGenBuffers(2, vbos); // Generate VBOs for positions and normals.
+    glGenBuffers(1, &ebo); // Generate an EBO for indices.
+
+    // Bind and configure the VAO and VBOs for position and normal data.
+    // This includes uploading the initial positions and normals to the GPU.
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), positions.data(), GL_STREAM_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[1]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normals.size(), normals.data(), GL_STREAM_DRAW);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+
+    // Bind and upload indices for the triangles to the EBO.
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(glm::ivec3) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+    // Unbind from the VAO to prevent accidental modifications.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+// Destructor: Cleans up the ground and the OpenGL resources.
+ClothRenderer::~ClothRenderer()
+{
+    delete ground;
+
+    // Delete OpenGL buffers and VAO.
+    glDeleteBuffers(2, vbos);
+    glDeleteBuffers(1, &ebo);
+    glDeleteVertexArrays(1, &vao);
+}
+
+// Update: Transfers the cloth's current positions and normals to their respective VBOs.
+void ClothRenderer::Update()
+{
+    ScopedTimer timer(PROFILE_UPLOAD);
+
+    const std::vector<glm::vec3>& positions = cloth->GetPositions();
+    const std::vector<glm::vec3>& normals = cloth->GetNormals();
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[0]);
+    void* ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+    memcpy(ptr, positions.data(), sizeof(glm::vec3) * positions.size());
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[1]);
+    ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+    memcpy(ptr, normals.data(), sizeof(glm::vec3) * normals.size());
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ClothRenderer::Draw(const glm::mat4& viewProjMtx)
+{
+    // Use the specified shader program for drawing.
+    glUseProgram(programID);
+
+    glm::mat4 model(1.0); // Model matrix for the cloth.
+    glm::vec3 color(0.9f, 0.01f, 0.01f); // Color of the cloth.
+
+    // Pass view projection matrix, model matrix, and color to the shader.
+    glUniformMatrix4fv(glGetUniformLocation(programID, "viewProj"), 1, GL_FALSE, (float*)&viewProjMtx);
+    glUniformMatrix4fv(glGetUniformLocation(programID, "model"), 1, GL_FALSE, (float*)&model);
+    glUniform3fv(glGetUniformLocation(programID, "DiffuseColor"), 1, &color[0]);
+
+    // Bind the VAO for the cloth.
+    glBindVertexArray(vao);
+
+    // Draw the cloth using triangles, as specified by the indices in the EBO.
+    glDrawElements(GL_TRIANGLES, cloth->GetIndices().size() * 3, GL_UNSIGNED_INT, 0);
+
+    // Unbind the VAO and the shader program.
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    // Draw the ground for context, following the cloth's collision height.
+    ground->SetGroundLevel(cloth->GetGroundPos());
+    ground->Draw(viewProjMtx);
+}
@@ -0,0 +1,204 @@
+#include "ClothWorld.h"
+
+#include <atomic>
+#include <chrono>
+
+// Constructor: An empty world that uses every hardware thread.
+ClothWorld::ClothWorld()
+{
+    numThreads = ThreadPool::Shared().GetNumThreads();
+}
+
+// AddCloth: Creates a cloth, gives it the world's coefficients and takes ownership of it.
+Cloth* ClothWorld::AddCloth(float size, float mass, int N, glm::vec3 pos, glm::vec3 hori, glm::vec3 vert, bool implicitTopology)
+{
+    cloths.push_back(std::make_unique<Cloth>(size, mass, N, pos, hori, vert, implicitTopology));
+    ApplyShared(*cloths.back());
+    return cloths.back().get();
+}
+
+// AddCloth: Same for a cloth made from a triangle mesh.
+Cloth* ClothWorld::AddCloth(const std::vector<glm::vec3>& meshPositions, const std::vector<glm::ivec3>& meshTriangles, float mass, const std::vector<int>& fixedParticles,
+    MeshOrdering ordering)
+{
+    cloths.push_back(std::make_unique<Cloth>(meshPositions, meshTriangles, mass, fixedParticles, ordering));
+    ApplyShared(*cloths.back());
+    return cloths.back().get();
+}
+
+// RemoveCloth: Deletes a cloth of this world.
+void ClothWorld::RemoveCloth(Cloth* cloth)
+{
+    cloths.erase(std::remove_if(cloths.begin(), cloths.end(), [&](const std::unique_ptr<Cloth>& c) { return c.get() == cloth; }), cloths.end());
+}
+
+// GetNumParticles: Particles of all cloths together.
+int ClothWorld::GetNumParticles() const
+{
+    int n = 0;
+    for (const auto& cloth : cloths) n += cloth->GetNumParticles();
+    return n;
+}
+
+// ApplyShared: Copies the world's coefficients into a cloth.
+void ClothWorld::ApplyShared(Cloth& cloth) const
+{
+    cloth.SetWindVelocity(windVelocity);
+    cloth.SetFluidDensity(fluidDensity);
+    cloth.SetDragConst(dragConst);
+    cloth.SetGravityAcce(gravityAcce);
+    cloth.SetGroundPos(groundPos);
+    cloth.SetSolverMode(solverMode);
+    for (const MeshCollider* collider : meshColliders) cloth.AddCollider(collider);
+    for (const BoxCollider* collider : boxColliders) cloth.AddCollider(collider);
+    for (const DistanceCollider* collider : distanceColliders) cloth.AddCollider(collider);
+}
+
+// EstimateCost: Work of a cloth's next update, its particles and elements times the substeps of its last step.
+double ClothWorld::EstimateCost(Cloth& cloth) const
+{
+    return ((double)cloth.GetNumParticles() + cloth.GetNumElements()) * std::max(1, cloth.GetLastSubsteps());
+}
+
+// Update: Steps the expensive cloths one after another with every thread, then the others concurrently,
+// each claimed by the next free thread in order of decreasing cost.
+void ClothWorld::Update(const SimulationClock& clock)
+{
+    auto start = std::chrono::steady_clock::now();
+    int n = (int)cloths.size();
+
+    std::vector<double> costs(n);
+    double totalCost = 0.0;
+    std::vector<long long> substepsBefore(n);
+    for (int c = 0; c < n; c++)
+    {
+        costs[c] = EstimateCost(*cloths[c]);
+        totalCost += costs[c];
+        substepsBefore[c] = cloths[c]->GetTotalSubsteps();
+    }
+    order.resize(n);
+    for (int c = 0; c < n; c++) order[c] = c;
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return costs[a] > costs[b]; });
+
+    // A cloth worth a thread's share or more would leave the other threads idle, it gets them all instead.
+    int first = 0;
+    double share = totalCost / numThreads;
+    while (first < n && numThreads > 1 && costs[order[first]] >= share)
+    {
+        Cloth& cloth = *cloths[order[first++]];
+        cloth.SetNumThreads(numThreads);
+        cloth.Update(clock);
+    }
+
+    // The remaining cloths run serially, each task keeps claiming the next cloth. Their thread count is set
+    // explicitly, since a task running on the calling thread would otherwise use the cloth's own count.
+    // A cloth left on its own has nothing beside it and keeps the world's threads.
+    lastConcurrent = n - first;
+    int clothThreads = lastConcurrent == 1 ? numThreads : 1;
+    std::atomic<int> next(first);
+    ThreadPool::Shared().ParallelFor(std::min(numThreads, lastConcurrent), numThreads, [&](int, int)
+        {
+            for (int k = next++; k < n; k = next++)
+            {
+                Cloth& cloth = *cloths[order[k]];
+                cloth.SetNumThreads(clothThreads);
+                cloth.Update(clock);
+            }
+        });
+
+    lastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    lastParticleSubsteps = 0.0;
+    for (int c = 0; c < n; c++)
+    {
+        lastParticleSubsteps += (double)cloths[c]->GetNumParticles() * (cloths[c]->GetTotalSubsteps() - substepsBefore[c]);
+    }
+    totalSeconds += lastSeconds;
+    totalParticleSubsteps += lastParticleSubsteps;
+}
+
+// SetWindVelocity: Sets the wind of every cloth.
+void ClothWorld::SetWindVelocity(glm::vec3 v)
+{
+    windVelocity = v;
+    for (auto& cloth : cloths) cloth->SetWindVelocity(v);
+}
+
+// SetFluidDensity: Sets the air density of every cloth.
+void ClothWorld::SetFluidDensity(float rho)
+{
+    fluidDensity = rho;
+    for (auto& cloth : cloths) cloth->SetFluidDensity(rho);
+}
+
+// SetDragConst: Sets the drag coefficient of every cloth.
+void ClothWorld::SetDragConst(float C)
+{
+    dragConst = C;
+    for (auto& cloth : cloths) cloth->SetDragConst(C);
+}
+
+// SetGravityAcce: Sets the gravity of every cloth.
+void ClothWorld::SetGravityAcce(float g)
+{
+    gravityAcce = g;
+    for (auto& cloth : cloths) cloth->SetGravityAcce(g);
+}
+
+// SetGroundPos: Sets the ground height of every cloth.
+void ClothWorld::SetGroundPos(float h)
+{
+    groundPos = h;
+    for (auto& cloth : cloths) cloth->SetGroundPos(h);
+}
+
+// SetSolverMode: Switches every cloth to a solver, cloths without explicit topology stay on the grid solver.
+void ClothWorld::SetSolverMode(SolverMode mode)
+{
+    solverMode = mode;
+    for (auto& cloth : cloths) cloth->SetSolverMode(mode);
+}
+
+// AddCollider: Lets every cloth collide with a mesh.
+void ClothWorld::AddCollider(const MeshCollider* collider)
+{
+    if (HasCollider(collider)) return;
+    meshColliders.push_back(collider);
+    for (auto& cloth : cloths) cloth->AddCollider(collider);
+}
+
+// RemoveCollider: Stops every cloth from colliding with a mesh.
+void ClothWorld::RemoveCollider(const MeshCollider* collider)
+{
+    meshColliders.erase(std::remove(meshColliders.begin(), meshColliders.end(), collider), meshColliders.end());
+    for (auto& cloth : cloths) cloth->RemoveCollider(collider);
+}
+
+// AddCollider: Lets every cloth collide with a skeleton's boxes.
+void ClothWorld::AddCollider(const BoxCollider* collider)
+{
+    if (HasCollider(collider)) return;
+    boxColliders.push_back(collider);
+    for (auto& cloth : cloths) cloth->AddCollider(collider);
+}
+
+// RemoveCollider: Stops every cloth from colliding with a skeleton's boxes.
+void ClothWorld::RemoveCollider(const BoxCollider* collider)
+{
+    boxColliders.erase(std::remove(boxColliders.begin(), boxColliders.end(), collider), boxColliders.end());
+    for (auto& cloth : cloths) cloth->RemoveCollider(collider);
+}
+
+// AddCollider: Lets every cloth collide with a distance field.
+void ClothWorld::AddCollider(const DistanceCollider* collider)
+{
+    if (HasCollider(collider)) return;
+    distanceColliders.push_back(collider);
+    for (auto& cloth : cloths) cloth->AddCollider(collider);
+}
+
+// RemoveCollider: Stops every cloth from colliding with a distance field.
+void ClothWorld::RemoveCollider(const DistanceCollider* collider)
+{
+    distanceColliders.erase(std::remove(distanceColliders.begin(), distanceColliders.end(), collider), distanceColliders.end());
+    for (auto& cloth : cloths) cloth->RemoveCollider(collider);
+}
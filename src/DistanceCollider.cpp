@@ -0,0 +1,50 @@
+#include "DistanceCollider.h"
+
+#include "Particle.h"
+
+// Width of the band around the surface in cells.
+#define DISTANCE_BAND_CELLS 4
+
+// Constructor: Loads the field from the cache if it was built from the same mesh and cell size, otherwise builds
+// it and writes the cache.
+DistanceCollider::DistanceCollider(const std::vector<glm::vec3>& positions, const std::vector<glm::ivec3>& triangles, float cellSize,
+    const std::string& cacheFile, int numThreads)
+{
+    float band = DISTANCE_BAND_CELLS * cellSize;
+    if (!cacheFile.empty() && field.Load(cacheFile, DistanceField::Key(positions, triangles, cellSize, band)))
+    {
+        fromCache = true;
+    }
+    else
+    {
+        field.Build(positions, triangles, cellSize, band, numThreads);
+        if (!cacheFile.empty() && !field.Save(cacheFile)) std::cerr << "Could not write " << cacheFile << std::endl;
+    }
+    SetThickness(thickness);
+}
+
+// Collide: One lookup of the distance and its gradient. Within the thickness the particle moves along the
+// gradient to the thickness, scaled by the gradient's length, which is not quite one in the interpolated field.
+// Its velocity is corrected as against a surface at rest.
+bool DistanceCollider::Collide(glm::vec3& x, glm::vec3& v, float deltaT) const
+{
+    glm::vec3 gradient;
+    float d = field.Sample(x, gradient);
+    if (d >= thickness) return false;
+
+    float length = glm::length(gradient);
+    if (length <= EPSILON) return false;
+    glm::vec3 normal = gradient / length;
+    float depth = (thickness - d) / length;
+
+    x += depth * normal;
+    ContactVelocity(v, glm::vec3(0.0f), normal, depth, friction, deltaT);
+    return true;
+}
+
+// Touches: Whether the particle is within the thickness.
+bool DistanceCollider::Touches(const glm::vec3& x) const
+{
+    glm::vec3 gradient;
+    return field.Sample(x, gradient) < thickness && glm::length(gradient) > EPSILON;
+}
@@ -0,0 +1,319 @@
+#include "DistanceField.h"
+
+#include "MeshBVH.h"
+#include "Particle.h"
+#include "ThreadPool.h"
+
+#include <cstdio>
+#include <unordered_map>
+
+// Minimum number of blocks per task when the field is built across threads.
+#define DISTANCE_GRAIN 4
+
+// Marks saved fields, bumped whenever the file layout or the way the field is built changes.
+#define DISTANCE_MAGIC 0x32464453u // "SDF2"
+
+// Build: Stores every block that overlaps the bounds of a triangle grown by the band, then samples the distance
+// at the nodes of the stored blocks. The closest point query has no distance limit, so nodes outside the band
+// still get their sign. The closest point lies on a face, an edge or a vertex, read from its barycentric
+// weights, and the sign is that of the offset along the feature's pseudo-normal: the face normal, the sum of the
+// normals of the faces on an edge, or the angle-weighted sum of the normals of the faces around a vertex.
+// Loaders split vertices at texture and normal seams, so coincident vertices are welded first, otherwise an edge
+// or vertex on a seam would only see the faces on one side. Blocks that are not stored get the sign, distance
+// and direction to the surface at their center.
+void DistanceField::Build(const std::vector<glm::vec3>& positions, const std::vector<glm::ivec3>& triangles, float _cellSize, float _band, int numThreads)
+{
+    cellSize = _cellSize;
+    band = _band;
+    key = Key(positions, triangles, cellSize, band);
+    blockIndex.clear();
+    blockData.clear();
+    interior.clear();
+    if (positions.empty() || triangles.empty() || cellSize <= 0.0f) return;
+
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (const glm::vec3& p : positions)
+    {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    glm::vec3 pad(band + cellSize);
+    origin = lo - pad;
+    glm::ivec3 cells = glm::ivec3(glm::ceil((hi - lo + 2.0f * pad) / cellSize));
+    blockDims = glm::max((cells + DISTANCE_BLOCK - 1) / DISTANCE_BLOCK, glm::ivec3(1));
+    blockIndex.assign((size_t)blockDims.x * blockDims.y * blockDims.z, (int)DISTANCE_OUTSIDE);
+
+    // Blocks within the band of a triangle, numbered in grid order.
+    float blockSize = cellSize * DISTANCE_BLOCK;
+    for (const glm::ivec3& t : triangles)
+    {
+        glm::vec3 tlo = glm::min(glm::min(positions[t.x], positions[t.y]), positions[t.z]) - glm::vec3(band);
+        glm::vec3 thi = glm::max(glm::max(positions[t.x], positions[t.y]), positions[t.z]) + glm::vec3(band);
+        glm::ivec3 b0 = glm::clamp(glm::ivec3(glm::floor((tlo - origin) / blockSize)), glm::ivec3(0), blockDims - 1);
+        glm::ivec3 b1 = glm::clamp(glm::ivec3(glm::floor((thi - origin) / blockSize)), glm::ivec3(0), blockDims - 1);
+        for (int z = b0.z; z <= b1.z; z++)
+            for (int y = b0.y; y <= b1.y; y++)
+                for (int x = b0.x; x <= b1.x; x++) blockIndex[((size_t)z * blockDims.y + y) * blockDims.x + x] = 0;
+    }
+    std::vector<glm::ivec3> blockCoords, farCoords;
+    std::vector<int*> farSlots;
+    for (int z = 0; z < blockDims.z; z++)
+        for (int y = 0; y < blockDims.y; y++)
+            for (int x = 0; x < blockDims.x; x++)
+            {
+                int& slot = blockIndex[((size_t)z * blockDims.y + y) * blockDims.x + x];
+                if (slot < 0)
+                {
+                    farCoords.push_back(glm::ivec3(x, y, z));
+                    farSlots.push_back(&slot);
+                    continue;
+                }
+                slot = (int)blockCoords.size();
+                blockCoords.push_back(glm::ivec3(x, y, z));
+            }
+
+    // Welded vertex of every vertex, the first one with the same position quantized to a millionth of the bounds.
+    std::vector<int> weld(positions.size());
+    std::unordered_map<uint64_t, int> byPosition;
+    float quantum = 1e-6f * std::max(glm::length(hi - lo), (float)EPSILON);
+    for (int i = 0; i < (int)positions.size(); i++)
+    {
+        glm::ivec3 q = glm::ivec3(glm::round((positions[i] - lo) / quantum));
+        uint64_t cell = ((uint64_t)(q.x & 0x1fffff) << 42) | ((uint64_t)(q.y & 0x1fffff) << 21) | (uint64_t)(q.z & 0x1fffff);
+        weld[i] = byPosition.emplace(cell, i).first->second;
+    }
+
+    // Pseudo-normals of the faces, of the edges of every face (edge k runs from corner k to corner k + 1) and of
+    // the welded vertices.
+    std::vector<glm::vec3> faceNormals(triangles.size()), edgeNormals(3 * triangles.size()), vertexNormals(positions.size(), glm::vec3(0.0f));
+    std::unordered_map<uint64_t, glm::vec3> edgeSums;
+    auto edgeKey = [&weld](int a, int b) { a = weld[a]; b = weld[b]; return ((uint64_t)std::min(a, b) << 32) | (uint32_t)std::max(a, b); };
+    for (int t = 0; t < (int)triangles.size(); t++)
+    {
+        const glm::ivec3& tri = triangles[t];
+        glm::vec3 n = glm::cross(positions[tri.y] - positions[tri.x], positions[tri.z] - positions[tri.x]);
+        float length = glm::length(n);
+        faceNormals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec3 e1 = positions[tri[(k + 1) % 3]] - positions[tri[k]];
+            glm::vec3 e2 = positions[tri[(k + 2) % 3]] - positions[tri[k]];
+            float l1 = glm::length(e1), l2 = glm::length(e2);
+            if (l1 > 0.0f && l2 > 0.0f) vertexNormals[weld[tri[k]]] += acosf(glm::clamp(glm::dot(e1, e2) / (l1 * l2), -1.0f, 1.0f)) * faceNormals[t];
+            edgeSums[edgeKey(tri[k], tri[(k + 1) % 3])] += faceNormals[t];
+        }
+    }
+    for (int t = 0; t < (int)triangles.size(); t++)
+    {
+        for (int k = 0; k < 3; k++) edgeNormals[3 * t + k] = edgeSums[edgeKey(triangles[t][k], triangles[t][(k + 1) % 3])];
+    }
+
+    MeshBVH bvh;
+    bvh.Build(positions, triangles);
+    float unlimited = glm::length(glm::vec3(blockDims) * blockSize) + glm::length(hi - lo);
+
+    // Signed distance at p and the closest point on the surface.
+    auto signedDistance = [&](const glm::vec3& p, glm::vec3& q)
+        {
+            int t;
+            glm::vec3 bary;
+            float distance2;
+            q = p;
+            if (!bvh.FindClosest(p, unlimited, positions, t, bary, distance2)) return band;
+            const glm::ivec3& tri = triangles[t];
+            q = bary.x * positions[tri.x] + bary.y * positions[tri.y] + bary.z * positions[tri.z];
+            int zeros = (bary.x == 0.0f) + (bary.y == 0.0f) + (bary.z == 0.0f);
+            glm::vec3 n = faceNormals[t];
+            if (zeros == 2) n = vertexNormals[weld[tri[bary.x != 0.0f ? 0 : bary.y != 0.0f ? 1 : 2]]];
+            else if (zeros == 1) n = edgeNormals[3 * t + ((bary.x == 0.0f ? 0 : bary.y == 0.0f ? 1 : 2) + 1) % 3];
+            float d = sqrtf(distance2);
+            return glm::dot(p - q, n) < 0.0f ? -d : d;
+        };
+
+    const int nodesPerBlock = BLOCK_NODES * BLOCK_NODES * BLOCK_NODES;
+    blockData.resize(blockCoords.size() * nodesPerBlock);
+    int numBlocks = (int)blockCoords.size();
+    ThreadPool::Shared().ParallelFor(numBlocks, std::min(numThreads, numBlocks / DISTANCE_GRAIN), [&](int begin, int end)
+        {
+            for (int b = begin; b < end; b++)
+            {
+                glm::vec3 corner = origin + glm::vec3(blockCoords[b]) * blockSize;
+                float* data = &blockData[(size_t)b * nodesPerBlock];
+                for (int z = 0; z < BLOCK_NODES; z++)
+                    for (int y = 0; y < BLOCK_NODES; y++)
+                        for (int x = 0; x < BLOCK_NODES; x++)
+                        {
+                            glm::vec3 q;
+                            float d = signedDistance(corner + glm::vec3(x, y, z) * cellSize, q);
+                            data[(z * BLOCK_NODES + y) * BLOCK_NODES + x] = glm::clamp(d, -band, band);
+                        }
+            }
+        });
+
+    // Blocks away from the surface only need their side, the ones inside also where the surface is.
+    int numFar = (int)farCoords.size();
+    std::vector<glm::vec4> farCenters(numFar);
+    ThreadPool::Shared().ParallelFor(numFar, std::min(numThreads, numFar / (DISTANCE_GRAIN * nodesPerBlock)), [&](int begin, int end)
+        {
+            for (int b = begin; b < end; b++)
+            {
+                glm::vec3 center = origin + (glm::vec3(farCoords[b]) + 0.5f) * blockSize, q;
+                float d = signedDistance(center, q);
+                glm::vec3 toSurface = q - center;
+                float length = glm::length(toSurface);
+                farCenters[b] = glm::vec4(length > 0.0f && d < 0.0f ? toSurface / length : glm::vec3(0.0f), d);
+            }
+        });
+    for (int b = 0; b < numFar; b++)
+    {
+        if (farCenters[b].w >= 0.0f) continue;
+        *farSlots[b] = DISTANCE_OUTSIDE - 1 - (int)interior.size();
+        interior.push_back(farCenters[b]);
+    }
+}
+
+// Save: Header, block table, block data and interior blocks, in the machine's byte order.
+bool DistanceField::Save(const std::string& fileName) const
+{
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (!file) return false;
+
+    uint32_t magic = DISTANCE_MAGIC;
+    uint64_t indexCount = blockIndex.size(), dataCount = blockData.size(), interiorCount = interior.size();
+    bool ok = fwrite(&magic, sizeof(magic), 1, file) == 1
+        && fwrite(&key, sizeof(key), 1, file) == 1
+        && fwrite(&origin, sizeof(origin), 1, file) == 1
+        && fwrite(&cellSize, sizeof(cellSize), 1, file) == 1
+        && fwrite(&band, sizeof(band), 1, file) == 1
+        && fwrite(&blockDims, sizeof(blockDims), 1, file) == 1
+        && fwrite(&indexCount, sizeof(indexCount), 1, file) == 1
+        && fwrite(&dataCount, sizeof(dataCount), 1, file) == 1
+        && fwrite(&interiorCount, sizeof(interiorCount), 1, file) == 1
+        && fwrite(blockIndex.data(), sizeof(int), indexCount, file) == indexCount
+        && fwrite(blockData.data(), sizeof(float), dataCount, file) == dataCount
+        && fwrite(interior.data(), sizeof(glm::vec4), interiorCount, file) == interiorCount;
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
+
+// Load: Reads into temporaries and only takes them once the header matches and the block table is consistent.
+bool DistanceField::Load(const std::string& fileName, uint64_t expectedKey)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) return false;
+
+    uint32_t magic = 0;
+    uint64_t fileKey = 0, indexCount = 0, dataCount = 0, interiorCount = 0;
+    glm::vec3 fileOrigin;
+    float fileCellSize, fileBand;
+    glm::ivec3 fileDims;
+    bool ok = fread(&magic, sizeof(magic), 1, file) == 1 && magic == DISTANCE_MAGIC
+        && fread(&fileKey, sizeof(fileKey), 1, file) == 1 && fileKey == expectedKey
+        && fread(&fileOrigin, sizeof(fileOrigin), 1, file) == 1
+        && fread(&fileCellSize, sizeof(fileCellSize), 1, file) == 1
+        && fread(&fileBand, sizeof(fileBand), 1, file) == 1
+        && fread(&fileDims, sizeof(fileDims), 1, file) == 1
+        && fread(&indexCount, sizeof(indexCount), 1, file) == 1
+        && fread(&dataCount, sizeof(dataCount), 1, file) == 1
+        && fread(&interiorCount, sizeof(interiorCount), 1, file) == 1
+        && fileDims.x > 0 && fileDims.y > 0 && fileDims.z > 0
+        && indexCount == (uint64_t)fileDims.x * fileDims.y * fileDims.z
+        && dataCount % (BLOCK_NODES * BLOCK_NODES * BLOCK_NODES) == 0
+        && interiorCount <= indexCount;
+
+    std::vector<int> fileIndex;
+    std::vector<float> fileData;
+    std::vector<glm::vec4> fileInterior;
+    if (ok)
+    {
+        fileIndex.resize(indexCount);
+        fileData.resize(dataCount);
+        fileInterior.resize(interiorCount);
+        ok = fread(fileIndex.data(), sizeof(int), indexCount, file) == indexCount
+            && fread(fileData.data(), sizeof(float), dataCount, file) == dataCount
+            && fread(fileInterior.data(), sizeof(glm::vec4), interiorCount, file) == interiorCount;
+    }
+    fclose(file);
+    if (!ok) return false;
+
+    int numBlocks = (int)(dataCount / (BLOCK_NODES * BLOCK_NODES * BLOCK_NODES));
+    for (int slot : fileIndex)
+    {
+        if (slot < DISTANCE_OUTSIDE - (int)interiorCount || slot >= numBlocks) return false;
+    }
+
+    key = fileKey;
+    origin = fileOrigin;
+    cellSize = fileCellSize;
+    band = fileBand;
+    blockDims = fileDims;
+    blockIndex.swap(fileIndex);
+    blockData.swap(fileData);
+    interior.swap(fileInterior);
+    return true;
+}
+
+// Key: FNV-1a hash of the vertices, the triangles and the parameters.
+uint64_t DistanceField::Key(const std::vector<glm::vec3>& positions, const std::vector<glm::ivec3>& triangles, float cellSize, float band)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* bytes, size_t size)
+        {
+            const unsigned char* p = (const unsigned char*)bytes;
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= p[i];
+                hash *= 1099511628211ull;
+            }
+        };
+    uint32_t magic = DISTANCE_MAGIC;
+    mix(&magic, sizeof(magic));
+    mix(&cellSize, sizeof(cellSize));
+    mix(&band, sizeof(band));
+    mix(positions.data(), positions.size() * sizeof(glm::vec3));
+    mix(triangles.data(), triangles.size() * sizeof(glm::ivec3));
+    return hash;
+}
+
+// Sample: Trilinear interpolation in the cell around p and the derivative of the interpolant, all eight corners
+// come from one block. Outside the stored blocks p is a band away with no gradient, or, in a block inside the
+// mesh, the distance is extended linearly from the block's center and capped at minus the band, so a particle
+// that got deep inside is led back to the surface a band at a time.
+float DistanceField::Sample(const glm::vec3& p, glm::vec3& gradient) const
+{
+    gradient = glm::vec3(0.0f);
+    glm::vec3 g = (p - origin) / cellSize;
+    glm::vec3 limit = glm::vec3(blockDims * DISTANCE_BLOCK);
+    if (!(g.x >= 0.0f && g.y >= 0.0f && g.z >= 0.0f && g.x < limit.x && g.y < limit.y && g.z < limit.z)) return band;
+
+    glm::ivec3 cell = glm::ivec3(g);
+    glm::ivec3 block = cell / DISTANCE_BLOCK;
+    int slot = blockIndex[((size_t)block.z * blockDims.y + block.y) * blockDims.x + block.x];
+    if (slot == DISTANCE_OUTSIDE) return band;
+    if (slot < 0)
+    {
+        const glm::vec4& inside = interior[DISTANCE_OUTSIDE - 1 - slot];
+        gradient = glm::vec3(inside);
+        glm::vec3 center = origin + (glm::vec3(block) + 0.5f) * (cellSize * DISTANCE_BLOCK);
+        return std::min(inside.w + glm::dot(gradient, p - center), -band);
+    }
+
+    glm::ivec3 local = cell - block * DISTANCE_BLOCK;
+    glm::vec3 f = g - glm::vec3(cell);
+    const float* c = &blockData[(size_t)slot * BLOCK_NODES * BLOCK_NODES * BLOCK_NODES + (local.z * BLOCK_NODES + local.y) * BLOCK_NODES + local.x];
+    const int dy = BLOCK_NODES, dz = BLOCK_NODES * BLOCK_NODES;
+    float c000 = c[0], c100 = c[1], c010 = c[dy], c110 = c[dy + 1];
+    float c001 = c[dz], c101 = c[dz + 1], c011 = c[dz + dy], c111 = c[dz + dy + 1];
+
+    // Interpolate along x, then y, then z, keeping the differences for the gradient.
+    float c00 = c000 + f.x * (c100 - c000), c10 = c010 + f.x * (c110 - c010);
+    float c01 = c001 + f.x * (c101 - c001), c11 = c011 + f.x * (c111 - c011);
+    float c0 = c00 + f.y * (c10 - c00), c1 = c01 + f.y * (c11 - c01);
+
+    float dx0 = (1.0f - f.y) * (c100 - c000) + f.y * (c110 - c010);
+    float dx1 = (1.0f - f.y) * (c101 - c001) + f.y * (c111 - c011);
+    gradient.x = ((1.0f - f.z) * dx0 + f.z * dx1) / cellSize;
+    gradient.y = ((1.0f - f.z) * (c10 - c00) + f.z * (c11 - c01)) / cellSize;
+    gradient.z = (c1 - c0) / cellSize;
+    return c0 + f.z * (c1 - c0);
+}
@@ -0,0 +1,507 @@
+#include "GridSolver.h"
+
+#include "SpringDamper.h"
+#include "ThreadPool.h"
+
+// Minimum number of rows per band when a sweep is split across threads.
+#define GRID_MIN_BAND_ROWS 16
+
+#if defined(_MSC_VER)
+#define GRID_INLINE __forceinline
+#else
+#define GRID_INLINE inline __attribute__((always_inline))
+#endif
+
+// The row kernels are plain loops over contiguous rows. They are compiled once for the baseline instruction set
+// and once for AVX2, where the compiler vectorizes them 8-wide; the AVX2 copy runs when the spring kernel is AVX2.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GRID_SIMD_X86 1
+#if defined(_MSC_VER)
+#define GRID_TARGET_AVX2
+#else
+#define GRID_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// The rows of a kernel never overlap, but GCC loses restrict when the kernels are inlined and then gives up
+// on the alias checks, so the x loops say so explicitly.
+#if defined(__clang__)
+#define GRID_IVDEP _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+#define GRID_IVDEP _Pragma("GCC ivdep")
+#elif defined(_MSC_VER)
+#define GRID_IVDEP __pragma(loop(ivdep))
+#else
+#define GRID_IVDEP
+#endif
+
+// Scratch arrays of a band, each one row long plus one padding element.
+// Element forces of cell x are stored at x + 1 so the neighbours at x - 1 of the first column read a zero.
+enum GridScratch
+{
+    SCRATCH_H = 0, // Horizontal structural springs of the upper row.
+    SCRATCH_V = 3, // Vertical structural springs.
+    SCRATCH_D1 = 6, // Shear springs from top-left to bottom-right.
+    SCRATCH_D2 = 9, // Shear springs from bottom-left to top-right.
+    SCRATCH_T1 = 12, // Triangles (topLeft, bottomLeft, bottomRight), force per corner.
+    SCRATCH_T2 = 15, // Triangles (topLeft, bottomRight, topRight), force per corner.
+    SCRATCH_ELEMENTS = 18, // Followed by two rolling force rows for every substep in flight.
+    SCRATCH_FORCE_ARRAYS = 6
+};
+
+// SpringForce: Force of one spring on its first particle, the same formula as the spring list kernels.
+static GRID_INLINE void SpringForce(float pix, float piy, float piz, float pjx, float pjy, float pjz,
+    float vix, float viy, float viz, float vjx, float vjy, float vjz,
+    float rest, float k, float c, float& fx, float& fy, float& fz)
+{
+    float dx = pjx - pix;
+    float dy = pjy - piy;
+    float dz = pjz - piz;
+    float len = sqrtf(dx * dx + dy * dy + dz * dz);
+
+    // Degenerate springs contribute nothing. The division always runs and the result is selected afterwards,
+    // so the loops have no control flow and vectorize.
+    bool valid = len > (float)EPSILON;
+    float invLen = 1.0f / std::max(len, (float)EPSILON);
+    invLen = valid ? invLen : 0.0f;
+    len = valid ? len : 0.0f;
+    dx *= invLen;
+    dy *= invLen;
+    dz *= invLen;
+
+    // Hooke's law and damping along the spring.
+    float f = -k * (rest - len);
+    f -= c * ((vix - vjx) * dx + (viy - vjy) * dy + (viz - vjz) * dz);
+    fx = f * dx;
+    fy = f * dy;
+    fz = f * dz;
+}
+
+// TriangleForce: Drag on one corner of a triangle, the same formula as Triangle::ComputeAerodynamicForce.
+// -0.5 * rho * |v|^2 * C_d * A * dot(v / |v|, n / |n|) * n / |n| / 3 with A = |n| / 2 simplifies to
+// -rho * C_d / 12 * |v| * dot(v, n) * n / |n|, where dragScale = -rho * C_d / 12.
+static GRID_INLINE void TriangleForce(float p1x, float p1y, float p1z, float p2x, float p2y, float p2z, float p3x, float p3y, float p3z,
+    float v1x, float v1y, float v1z, float v2x, float v2y, float v2z, float v3x, float v3y, float v3z,
+    float dragScale, float wx, float wy, float wz, float& fx, float& fy, float& fz)
+{
+    float ax = p2x - p1x, ay = p2y - p1y, az = p2z - p1z;
+    float bx = p3x - p1x, by = p3y - p1y, bz = p3z - p1z;
+    float nx = ay * bz - az * by;
+    float ny = az * bx - ax * bz;
+    float nz = ax * by - ay * bx;
+    float area = sqrtf(nx * nx + ny * ny + nz * nz);
+
+    // Relative velocity of the surface against the wind.
+    float vx = (v1x + v2x + v3x) / 3.0f - wx;
+    float vy = (v1y + v2y + v3y) / 3.0f - wy;
+    float vz = (v1z + v2z + v3z) / 3.0f - wz;
+    float vScale = sqrtf(vx * vx + vy * vy + vz * vz);
+
+    bool valid = (vScale >= (float)EPSILON) & (area >= (float)EPSILON);
+    float s = dragScale * vScale * (vx * nx + vy * ny + vz * nz) / std::max(area, (float)EPSILON);
+    s = valid ? s : 0.0f;
+    fx = s * nx;
+    fy = s * ny;
+    fz = s * nz;
+}
+
+// GRID_ROW: Loads the pointers of one row as restrict-qualified locals, so the loops vectorize without alias checks.
+#define GRID_ROW(name, row) \
+    const float* __restrict name##px = row.px; const float* __restrict name##py = row.py; const float* __restrict name##pz = row.pz; \
+    const float* __restrict name##vx = row.vx; const float* __restrict name##vy = row.vy; const float* __restrict name##vz = row.vz;
+
+// CellRowForces: Forces of the vertical and shear springs and the triangles between rows a and b.
+static GRID_INLINE void CellRowForces(const GridRow& a, const GridRow& b, int width, const GridParams& p, float* scratch)
+{
+    const int stride = width + 1;
+    GRID_ROW(a, a)
+    GRID_ROW(b, b)
+    float* __restrict V = scratch + SCRATCH_V * stride;
+    float* __restrict D1 = scratch + SCRATCH_D1 * stride;
+    float* __restrict D2 = scratch + SCRATCH_D2 * stride;
+    float* __restrict T1 = scratch + SCRATCH_T1 * stride;
+    float* __restrict T2 = scratch + SCRATCH_T2 * stride;
+
+    // Constants are copied to locals, the compiler cannot tell that the stores above leave them unchanged.
+    const float k = p.springConst, c = p.dampingConst;
+    const float rest = p.restLength, restDiag = p.restLengthDiag;
+    const float dragScale = -p.fluidDensity * p.dragConst / 12.0f;
+    const float wx = p.windVelocity.x, wy = p.windVelocity.y, wz = p.windVelocity.z;
+
+    // Vertical springs exist in every column and are stored unshifted.
+    GRID_IVDEP
+    for (int x = 0; x < width; x++)
+    {
+        SpringForce(apx[x], apy[x], apz[x], bpx[x], bpy[x], bpz[x], avx[x], avy[x], avz[x], bvx[x], bvy[x], bvz[x],
+            rest, k, c, V[x], V[x + stride], V[x + 2 * stride]);
+    }
+
+    GRID_IVDEP
+
+    for (int x = 0; x < width - 1; x++)
+    {
+        SpringForce(apx[x], apy[x], apz[x], bpx[x + 1], bpy[x + 1], bpz[x + 1], avx[x], avy[x], avz[x], bvx[x + 1], bvy[x + 1], bvz[x + 1],
+            restDiag, k, c, D1[x + 1], D1[x + 1 + stride], D1[x + 1 + 2 * stride]);
+        SpringForce(bpx[x], bpy[x], bpz[x], apx[x + 1], apy[x + 1], apz[x + 1], bvx[x], bvy[x], bvz[x], avx[x + 1], avy[x + 1], avz[x + 1],
+            restDiag, k, c, D2[x + 1], D2[x + 1 + stride], D2[x + 1 + 2 * stride]);
+    }
+
+    GRID_IVDEP
+
+    for (int x = 0; x < width - 1; x++)
+    {
+        TriangleForce(apx[x], apy[x], apz[x], bpx[x], bpy[x], bpz[x], bpx[x + 1], bpy[x + 1], bpz[x + 1],
+            avx[x], avy[x], avz[x], bvx[x], bvy[x], bvz[x], bvx[x + 1], bvy[x + 1], bvz[x + 1],
+            dragScale, wx, wy, wz, T1[x + 1], T1[x + 1 + stride], T1[x + 1 + 2 * stride]);
+        TriangleForce(apx[x], apy[x], apz[x], bpx[x + 1], bpy[x + 1], bpz[x + 1], apx[x + 1], apy[x + 1], apz[x + 1],
+            avx[x], avy[x], avz[x], bvx[x + 1], bvy[x + 1], bvz[x + 1], avx[x + 1], avy[x + 1], avz[x + 1],
+            dragScale, wx, wy, wz, T2[x + 1], T2[x + 1 + stride], T2[x + 1 + 2 * stride]);
+    }
+}
+
+// HorizontalForces: Forces of the horizontal springs of row a.
+static GRID_INLINE void HorizontalForces(const GridRow& a, int width, const GridParams& p, float* scratch)
+{
+    const int stride = width + 1;
+    GRID_ROW(a, a)
+    float* __restrict H = scratch + SCRATCH_H * stride;
+    const float k = p.springConst, c = p.dampingConst, rest = p.restLength;
+
+    GRID_IVDEP
+
+    for (int x = 0; x < width - 1; x++)
+    {
+        SpringForce(apx[x], apy[x], apz[x], apx[x + 1], apy[x + 1], apz[x + 1], avx[x], avy[x], avz[x], avx[x + 1], avy[x + 1], avz[x + 1],
+            rest, k, c, H[x + 1], H[x + 1 + stride], H[x + 1 + 2 * stride]);
+    }
+}
+
+// AddUpperForces: Adds the horizontal springs, and if withCell the cell row below, to the forces of the upper row.
+static GRID_INLINE void AddUpperForces(float* F, const float* scratch, int width, bool withCell)
+{
+    const int stride = width + 1;
+    for (int d = 0; d < 3; d++)
+    {
+        float* __restrict f = F + d * stride;
+        const float* __restrict H = scratch + (SCRATCH_H + d) * stride;
+        GRID_IVDEP
+        for (int x = 0; x < width; x++)
+        {
+            f[x] += H[x + 1];
+            f[x] -= H[x];
+        }
+        if (!withCell) continue;
+
+        const float* __restrict V = scratch + (SCRATCH_V + d) * stride;
+        const float* __restrict D1 = scratch + (SCRATCH_D1 + d) * stride;
+        const float* __restrict D2 = scratch + (SCRATCH_D2 + d) * stride;
+        const float* __restrict T1 = scratch + (SCRATCH_T1 + d) * stride;
+        const float* __restrict T2 = scratch + (SCRATCH_T2 + d) * stride;
+        GRID_IVDEP
+        for (int x = 0; x < width; x++)
+        {
+            // Top-left of cell x, top-right of cell x - 1.
+            f[x] += V[x];
+            f[x] += D1[x + 1];
+            f[x] -= D2[x];
+            f[x] += T1[x + 1];
+            f[x] += T2[x + 1];
+            f[x] += T2[x];
+        }
+    }
+}
+
+// SetLowerForces: Starts the forces of the lower row with the cell row above it.
+static GRID_INLINE void SetLowerForces(float* F, const float* scratch, int width)
+{
+    const int stride = width + 1;
+    for (int d = 0; d < 3; d++)
+    {
+        float* __restrict f = F + d * stride;
+        const float* __restrict V = scratch + (SCRATCH_V + d) * stride;
+        const float* __restrict D1 = scratch + (SCRATCH_D1 + d) * stride;
+        const float* __restrict D2 = scratch + (SCRATCH_D2 + d) * stride;
+        const float* __restrict T1 = scratch + (SCRATCH_T1 + d) * stride;
+        const float* __restrict T2 = scratch + (SCRATCH_T2 + d) * stride;
+        GRID_IVDEP
+        for (int x = 0; x < width; x++)
+        {
+            // Bottom-left of cell x, bottom-right of cell x - 1.
+            float s = -V[x];
+            s -= D1[x];
+            s += D2[x + 1];
+            s += T1[x + 1];
+            s += T1[x];
+            s += T2[x];
+            f[x] = s;
+        }
+    }
+}
+
+// IntegrateRow: Symplectic Euler and ground collision for one row, the same update as ParticleSystem::Integrate.
+static GRID_INLINE void IntegrateRow(const GridRow& r, const float* F, int width, float h, const GridParams& p)
+{
+    const int stride = width + 1;
+    const float floorY = p.groundPos + (float)EPSILON;
+    const float g = p.gravityAcce;
+    float* __restrict PX = r.px;
+    float* __restrict PY = r.py;
+    float* __restrict PZ = r.pz;
+    float* __restrict VX = r.vx;
+    float* __restrict VY = r.vy;
+    float* __restrict VZ = r.vz;
+    const float* __restrict W = r.w;
+    const float* __restrict FX = F;
+    const float* __restrict FY = F + stride;
+    const float* __restrict FZ = F + 2 * stride;
+
+    GRID_IVDEP
+
+    for (int x = 0; x < width; x++)
+    {
+        float active = W[x] > 0.0f ? 1.0f : 0.0f;
+
+        VX[x] += FX[x] * W[x] * h;
+        VY[x] += (FY[x] * W[x] - g * active) * h;
+        VZ[x] += FZ[x] * W[x] * h;
+
+        PX[x] += VX[x] * h;
+        PY[x] += VY[x] * h;
+        PZ[x] += VZ[x] * h;
+
+        bool below = active > 0.0f && PY[x] < floorY;
+        PY[x] = below ? floorY : PY[x];
+        VY[x] = below ? 0.0f : VY[x];
+    }
+}
+
+// BeginSweep: Starts a substep's sweep at row yBegin. Rows yBegin - 1 and yBegin must hold the state before the substep.
+// The force row of a row y lives in the rolling slot y & 1 of the substep's force arrays.
+static GRID_INLINE void BeginSweep(const GridRow* rows, int yBegin, int width, const GridParams& p, float* elements, float* forces)
+{
+    const int stride = width + 1;
+    float* F = forces + (yBegin & 1) * 3 * stride;
+
+    // The first row starts with the cell row above it, whose upper row stays untouched.
+    if (yBegin > 0)
+    {
+        CellRowForces(rows[yBegin - 1], rows[yBegin], width, p, elements);
+        SetLowerForces(F, elements, width);
+    }
+    else
+    {
+        std::fill(F, F + 3 * stride, 0.0f);
+    }
+}
+
+// SweepRow: Advances row y by one substep in place. Rows y and y + 1 must hold the state before the substep,
+// and row y - 1 must already be advanced. Every particle sums its forces in the same order wherever the sweep
+// started, so results do not depend on it.
+static GRID_INLINE void SweepRow(const GridRow* rows, int y, int width, int height, float h, const GridParams& p, float* elements, float* forces)
+{
+    const int stride = width + 1;
+    float* F = forces + (y & 1) * 3 * stride; // Forces of row y.
+    float* Fnext = forces + ((y + 1) & 1) * 3 * stride; // Forces of row y + 1.
+
+    // Row y is complete once the cell row below it is added, and no later cell row reads it.
+    bool lastRow = y == height - 1;
+    HorizontalForces(rows[y], width, p, elements);
+    if (!lastRow) CellRowForces(rows[y], rows[y + 1], width, p, elements);
+    AddUpperForces(F, elements, width, !lastRow);
+    if (!lastRow) SetLowerForces(Fnext, elements, width);
+
+    IntegrateRow(rows[y], F, width, h, p);
+}
+
+// Wavefront: Advances rows [begin, end) by 'substeps' substeps in one pass down the rows.
+// Substep s trails substep s - 1 by one row: once s - 1 has advanced row y + 1, row y has everything it needs
+// for substep s, so only a few rows per substep are live and the band streams through memory once per pass.
+// Substep s also advances the rows that later substeps still read, so its range is the band grown by
+// substeps - 1 - s rows per side. rows[y] must be valid for y in [begin - substeps, end + substeps].
+static GRID_INLINE void Wavefront(const GridRow* rows, int begin, int end, int substeps, int width, int height, float h, const GridParams& p, float* scratch)
+{
+    const int stride = width + 1;
+    float* elements = scratch;
+
+    // The zero padding of the element arrays stands for the missing neighbours at both ends of a row.
+    for (int a = 0; a < SCRATCH_ELEMENTS; a++)
+    {
+        elements[a * stride] = 0.0f;
+        elements[a * stride + width] = 0.0f;
+    }
+
+    int first = std::max(0, begin - (substeps - 1));
+    int last = std::min(height, end + (substeps - 1)) + substeps - 1;
+    for (int t = first; t < last; t++)
+    {
+        for (int s = 0; s < substeps; s++)
+        {
+            int margin = substeps - 1 - s;
+            int y = t - s;
+            int yBegin = std::max(0, begin - margin);
+            if (y < yBegin || y >= std::min(height, end + margin)) continue;
+
+            float* forces = scratch + (SCRATCH_ELEMENTS + s * SCRATCH_FORCE_ARRAYS) * stride;
+            if (y == yBegin) BeginSweep(rows, y, width, p, elements, forces);
+            SweepRow(rows, y, width, height, h, p, elements, forces);
+        }
+    }
+}
+
+typedef void (*WavefrontFunc)(const GridRow*, int, int, int, int, int, float, const GridParams&, float*);
+
+// WavefrontDefault: Wavefront compiled for the baseline instruction set.
+static void WavefrontDefault(const GridRow* rows, int begin, int end, int substeps, int width, int height, float h, const GridParams& p, float* scratch)
+{
+    Wavefront(rows, begin, end, substeps, width, height, h, p, scratch);
+}
+
+#ifdef GRID_SIMD_X86
+// WavefrontAVX2: Wavefront compiled for AVX2.
+GRID_TARGET_AVX2
+static void WavefrontAVX2(const GridRow* rows, int begin, int end, int substeps, int width, int height, float h, const GridParams& p, float* scratch)
+{
+    Wavefront(rows, begin, end, substeps, width, height, h, p, scratch);
+}
+#endif
+
+// Build: Stores the grid dimensions, band scratch is sized on the first substep.
+void GridSolver::Build(int _width, int _height)
+{
+    width = _width;
+    height = _height;
+    bands.clear();
+}
+
+// SetBlocking: Number of substeps a band advances per pass over its rows, 1 turns blocking off.
+void GridSolver::SetBlocking(int _blockSubsteps)
+{
+    blockSubsteps = std::max(1, _blockSubsteps);
+}
+
+// SetupBands: Splits the rows into numBands bands of nearly equal height, each with room for depth halo rows per side.
+void GridSolver::SetupBands(int numBands, int depth)
+{
+    if ((int)bands.size() == numBands && (numBands == 0 || bands[0].depth == depth)) return;
+
+    bands.resize(numBands);
+    for (int b = 0; b < numBands; b++)
+    {
+        bands[b].begin = (int)((long long)height * b / numBands);
+        bands[b].end = (int)((long long)height * (b + 1) / numBands);
+        bands[b].depth = depth;
+        bands[b].scratch.assign((SCRATCH_ELEMENTS + depth * SCRATCH_FORCE_ARRAYS) * (width + 1), 0.0f);
+
+        // Copies of the rows above and below the band, six arrays each. A single band has nothing around it.
+        bands[b].halo.assign(numBands > 1 ? 2 * depth * 6 * width : 0, 0.0f);
+    }
+}
+
+// GetRow: Row y as seen by a band, its own rows live in the particle system and the rows around it in its halo.
+GridRow GridSolver::GetRow(ParticleSystem& ps, Band& band, int y)
+{
+    const float* w = ps.invMass.data() + (size_t)y * width;
+    if (y >= band.begin && y < band.end)
+    {
+        size_t offset = (size_t)y * width;
+        return { ps.px.data() + offset, ps.py.data() + offset, ps.pz.data() + offset, ps.vx.data() + offset, ps.vy.data() + offset, ps.vz.data() + offset, w };
+    }
+
+    // Rows above the band fill the first depth slots, rows below it the next depth slots.
+    int slot = y < band.begin ? y - (band.begin - band.depth) : band.depth + y - band.end;
+    float* halo = band.halo.data() + (size_t)slot * 6 * width;
+    return { halo, halo + width, halo + 2 * width, halo + 3 * width, halo + 4 * width, halo + 5 * width, w };
+}
+
+// CopyHalo: Saves the rows around a band before any band of the pass moves them.
+void GridSolver::CopyHalo(ParticleSystem& ps, Band& band)
+{
+    for (int side = 0; side < 2; side++)
+    {
+        int first = side == 0 ? band.begin - band.depth : band.end;
+        for (int y = std::max(0, first); y < std::min(height, first + band.depth); y++)
+        {
+            size_t offset = (size_t)y * width;
+            GridRow row = GetRow(ps, band, y);
+            std::copy_n(ps.px.data() + offset, width, row.px);
+            std::copy_n(ps.py.data() + offset, width, row.py);
+            std::copy_n(ps.pz.data() + offset, width, row.pz);
+            std::copy_n(ps.vx.data() + offset, width, row.vx);
+            std::copy_n(ps.vy.data() + offset, width, row.vy);
+            std::copy_n(ps.vz.data() + offset, width, row.vz);
+        }
+    }
+}
+
+// AdvanceBand: Advances a band and the halo rows it reads by 'substeps' substeps with the kernel matching the spring kernel.
+void GridSolver::AdvanceBand(ParticleSystem& ps, Band& band, int substeps, float h, const GridParams& params)
+{
+    // Row table covering the band and the substeps halo rows on each side of it.
+    int first = std::max(0, band.begin - substeps);
+    int last = std::min(height - 1, band.end + substeps - 1);
+    band.rows.clear();
+    for (int y = first; y <= last; y++)
+    {
+        band.rows.push_back(GetRow(ps, band, y));
+    }
+
+    WavefrontFunc wavefront = WavefrontDefault;
+#ifdef GRID_SIMD_X86
+    if (GetSpringKernel() == SPRING_KERNEL_AVX2) wavefront = WavefrontAVX2;
+#endif
+    wavefront(band.rows.data() - first, band.begin, band.end, substeps, width, height, h, params, band.scratch.data());
+}
+
+// Step: Advances all particles by 'substeps' substeps of length h.
+// The rows are split into a band per thread. Every pass first copies blockSubsteps halo rows on each side of
+// every band, then all bands advance blockSubsteps substeps in parallel as one wavefront, so the grid streams
+// through memory once per pass instead of once per substep.
+void GridSolver::Step(ParticleSystem& ps, float h, int substeps, const GridParams& params, int numThreads)
+{
+    int depth = std::min(blockSubsteps, substeps);
+    SetupBands(std::max(1, std::min(numThreads, height / GRID_MIN_BAND_ROWS)), depth);
+    int numBands = (int)bands.size();
+
+    for (int done = 0; done < substeps; done += depth)
+    {
+        int block = std::min(depth, substeps - done);
+        if (numBands > 1)
+        {
+            ThreadPool::Shared().ParallelFor(numBands, numThreads, [&](int begin, int end)
+                {
+                    for (int b = begin; b < end; b++) CopyHalo(ps, bands[b]);
+                });
+        }
+        ThreadPool::Shared().ParallelFor(numBands, numThreads, [&](int begin, int end)
+            {
+                for (int b = begin; b < end; b++) AdvanceBand(ps, bands[b], block, h, params);
+            });
+    }
+}
+
+// MaxStrain: Largest |length - rest| / rest over the structural and shear springs of the grid.
+float GridSolver::MaxStrain(const ParticleSystem& ps, int width, int height, float restLength, float restLengthDiag)
+{
+    float maxStrain = 0.0f;
+    auto strain = [&](int i, int j, float rest)
+    {
+        float len = glm::length(ps.GetPosition(j) - ps.GetPosition(i));
+        maxStrain = std::max(maxStrain, std::abs(len - rest) / rest);
+    };
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int i = x + y * width;
+            if (x < width - 1) strain(i, i + 1, restLength);
+            if (y < height - 1) strain(i, i + width, restLength);
+            if (x < width - 1 && y < height - 1)
+            {
+                strain(i, i + width + 1, restLengthDiag);
+                strain(i + width, i + 1, restLengthDiag);
+            }
+        }
+    }
+    return maxStrain;
+}
@@ -0,0 +1,264 @@
+#include "ImplicitSolver.h"
+
+#include "ThreadPool.h"
+
+// Minimum number of matrix rows per task when the matrix-vector product is split across threads.
+#define ROW_GRAIN 512
+
+// Build: Creates the block sparsity pattern (one diagonal block per particle and one block per connected pair).
+void ImplicitSolver::Build(int _numParticles, const std::vector<const std::vector<SpringDamper>*>& _springGroups)
+{
+    numParticles = _numParticles;
+    springGroups = _springGroups;
+
+    // Collect the neighbors of every particle, including itself for the diagonal block.
+    std::vector<std::vector<int>> neighbors(numParticles);
+    for (int i = 0; i < numParticles; i++)
+    {
+        neighbors[i].push_back(i);
+    }
+    for (auto group : springGroups)
+    {
+        for (const SpringDamper& sp : *group)
+        {
+            neighbors[sp.i].push_back(sp.j);
+            neighbors[sp.j].push_back(sp.i);
+        }
+    }
+
+    // Compress the neighbor lists into block CSR form with sorted, unique columns.
+    rowStart.assign(numParticles + 1, 0);
+    cols.clear();
+    diagBlock.resize(numParticles);
+    for (int i = 0; i < numParticles; i++)
+    {
+        std::vector<int>& row = neighbors[i];
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+
+        rowStart[i] = (int)cols.size();
+        for (int j : row)
+        {
+            if (j == i) diagBlock[i] = (int)cols.size();
+            cols.push_back(j);
+        }
+    }
+    rowStart[numParticles] = (int)cols.size();
+    blocks.resize(cols.size());
+
+    // Locate the off-diagonal blocks of every spring once, so assembly needs no searching.
+    auto findBlock = [&](int row, int col)
+    {
+        auto first = cols.begin() + rowStart[row];
+        auto last = cols.begin() + rowStart[row + 1];
+        return (int)(std::lower_bound(first, last, col) - cols.begin());
+    };
+    springBlockIJ.clear();
+    springBlockJI.clear();
+    for (auto group : springGroups)
+    {
+        for (const SpringDamper& sp : *group)
+        {
+            springBlockIJ.push_back(findBlock(sp.i, sp.j));
+            springBlockJI.push_back(findBlock(sp.j, sp.i));
+        }
+    }
+
+    // Size the solver vectors.
+    rhs.resize(numParticles);
+    dv.resize(numParticles);
+    r.resize(numParticles);
+    z.resize(numParticles);
+    p.resize(numParticles);
+    q.resize(numParticles);
+    precond.resize(numParticles);
+    filter.resize(numParticles);
+}
+
+// Multiply: y = A * x, rows are independent and split across threads.
+void ImplicitSolver::Multiply(const std::vector<glm::vec3>& x, std::vector<glm::vec3>& y, int numThreads)
+{
+    ThreadPool::Shared().ParallelFor(numParticles, std::min(numThreads, numParticles / ROW_GRAIN), [&](int begin, int end)
+        {
+            for (int row = begin; row < end; row++)
+            {
+                glm::vec3 sum(0.0f);
+                for (int b = rowStart[row]; b < rowStart[row + 1]; b++)
+                {
+                    sum += blocks[b] * x[cols[b]];
+                }
+                y[row] = sum;
+            }
+        });
+}
+
+// Precondition: z = M^-1 r with one multigrid V-cycle or the inverted diagonal blocks.
+void ImplicitSolver::Precondition(bool useMultigrid, int numThreads)
+{
+    if (useMultigrid)
+    {
+        multigrid.Apply(r, z, numThreads);
+        return;
+    }
+    for (int i = 0; i < numParticles; i++)
+    {
+        z[i] = precond[i] * r[i];
+    }
+}
+
+// Step: Assembles the linear system for one backward-Euler step, solves it with PCG and advances the particles.
+void ImplicitSolver::Step(ParticleSystem& ps, float h, float springConst, float dampingConst, float gravityAcce, float groundPos, int numThreads)
+{
+    const int n = numParticles;
+    const glm::mat3 I(1.0f);
+
+    // Start from the mass matrix on the diagonal and the external forces (plus gravity) in the force vector.
+    std::fill(blocks.begin(), blocks.end(), glm::mat3(0.0f));
+    for (int i = 0; i < n; i++)
+    {
+        bool pinned = ps.invMass[i] == 0.0f;
+        float m = pinned ? 1.0f : 1.0f / ps.invMass[i];
+
+        blocks[diagBlock[i]] = m * I;
+        filter[i] = pinned ? 0.0f : 1.0f;
+
+        glm::vec3 f(ps.fx[i], ps.fy[i], ps.fz[i]);
+        if (!pinned) f.y -= m * gravityAcce;
+        rhs[i] = h * f;
+    }
+
+    // Add the spring forces and their Jacobians.
+    int s = 0;
+    for (auto group : springGroups)
+    {
+        for (const SpringDamper& sp : *group)
+        {
+            const int i = sp.i;
+            const int j = sp.j;
+            const int blockIJ = springBlockIJ[s];
+            const int blockJI = springBlockJI[s];
+            s++;
+
+            glm::vec3 xi = ps.GetPosition(i), xj = ps.GetPosition(j);
+            glm::vec3 vi = ps.GetVelocity(i), vj = ps.GetVelocity(j);
+
+            glm::vec3 d = xj - xi;
+            float len = glm::length(d);
+            if (len <= EPSILON) continue; // A degenerate spring has no defined direction, skip it.
+            d /= len;
+
+            // Spring and damping force on particle i (the opposite acts on j).
+            glm::vec3 f = (springConst * (len - sp.restLength) + dampingConst * glm::dot(vj - vi, d)) * d;
+
+            // Stiffness Jacobian dF_i/dx_j. The transverse term is clamped at 0 so compressed springs keep A positive definite.
+            glm::mat3 ddT = glm::outerProduct(d, d);
+            glm::mat3 K = springConst * (ddT + std::max(0.0f, 1.0f - sp.restLength / len) * (I - ddT));
+
+            // Damping Jacobian dF_i/dv_j.
+            glm::mat3 D = dampingConst * ddT;
+
+            // Right-hand side: h * (F + h * dF/dx * v).
+            glm::vec3 Kv = K * (vj - vi);
+            rhs[i] += h * (f + h * Kv);
+            rhs[j] += h * (-f - h * Kv);
+
+            // System matrix A = M - h * dF/dv - h^2 * dF/dx.
+            glm::mat3 Aij = h * D + h * h * K;
+            blocks[diagBlock[i]] += Aij;
+            blocks[diagBlock[j]] += Aij;
+            blocks[blockIJ] -= Aij;
+            blocks[blockJI] -= Aij;
+        }
+    }
+
+    // Multigrid V-cycle on the filtered system, or block Jacobi: the inverse of every diagonal block.
+    bool useMultigrid = preconditioner == PRECOND_MULTIGRID && multigrid.IsBuilt() && multigrid.Setup(n, rowStart, cols, blocks, filter, numThreads);
+    if (!useMultigrid)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            precond[i] = glm::inverse(blocks[diagBlock[i]]);
+        }
+    }
+
+    // Filtered preconditioned conjugate gradient, starting from dv = 0.
+    float bNorm = 0.0f;
+    float rho = 0.0f;
+    for (int i = 0; i < n; i++)
+    {
+        dv[i] = glm::vec3(0.0f);
+        r[i] = filter[i] * rhs[i];
+        bNorm += glm::dot(r[i], r[i]);
+    }
+    Precondition(useMultigrid, numThreads);
+    for (int i = 0; i < n; i++)
+    {
+        p[i] = filter[i] * z[i];
+        rho += glm::dot(r[i], z[i]);
+    }
+
+    float threshold = tolerance * tolerance * bNorm;
+    float rNorm = bNorm;
+    int iter = 0;
+    while (iter < maxIterations && rNorm > threshold)
+    {
+        Multiply(p, q, numThreads);
+
+        float pq = 0.0f;
+        for (int i = 0; i < n; i++)
+        {
+            q[i] *= filter[i];
+            pq += glm::dot(p[i], q[i]);
+        }
+        if (pq <= 0.0f) break; // The matrix is positive definite, so this only happens once converged to round-off.
+
+        // Step along the search direction and update the residual.
+        float alpha = rho / pq;
+        float rhoNew = 0.0f;
+        rNorm = 0.0f;
+        for (int i = 0; i < n; i++)
+        {
+            dv[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+            rNorm += glm::dot(r[i], r[i]);
+        }
+        Precondition(useMultigrid, numThreads);
+        for (int i = 0; i < n; i++)
+        {
+            rhoNew += glm::dot(r[i], z[i]);
+        }
+
+        // Next conjugate search direction.
+        float beta = rhoNew / rho;
+        rho = rhoNew;
+        for (int i = 0; i < n; i++)
+        {
+            p[i] = filter[i] * (z[i] + beta * p[i]);
+        }
+        iter++;
+    }
+    lastIterations = iter;
+    lastResidual = bNorm > 0.0f ? sqrtf(rNorm / bNorm) : 0.0f;
+
+    // Apply the velocity change, move the particles and resolve ground collision.
+    const float floorY = groundPos + (float)EPSILON;
+    for (int i = 0; i < n; i++)
+    {
+        ps.vx[i] += dv[i].x;
+        ps.vy[i] += dv[i].y;
+        ps.vz[i] += dv[i].z;
+
+        ps.px[i] += ps.vx[i] * h;
+        ps.py[i] += ps.vy[i] * h;
+        ps.pz[i] += ps.vz[i] * h;
+
+        if (filter[i] > 0.0f && ps.py[i] < floorY)
+        {
+            ps.py[i] = floorY;
+            ps.vy[i] = 0.0f;
+        }
+    }
+
+    // Forces are consumed by the step.
+    ps.ResetForces();
+}
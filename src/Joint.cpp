@@ -8,14 +8,16 @@ BallJoint::BallJoint()
 	rotZ = new DOF();
 }
 
-// Destructor: Deletes all child joints recursively.
+// Destructor: Deletes all child joints recursively, along with the degrees of freedom.
 BallJoint::~BallJoint()
 {
 	for (BallJoint* child : children)
 	{
-		child->~BallJoint();
 		delete child;
 	}
+	delete rotX;
+	delete rotY;
+	delete rotZ;
 }
 
 // Loads joint data from a tokenized file
@@ -101,8 +103,6 @@ void BallJoint::load(Tokenizer* fileToken, std::vector<BallJoint*>& joints)
 			break;
 		}
 	}
-
-	cube = new Cube(boxmin, boxmax);
 }
 
 // Updates the joint's transformation matrices and applies the changes to children.
@@ -124,19 +124,6 @@ void BallJoint::update(const glm::mat4& parent2World)
 	}
 }
 
-// Draws the joint and its children.
-void BallJoint::draw(const glm::mat4& viewProjMtx, GLuint shader)
-{
-	// Draw the visual representation of this joint.
-	cube->draw(viewProjMtx * loc2World, shader);
-
-	// Draw all children joints.
-	for (BallJoint* child : children)
-	{
-		child->draw(viewProjMtx, shader);
-	}
-}
-
 // Adds a child joint to this joint.
 void BallJoint::addChild(BallJoint* child)
 {
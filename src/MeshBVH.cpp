@@ -0,0 +1,213 @@
+#include "MeshBVH.h"
+
+#include "ThreadPool.h"
+
+// Most triangles per leaf.
+#define BVH_LEAF_SIZE 4
+
+// Minimum number of nodes per task when a level is refit across threads.
+#define BVH_GRAIN 64
+
+// ClosestOnTriangle: Barycentric weights of the point of triangle abc closest to p (Ericson, Real-Time Collision Detection 5.1.5).
+glm::vec3 ClosestOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return glm::vec3(1.0f, 0.0f, 0.0f);
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return glm::vec3(0.0f, 1.0f, 0.0f);
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        float v = d1 / (d1 - d3);
+        return glm::vec3(1.0f - v, v, 0.0f);
+    }
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return glm::vec3(0.0f, 0.0f, 1.0f);
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        float w = d2 / (d2 - d6);
+        return glm::vec3(1.0f - w, 0.0f, w);
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+    {
+        float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return glm::vec3(0.0f, 1.0f - w, w);
+    }
+
+    float denom = 1.0f / (va + vb + vc);
+    float v = vb * denom, w = vc * denom;
+    return glm::vec3(1.0f - v - w, v, w);
+}
+
+// BoxDistance2: Squared distance from p to the box [lo, hi], 0 inside.
+static inline float BoxDistance2(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& hi)
+{
+    glm::vec3 d = glm::max(glm::max(lo - p, p - hi), glm::vec3(0.0f));
+    return glm::dot(d, d);
+}
+
+// Build: Splits the triangles at the median centroid along the longest side of the centroid bounds until at most
+// BVH_LEAF_SIZE are left. Nodes are created breadth first, so siblings are adjacent and the levels come in order,
+// then renumbered with the deepest level first.
+void MeshBVH::Build(const std::vector<glm::vec3>& positions, const std::vector<glm::ivec3>& triangles)
+{
+    nodes.clear();
+    levelStart.clear();
+    tris.clear();
+    triIndex.clear();
+    int n = (int)triangles.size();
+    if (n == 0) return;
+
+    std::vector<glm::vec3> centroids(n);
+    for (int t = 0; t < n; t++) centroids[t] = (positions[triangles[t].x] + positions[triangles[t].y] + positions[triangles[t].z]) / 3.0f;
+    std::vector<int> order(n);
+    for (int t = 0; t < n; t++) order[t] = t;
+
+    std::vector<Node> breadthFirst;
+    std::vector<int> depth;
+    breadthFirst.push_back({ glm::vec3(0.0f), 0, glm::vec3(0.0f), n });
+    depth.push_back(0);
+    for (int k = 0; k < (int)breadthFirst.size(); k++)
+    {
+        int first = breadthFirst[k].first, count = breadthFirst[k].count;
+        if (count <= BVH_LEAF_SIZE) continue;
+
+        glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+        for (int i = first; i < first + count; i++)
+        {
+            lo = glm::min(lo, centroids[order[i]]);
+            hi = glm::max(hi, centroids[order[i]]);
+        }
+        glm::vec3 extent = hi - lo;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        int half = count / 2;
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+            [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+        breadthFirst[k].first = (int)breadthFirst.size();
+        breadthFirst[k].count = 0;
+        breadthFirst.push_back({ glm::vec3(0.0f), first, glm::vec3(0.0f), half });
+        breadthFirst.push_back({ glm::vec3(0.0f), first + half, glm::vec3(0.0f), count - half });
+        depth.push_back(depth[k] + 1);
+        depth.push_back(depth[k] + 1);
+    }
+
+    // Breadth-first index of the first node of every depth, then the new start of every level, deepest first.
+    int numLevels = depth.back() + 1;
+    std::vector<int> depthStart(numLevels + 1, 0);
+    for (int d : depth) depthStart[d + 1]++;
+    for (int d = 0; d < numLevels; d++) depthStart[d + 1] += depthStart[d];
+    levelStart.assign(numLevels + 1, 0);
+    for (int l = 0; l < numLevels; l++)
+    {
+        int d = numLevels - 1 - l;
+        levelStart[l + 1] = levelStart[l] + depthStart[d + 1] - depthStart[d];
+    }
+
+    std::vector<int> newIndex(breadthFirst.size());
+    for (int k = 0; k < (int)breadthFirst.size(); k++) newIndex[k] = levelStart[numLevels - 1 - depth[k]] + k - depthStart[depth[k]];
+    nodes.resize(breadthFirst.size());
+    for (int k = 0; k < (int)breadthFirst.size(); k++)
+    {
+        Node node = breadthFirst[k];
+        if (node.count == 0) node.first = newIndex[node.first];
+        nodes[newIndex[k]] = node;
+    }
+
+    triIndex = order;
+    tris.resize(n);
+    for (int i = 0; i < n; i++) tris[i] = triangles[order[i]];
+
+    Refit(positions, 1);
+}
+
+// RefitNode: Box of a leaf's triangles, or the union of an inner node's children.
+inline void MeshBVH::RefitNode(Node& node, const std::vector<glm::vec3>& positions) const
+{
+    if (node.count == 0)
+    {
+        node.lo = glm::min(nodes[node.first].lo, nodes[node.first + 1].lo);
+        node.hi = glm::max(nodes[node.first].hi, nodes[node.first + 1].hi);
+        return;
+    }
+
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (int t = node.first; t < node.first + node.count; t++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            lo = glm::min(lo, positions[tris[t][k]]);
+            hi = glm::max(hi, positions[tris[t][k]]);
+        }
+    }
+    node.lo = lo;
+    node.hi = hi;
+}
+
+// Refit: Recomputes the boxes level by level from the leaves up, each level split across threads.
+void MeshBVH::Refit(const std::vector<glm::vec3>& positions, int numThreads)
+{
+    ThreadPool::Shared().ParallelForBatches(levelStart, numThreads, BVH_GRAIN, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++) RefitNode(nodes[i], positions);
+        });
+}
+
+// FindClosest: Depth-first search from the root, nearer child first, skipping boxes farther than the best point so far.
+bool MeshBVH::FindClosest(const glm::vec3& p, float maxDistance, const std::vector<glm::vec3>& positions, int& triangle, glm::vec3& bary, float& distance2) const
+{
+    if (nodes.empty()) return false;
+
+    float best2 = maxDistance * maxDistance;
+    int best = -1;
+    int stack[64];
+    int top = 0;
+    stack[top++] = (int)nodes.size() - 1;
+    while (top > 0)
+    {
+        const Node& node = nodes[stack[--top]];
+        if (BoxDistance2(p, node.lo, node.hi) > best2) continue;
+
+        if (node.count > 0)
+        {
+            for (int t = node.first; t < node.first + node.count; t++)
+            {
+                const glm::vec3& a = positions[tris[t].x];
+                const glm::vec3& b = positions[tris[t].y];
+                const glm::vec3& c = positions[tris[t].z];
+                glm::vec3 w = ClosestOnTriangle(p, a, b, c);
+                glm::vec3 d = p - (w.x * a + w.y * b + w.z * c);
+                float d2 = glm::dot(d, d);
+                if (d2 < best2)
+                {
+                    best2 = d2;
+                    best = t;
+                    bary = w;
+                }
+            }
+            continue;
+        }
+
+        float dl = BoxDistance2(p, nodes[node.first].lo, nodes[node.first].hi);
+        float dr = BoxDistance2(p, nodes[node.first + 1].lo, nodes[node.first + 1].hi);
+        int nearChild = dl <= dr ? node.first : node.first + 1;
+        float nearDist = std::min(dl, dr), farDist = std::max(dl, dr);
+        if (farDist <= best2) stack[top++] = nearChild == node.first ? node.first + 1 : node.first;
+        if (nearDist <= best2) stack[top++] = nearChild;
+    }
+
+    if (best < 0) return false;
+    triangle = triIndex[best];
+    distance2 = best2;
+    return true;
+}
@@ -0,0 +1,113 @@
+#include "MeshCollider.h"
+
+#include "Particle.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+// Minimum number of vertices per task when the velocities are updated across threads.
+#define COLLIDER_GRAIN 1024
+
+// ContactVelocity: Works on the velocity relative to the surface. The push-out counts as a normal speed for the
+// friction, so a resting particle sticks as well as an approaching one.
+void ContactVelocity(glm::vec3& v, const glm::vec3& surfaceVelocity, const glm::vec3& normal, float depth, float friction, float deltaT)
+{
+    glm::vec3 relative = v - surfaceVelocity;
+    float vn = glm::dot(relative, normal);
+    glm::vec3 vt = relative - vn * normal;
+    float normalSpeed = std::max(-vn, depth / deltaT);
+    float vtLength = glm::length(vt);
+    if (vn < 0.0f) relative -= vn * normal;
+    if (vtLength > EPSILON) relative -= std::min(vtLength, friction * normalSpeed) / vtLength * vt;
+    v = surfaceVelocity + relative;
+}
+
+// Constructor: Builds the hierarchy over the starting pose, the mesh is at rest until the first update.
+MeshCollider::MeshCollider(const std::vector<glm::vec3>& _positions, const std::vector<glm::ivec3>& _triangles)
+{
+    triangles = _triangles;
+    positions = _positions;
+    velocities.assign(positions.size(), glm::vec3(0.0f));
+
+    float edgeSum = 0.0f;
+    for (const glm::ivec3& t : triangles)
+    {
+        edgeSum += glm::length(positions[t.y] - positions[t.x]) + glm::length(positions[t.z] - positions[t.y]) + glm::length(positions[t.x] - positions[t.z]);
+    }
+    reach = triangles.empty() ? 0.0f : edgeSum / (3.0f * triangles.size());
+
+    bvh.Build(positions, triangles);
+}
+
+// Update: Vertex velocities from the displacement over the elapsed time, then a refit of the hierarchy.
+// A frame without simulation steps keeps the previous velocities.
+void MeshCollider::Update(const std::vector<glm::vec3>& newPositions, float elapsed, int numThreads)
+{
+    if (newPositions.size() != positions.size()) return;
+    ScopedTimer timer(PROFILE_COLLISION);
+
+    int n = (int)positions.size();
+    ThreadPool::Shared().ParallelFor(n, std::min(numThreads, n / COLLIDER_GRAIN), [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                if (elapsed > 0.0f) velocities[i] = (newPositions[i] - positions[i]) / elapsed;
+                positions[i] = newPositions[i];
+            }
+        });
+    bvh.Refit(positions, numThreads);
+}
+
+// Collide: Finds the closest point of the mesh. The side the particle is on comes from where it was before the
+// substep, relative to the moving surface, so a particle that crossed within the reach is caught on the other
+// side. If it crossed or is within the thickness, it moves to the thickness on its side and its velocity is
+// corrected relative to the surface.
+bool MeshCollider::Collide(glm::vec3& x, glm::vec3& v, float deltaT) const
+{
+    int t;
+    glm::vec3 bary;
+    float distance2;
+    if (!bvh.FindClosest(x, std::max(thickness, reach), positions, t, bary, distance2)) return false;
+
+    const glm::ivec3& tri = triangles[t];
+    const glm::vec3& a = positions[tri.x];
+    glm::vec3 faceNormal = glm::cross(positions[tri.y] - a, positions[tri.z] - a);
+    float area = glm::length(faceNormal);
+    if (area <= EPSILON) return false;
+    faceNormal /= area;
+
+    glm::vec3 q = bary.x * a + bary.y * positions[tri.y] + bary.z * positions[tri.z];
+    glm::vec3 surfaceVelocity = bary.x * velocities[tri.x] + bary.y * velocities[tri.y] + bary.z * velocities[tri.z];
+    glm::vec3 relative = v - surfaceVelocity;
+    float side = glm::dot(x - q, faceNormal);
+    if (side - deltaT * glm::dot(relative, faceNormal) < 0.0f)
+    {
+        side = -side;
+        faceNormal = -faceNormal;
+    }
+
+    // On its side the particle moves away from the closest point, after crossing along the face normal.
+    float distance = sqrtf(distance2);
+    glm::vec3 normal;
+    float depth;
+    if (side >= 0.0f)
+    {
+        if (distance >= thickness) return false;
+        normal = distance > EPSILON ? (x - q) / distance : faceNormal;
+        depth = thickness - distance;
+    }
+    else
+    {
+        normal = faceNormal;
+        depth = thickness - side;
+    }
+    x += depth * normal;
+    ContactVelocity(v, surfaceVelocity, normal, depth, friction, deltaT);
+    return true;
+}
+
+// Touches: Same test as Collide on a copy of the particle.
+bool MeshCollider::Touches(const glm::vec3& x) const
+{
+    glm::vec3 y = x, v(0.0f);
+    return Collide(y, v, 1.0f);
+}
@@ -0,0 +1,276 @@
+#include "Multigrid.h"
+
+#include "ThreadPool.h"
+
+// Minimum number of grid rows per task when a level pass is split across threads.
+#define MG_ROW_GRAIN 16
+
+// Coarsening stops once neither side of the grid is longer than this.
+#define MG_COARSEST_SIZE 3
+
+// ForRow: Visits row i of level l. On the finest level, filtered rows become identity rows and filtered columns are dropped.
+template <typename F>
+inline void GridMultigrid::ForRow(int l, int i, F f) const
+{
+    if (l > 0)
+    {
+        const Level& level = levels[l];
+        for (int b = level.rowStart[i]; b < level.rowStart[i + 1]; b++) f(level.cols[b], level.blocks[b]);
+        return;
+    }
+
+    if (fineFilter[i] == 0.0f)
+    {
+        f(i, glm::mat3(1.0f));
+        return;
+    }
+    for (int b = fineRowStart[i]; b < fineRowStart[i + 1]; b++)
+    {
+        int j = fineCols[b];
+        if (j == i || fineFilter[j] != 0.0f) f(j, fineBlocks[b]);
+    }
+}
+
+// ForRows: Runs body(y) for the rows y = first, first + step, ... below height, split across threads.
+static void ForRows(int first, int step, int height, int numThreads, const std::function<void(int)>& body)
+{
+    int count = (height - first + step - 1) / step;
+    ThreadPool::Shared().ParallelFor(count, std::min(numThreads, count * step / MG_ROW_GRAIN), [&](int begin, int end)
+        {
+            for (int k = begin; k < end; k++) body(first + k * step);
+        });
+}
+
+// BuildLevel: Creates the clipped 9-point block pattern of a coarse grid and its work vectors.
+void GridMultigrid::BuildLevel(Level& level, int width, int height)
+{
+    int n = width * height;
+    level.width = width;
+    level.height = height;
+    level.rowStart.assign(n + 1, 0);
+    level.cols.clear();
+    level.slot.assign(9 * n, -1);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int i = x + y * width;
+            level.rowStart[i] = (int)level.cols.size();
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if (x + dx < 0 || x + dx >= width || y + dy < 0 || y + dy >= height) continue;
+                    level.slot[9 * i + (dx + 1) + 3 * (dy + 1)] = (int)level.cols.size();
+                    level.cols.push_back(i + dx + dy * width);
+                }
+            }
+        }
+    }
+    level.rowStart[n] = (int)level.cols.size();
+    level.blocks.resize(level.cols.size());
+    level.diagInv.resize(n);
+    level.x.resize(n);
+    level.b.resize(n);
+    level.r.resize(n);
+}
+
+// Build: Halves the grid until it is at most MG_COARSEST_SIZE on each side. A side of n fine nodes has
+// n / 2 + 1 coarse nodes when n is even, the last one only reached through the last fine node.
+void GridMultigrid::Build(int width, int height)
+{
+    levels.clear();
+    levels.emplace_back();
+    levels[0].width = width;
+    levels[0].height = height;
+    levels[0].diagInv.resize(width * height);
+    levels[0].r.resize(width * height);
+
+    while (std::max(width, height) > MG_COARSEST_SIZE)
+    {
+        width = (width + 2) / 2;
+        height = (height + 2) / 2;
+        levels.emplace_back();
+        BuildLevel(levels.back(), width, height);
+    }
+}
+
+// Coarsen: Galerkin product A_c = P^T A P of level l into level l + 1, gathered per coarse row.
+// Fine node x contributes to coarse node x / 2 with weight 1 when even, and to both neighbours with 1/2 when odd.
+void GridMultigrid::Coarsen(int l, int numThreads)
+{
+    const int fw = levels[l].width, fh = levels[l].height;
+    Level& coarse = levels[l + 1];
+    const int cw = coarse.width;
+
+    ForRows(0, 1, coarse.height, numThreads, [&](int Y)
+        {
+            for (int X = 0; X < cw; X++)
+            {
+                int I = X + Y * cw;
+                for (int b = coarse.rowStart[I]; b < coarse.rowStart[I + 1]; b++) coarse.blocks[b] = glm::mat3(0.0f);
+
+                for (int fy = std::max(0, 2 * Y - 1); fy <= std::min(fh - 1, 2 * Y + 1); fy++)
+                {
+                    for (int fx = std::max(0, 2 * X - 1); fx <= std::min(fw - 1, 2 * X + 1); fx++)
+                    {
+                        float wi = (fx == 2 * X ? 1.0f : 0.5f) * (fy == 2 * Y ? 1.0f : 0.5f);
+                        ForRow(l, fx + fy * fw, [&](int j, const glm::mat3& B)
+                            {
+                                int jx = j % fw, jy = j / fw;
+                                int jxOdd = jx & 1, jyOdd = jy & 1;
+                                float wj = wi * (jxOdd ? 0.5f : 1.0f) * (jyOdd ? 0.5f : 1.0f);
+                                for (int Jy = jy >> 1; Jy <= (jy + 1) >> 1; Jy++)
+                                {
+                                    for (int Jx = jx >> 1; Jx <= (jx + 1) >> 1; Jx++)
+                                    {
+                                        coarse.blocks[coarse.slot[9 * I + (Jx - X + 1) + 3 * (Jy - Y + 1)]] += wj * B;
+                                    }
+                                }
+                            });
+                    }
+                }
+                coarse.diagInv[I] = glm::inverse(coarse.blocks[coarse.slot[9 * I + 4]]);
+            }
+        });
+}
+
+// Setup: Checks that the fine operator fits the grid, inverts its diagonal blocks and builds every coarse operator.
+bool GridMultigrid::Setup(int numRows, const std::vector<int>& rowStart, const std::vector<int>& cols, const std::vector<glm::mat3>& blocks,
+    const std::vector<float>& filter, int numThreads)
+{
+    if (levels.empty() || numRows != levels[0].width * levels[0].height) return false;
+    Level& fine = levels[0];
+
+    fineRowStart = rowStart.data();
+    fineCols = cols.data();
+    fineBlocks = blocks.data();
+    fineFilter = filter.data();
+
+    const int w = fine.width;
+    for (int i = 0; i < numRows; i++)
+    {
+        glm::mat3 diag(1.0f);
+        for (int b = rowStart[i]; b < rowStart[i + 1]; b++)
+        {
+            int j = cols[b];
+            if (std::abs(j % w - i % w) > 1 || std::abs(j / w - i / w) > 1) return false;
+            if (j == i && filter[i] != 0.0f) diag = blocks[b];
+        }
+        fine.diagInv[i] = glm::inverse(diag);
+    }
+
+    for (int l = 0; l + 1 < (int)levels.size(); l++) Coarsen(l, numThreads);
+    return true;
+}
+
+// Smooth: One block Gauss-Seidel sweep over the four colors, forward or backward.
+void GridMultigrid::Smooth(int l, const glm::vec3* b, glm::vec3* x, bool forward, int numThreads)
+{
+    const Level& level = levels[l];
+    for (int c = 0; c < 4; c++)
+    {
+        int color = forward ? c : 3 - c;
+        int cx = color & 1, cy = color >> 1;
+        ForRows(cy, 2, level.height, numThreads, [&](int y)
+            {
+                for (int xi = cx; xi < level.width; xi += 2)
+                {
+                    int i = xi + y * level.width;
+                    glm::vec3 r = b[i];
+                    ForRow(l, i, [&](int j, const glm::mat3& B) { r -= B * x[j]; });
+                    x[i] += level.diagInv[i] * r;
+                }
+            });
+    }
+}
+
+// Residual: r = b - A x on level l.
+void GridMultigrid::Residual(int l, const glm::vec3* b, const glm::vec3* x, glm::vec3* r, int numThreads)
+{
+    const Level& level = levels[l];
+    ForRows(0, 1, level.height, numThreads, [&](int y)
+        {
+            for (int i = y * level.width; i < (y + 1) * level.width; i++)
+            {
+                glm::vec3 sum = b[i];
+                ForRow(l, i, [&](int j, const glm::mat3& B) { sum -= B * x[j]; });
+                r[i] = sum;
+            }
+        });
+}
+
+// Restrict: Right-hand side of level l + 1 from the residual of level l, b_c = P^T r.
+void GridMultigrid::Restrict(int l, const glm::vec3* r, int numThreads)
+{
+    const int fw = levels[l].width, fh = levels[l].height;
+    Level& coarse = levels[l + 1];
+    ForRows(0, 1, coarse.height, numThreads, [&](int Y)
+        {
+            for (int X = 0; X < coarse.width; X++)
+            {
+                glm::vec3 sum(0.0f);
+                for (int fy = std::max(0, 2 * Y - 1); fy <= std::min(fh - 1, 2 * Y + 1); fy++)
+                {
+                    for (int fx = std::max(0, 2 * X - 1); fx <= std::min(fw - 1, 2 * X + 1); fx++)
+                    {
+                        sum += (fx == 2 * X ? 1.0f : 0.5f) * (fy == 2 * Y ? 1.0f : 0.5f) * r[fx + fy * fw];
+                    }
+                }
+                coarse.b[X + Y * coarse.width] = sum;
+            }
+        });
+}
+
+// Prolong: Adds the bilinear interpolation of the level l + 1 solution to x on level l, x += P x_c.
+void GridMultigrid::Prolong(int l, glm::vec3* x, int numThreads)
+{
+    const int fw = levels[l].width;
+    const Level& coarse = levels[l + 1];
+    ForRows(0, 1, levels[l].height, numThreads, [&](int fy)
+        {
+            for (int fx = 0; fx < fw; fx++)
+            {
+                glm::vec3 sum(0.0f);
+                for (int Y = fy >> 1; Y <= (fy + 1) >> 1; Y++)
+                {
+                    for (int X = fx >> 1; X <= (fx + 1) >> 1; X++) sum += coarse.x[X + Y * coarse.width];
+                }
+                sum *= ((fx & 1) ? 0.5f : 1.0f) * ((fy & 1) ? 0.5f : 1.0f);
+                x[fx + fy * fw] += sum;
+            }
+        });
+}
+
+// Cycle: V-cycle for A_l x = b from x = 0.
+void GridMultigrid::Cycle(int l, const glm::vec3* b, glm::vec3* x, int numThreads)
+{
+    Level& level = levels[l];
+    std::fill(x, x + level.width * level.height, glm::vec3(0.0f));
+
+    // The coarsest level is a handful of nodes, symmetric sweeps solve it well enough.
+    if (l + 1 == (int)levels.size())
+    {
+        for (int s = 0; s < coarseSweeps; s++)
+        {
+            Smooth(l, b, x, true, numThreads);
+            Smooth(l, b, x, false, numThreads);
+        }
+        return;
+    }
+
+    for (int s = 0; s < smoothSweeps; s++) Smooth(l, b, x, true, numThreads);
+
+    Residual(l, b, x, level.r.data(), numThreads);
+    Restrict(l, level.r.data(), numThreads);
+    Cycle(l + 1, levels[l + 1].b.data(), levels[l + 1].x.data(), numThreads);
+    Prolong(l, x, numThreads);
+
+    for (int s = 0; s < smoothSweeps; s++) Smooth(l, b, x, false, numThreads);
+}
+
+// Apply: One V-cycle on the residual r of the fine system.
+void GridMultigrid::Apply(const std::vector<glm::vec3>& r, std::vector<glm::vec3>& z, int numThreads)
+{
+    Cycle(0, r.data(), z.data(), numThreads);
+}
@@ -1,93 +1,108 @@
 #include "Particle.h"
 
-// Constructor: Initializes the particle with given parameters.
-Particle::Particle(glm::vec3* _position, glm::vec3* _normal, float* _mass, float* _gravityAcce, float* _groundPos)
+// Resize: Allocates storage for n free particles of the given mass with zero velocity, force and normal.
+void ParticleSystem::Resize(int n, float mass)
 {
-    position = _position; // Pointer to the particle's position vector.
-    normal = _normal; // Pointer to the particle's normal vector, used for surface interaction.
-    isFixed = false; // Initially, the particle is not fixed and can move.
+    // Positions are filled in by the owner after resizing.
+    px.assign(n, 0.0f);
+    py.assign(n, 0.0f);
+    pz.assign(n, 0.0f);
 
-    mass = _mass; // Pointer to the particle's mass.
-    gravityAcce = _gravityAcce; // Pointer to the acceleration due to gravity affecting the particle.
-    groundPos = _groundPos; // Pointer to the ground's position (used for collision detection).
+    // Every particle starts at rest with no accumulated force.
+    vx.assign(n, 0.0f);
+    vy.assign(n, 0.0f);
+    vz.assign(n, 0.0f);
+    fx.assign(n, 0.0f);
+    fy.assign(n, 0.0f);
+    fz.assign(n, 0.0f);
 
-    // Initialize velocity and force vectors to zero.
-    velocity = glm::vec3(0.0f);
-    force = glm::vec3(0.0f);
-    prevForce = glm::vec3(0.0f); // Stores the force from the previous frame.
+    // All particles start free, normals are recomputed every frame.
+    invMass.assign(n, 1.0f / mass);
+    normals.assign(n, glm::vec3(0.0f));
 }
 
-// Apply an external force to the particle.
-void Particle::ApplyForce(glm::vec3 f)
+// SetMass: Updates the inverse mass of every free particle, pinned particles keep an inverse mass of 0.
+void ParticleSystem::SetMass(float mass)
 {
-    force += f; // Add the external force to the current total force acting on the particle.
+    float w = 1.0f / mass; // Inverse mass shared by all free particles.
+    for (float& m : invMass)
+    {
+        if (m != 0.0f) m = w;
+    }
 }
 
-// Apply the force of gravity to the particle based on its mass.
-void Particle::ApplyGravity()
+// SetFixed: Pins or releases a particle by switching its inverse mass between 0 and 1/mass.
+void ParticleSystem::SetFixed(int i, bool isFixed, float mass)
 {
-    force += glm::vec3(0.0f, -(*mass) * (*gravityAcce), 0.0f); // Gravity acts downward.
+    invMass[i] = isFixed ? 0.0f : 1.0f / mass;
+    if (isFixed)
+    {
+        // A pinned particle never accumulates velocity.
+        vx[i] = 0.0f;
+        vy[i] = 0.0f;
+        vz[i] = 0.0f;
+    }
 }
 
-// Update the particle's state by integrating its motion over time.
-void Particle::Integrate(float deltaTime)
+// Integrate: Advances particles [begin, end) by one time step with symplectic Euler, then resolves ground collision.
+// The loop body is branch-free so the compiler can vectorize it; pinned particles are masked out through invMass.
+void ParticleSystem::Integrate(float deltaTime, float gravityAcce, float groundPos, int begin, int end)
 {
-    if (isFixed) return; // Do nothing if the particle is fixed.
+    const float floorY = groundPos + (float)EPSILON; // Lowest allowed height for a free particle.
 
-    ApplyGravity(); // Apply gravity force for this frame.
+    float* __restrict PX = px.data();
+    float* __restrict PY = py.data();
+    float* __restrict PZ = pz.data();
+    float* __restrict VX = vx.data();
+    float* __restrict VY = vy.data();
+    float* __restrict VZ = vz.data();
+    float* __restrict FX = fx.data();
+    float* __restrict FY = fy.data();
+    float* __restrict FZ = fz.data();
+    const float* __restrict W = invMass.data();
 
-    glm::vec3 a = force / (*mass); // Calculate acceleration from force and mass.
-    if (a.length() > EPSILON) // Check if the acceleration is significant.
+    for (int i = begin; i < end; i++)
     {
-        velocity += a * deltaTime; // Update velocity based on acceleration.
-        // If the velocity is very small, reset it to zero to avoid jitter.
-        if (velocity.length() < EPSILON) velocity = glm::vec3(0.0f);
-        // Update position based on velocity.
-        *position += velocity * deltaTime;
-        prevForce = force; // Remember the force for next frame.
-    }
-    GroundCollision(); // Handle collision with the ground.
+        // Free particles feel gravity, pinned particles (W == 0) get no acceleration at all.
+        float active = W[i] > 0.0f ? 1.0f : 0.0f;
 
-    force = glm::vec3(0.0f); // Reset force after integration.
-}
+        // Update velocity from the accumulated force and gravity.
+        VX[i] += FX[i] * W[i] * deltaTime;
+        VY[i] += (FY[i] * W[i] - gravityAcce * active) * deltaTime;
+        VZ[i] += FZ[i] * W[i] * deltaTime;
 
-// Reset the accumulated force to zero. Can be used at the start of each simulation step.
-void Particle::ResetForce()
-{
-    force = glm::vec3(0.0f);
-}
+        // Update position from the new velocity.
+        PX[i] += VX[i] * deltaTime;
+        PY[i] += VY[i] * deltaTime;
+        PZ[i] += VZ[i] * deltaTime;
 
-// Getter for the particle's current velocity.
-glm::vec3 Particle::GetVelocity()
-{
-    return velocity;
-}
+        // Ground collision: clamp free particles to the ground and stop their vertical motion.
+        bool below = active > 0.0f && PY[i] < floorY;
+        PY[i] = below ? floorY : PY[i];
+        VY[i] = below ? 0.0f : VY[i];
 
-// Getter for the particle's current position.
-glm::vec3 Particle::GetPosition()
-{
-    return *position;
-}
-
-// Reset the particle's normal vector to zero. Useful for beginning of a new simulation step.
-void Particle::ResetNormal()
-{
-    *normal = glm::vec3(0.0f);
+        // Reset force after integration.
+        FX[i] = 0.0f;
+        FY[i] = 0.0f;
+        FZ[i] = 0.0f;
+    }
 }
 
-// Add a normal vector to the particle's current normal. Used for aggregating surface normals.
-void Particle::AddNormal(glm::vec3 n)
+// ResetForces: Clears the accumulated force of every particle.
+void ParticleSystem::ResetForces()
 {
-    *normal += n; 
+    std::fill(fx.begin(), fx.end(), 0.0f);
+    std::fill(fy.begin(), fy.end(), 0.0f);
+    std::fill(fz.begin(), fz.end(), 0.0f);
 }
 
-// Check for collision with the ground and adjust the particle's position and velocity accordingly.
-void Particle::GroundCollision()
+// GatherPositions: Interleaves the SoA positions into an array of vec3, e.g. for uploading to a VBO.
+void ParticleSystem::GatherPositions(std::vector<glm::vec3>& out) const
 {
-    // If the particle's position is below the ground, correct its position and zero out vertical velocity.
-    if (position->y < (*groundPos) + EPSILON)
+    const int n = Size();
+    out.resize(n);
+    for (int i = 0; i < n; i++)
     {
-        position->y = (*groundPos) + EPSILON; // Adjust position to sit on the ground.
-        velocity.y = 0.0f; // Stop downward movement.
+        out[i] = glm::vec3(px[i], py[i], pz[i]);
     }
 }
@@ -0,0 +1,175 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// Ring of the calling thread, created on its first recorded event.
+static thread_local ProfileRing* threadRing = nullptr;
+
+// Constructor: Starts the clock all event times are relative to.
+Profiler::Profiler()
+{
+    epoch = std::chrono::steady_clock::now();
+    for (int p = 0; p < NUM_PROFILE_PHASES; p++)
+    {
+        history[p].assign(HISTORY_SIZE, 0.0f);
+    }
+    ResetTotals();
+}
+
+// Destructor: Frees the rings of all threads.
+Profiler::~Profiler()
+{
+    for (ProfileRing* ring : rings) delete ring;
+}
+
+Profiler& Profiler::Shared()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+// GetThreadRing: Returns the calling thread's ring, registering a new one the first time.
+ProfileRing* Profiler::GetThreadRing()
+{
+    if (threadRing == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        threadRing = new ProfileRing();
+        threadRing->thread = (int)rings.size();
+        rings.push_back(threadRing);
+    }
+    return threadRing;
+}
+
+// Record: Appends an event to the calling thread's ring, overwriting the oldest one if the collector fell behind.
+void Profiler::Record(ProfilePhase phase, int64_t start, int64_t end)
+{
+    ProfileRing* ring = GetThreadRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+    ProfileEvent& e = ring->events[head & (ProfileRing::CAPACITY - 1)];
+    e.start = start;
+    e.end = end;
+    e.phase = phase;
+    e.thread = ring->thread;
+
+    // Publish the event to the collector.
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+// Collect: Moves the published events of every ring into the frame totals and the event log.
+void Profiler::Collect()
+{
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (ProfileRing* ring : rings)
+    {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = std::max(ring->tail, head > ProfileRing::CAPACITY ? head - ProfileRing::CAPACITY : 0);
+
+        // Copy first, then check which of the copied slots the owner may have reused in the meantime.
+        std::vector<ProfileEvent> events;
+        events.reserve((size_t)(head - begin));
+        for (uint64_t i = begin; i < head; i++)
+        {
+            events.push_back(ring->events[i & (ProfileRing::CAPACITY - 1)]);
+        }
+        // The owner may already be writing the slot of event newHead, which is also the slot of newHead - CAPACITY.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t newHead = ring->head.load(std::memory_order_acquire);
+        uint64_t valid = newHead + 1 > ProfileRing::CAPACITY ? newHead + 1 - ProfileRing::CAPACITY : 0;
+        ring->tail = head;
+
+        for (uint64_t i = begin; i < head; i++)
+        {
+            if (i < valid) continue;
+            const ProfileEvent& e = events[(size_t)(i - begin)];
+
+            frameTotals[e.phase] += (e.end - e.start) * 1e-9;
+
+            // Keep the latest LOG_SIZE events.
+            if (log.size() < LOG_SIZE)
+            {
+                log.push_back(e);
+            }
+            else
+            {
+                log[logOffset] = e;
+                logOffset = (logOffset + 1) % LOG_SIZE;
+            }
+        }
+    }
+}
+
+// EndFrame: Collects the events of the frame and appends its per-phase times to the rolling histories.
+// Times of scopes that ran concurrently on several threads are summed.
+void Profiler::EndFrame()
+{
+    Collect();
+    for (int p = 0; p < NUM_PROFILE_PHASES; p++)
+    {
+        totals[p] += frameTotals[p];
+        history[p][historyOffset] = (float)(frameTotals[p] * 1e3);
+        frameTotals[p] = 0.0;
+    }
+    historyOffset = (historyOffset + 1) % HISTORY_SIZE;
+}
+
+// ResetTotals: Clears the accumulated totals, the histories are left alone.
+void Profiler::ResetTotals()
+{
+    for (int p = 0; p < NUM_PROFILE_PHASES; p++)
+    {
+        totals[p] = 0.0;
+        frameTotals[p] = 0.0;
+    }
+}
+
+// GetLastFrameTime: Milliseconds spent in a phase during the last finished frame.
+float Profiler::GetLastFrameTime(ProfilePhase phase) const
+{
+    return history[phase][(historyOffset + HISTORY_SIZE - 1) % HISTORY_SIZE];
+}
+
+// GetPhaseName: Human-readable name of a phase for reports.
+const char* Profiler::GetPhaseName(ProfilePhase phase)
+{
+    static const char* names[NUM_PROFILE_PHASES] = { "springs", "aero", "integrate", "solve", "collision", "normals", "upload", "skin", "fk", "animation" };
+    return names[phase];
+}
+
+// WriteCSV: Writes one row per logged event: thread, phase, start and duration in microseconds.
+bool Profiler::WriteCSV(const std::string& fileName)
+{
+    FILE* file = fopen(fileName.c_str(), "w");
+    if (file == nullptr) return false;
+
+    fprintf(file, "thread,phase,start_us,duration_us\n");
+    for (size_t i = 0; i < log.size(); i++)
+    {
+        const ProfileEvent& e = log[(logOffset + i) % log.size()];
+        fprintf(file, "%d,%s,%.3f,%.3f\n", e.thread, GetPhaseName((ProfilePhase)e.phase), e.start * 1e-3, (e.end - e.start) * 1e-3);
+    }
+
+    fclose(file);
+    return true;
+}
+
+// WriteChromeTrace: Writes the logged events as complete ("X") trace events, one track per thread.
+bool Profiler::WriteChromeTrace(const std::string& fileName)
+{
+    FILE* file = fopen(fileName.c_str(), "w");
+    if (file == nullptr) return false;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < log.size(); i++)
+    {
+        const ProfileEvent& e = log[(logOffset + i) % log.size()];
+        fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+            GetPhaseName((ProfilePhase)e.phase), e.thread, e.start * 1e-3, (e.end - e.start) * 1e-3, i + 1 < log.size() ? "," : "");
+    }
+    fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,230 @@
+#include "ProjectiveSolver.h"
+
+#include "ThreadPool.h"
+
+// Minimum number of springs per task when the local step is split across threads.
+#define PD_GRAIN 1024
+
+// Build: Stores the constraint groups and sizes the per-spring projections.
+void ProjectiveSolver::Build(int _numParticles, const std::vector<ConstraintGroup>& _groups)
+{
+    numParticles = _numParticles;
+    groups = _groups;
+
+    projections.resize(groups.size());
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        projections[g].resize(groups[g].springs->size());
+    }
+
+    inertia.resize(numParticles);
+    prevPos.resize(numParticles);
+
+    // The pattern depends on pinning, so it is created on the first step.
+    factored = false;
+    factoredInvMass.clear();
+}
+
+// BuildPattern: Numbers the free particles and creates the sparsity pattern of the global matrix over them.
+void ProjectiveSolver::BuildPattern(const ParticleSystem& ps)
+{
+    freeRow.assign(numParticles, -1);
+    freeParticles.clear();
+    for (int i = 0; i < numParticles; i++)
+    {
+        if (ps.invMass[i] > 0.0f)
+        {
+            freeRow[i] = (int)freeParticles.size();
+            freeParticles.push_back(i);
+        }
+    }
+    const int n = (int)freeParticles.size();
+
+    // Diagonal plus one entry per spring between two free particles, in both triangles.
+    std::vector<std::vector<int>> columns(n);
+    for (int r = 0; r < n; r++)
+    {
+        columns[r].push_back(r);
+    }
+    for (auto& group : groups)
+    {
+        for (const SpringDamper& sp : *group.springs)
+        {
+            int ri = freeRow[sp.i], rj = freeRow[sp.j];
+            if (ri < 0 || rj < 0) continue;
+            columns[ri].push_back(rj);
+            columns[rj].push_back(ri);
+        }
+    }
+
+    A.n = n;
+    A.colStart.assign(n + 1, 0);
+    A.rows.clear();
+    for (int c = 0; c < n; c++)
+    {
+        std::sort(columns[c].begin(), columns[c].end());
+        columns[c].erase(std::unique(columns[c].begin(), columns[c].end()), columns[c].end());
+        A.rows.insert(A.rows.end(), columns[c].begin(), columns[c].end());
+        A.colStart[c + 1] = (int)A.rows.size();
+    }
+    A.values.assign(A.rows.size(), 0.0);
+
+    ldlt.Analyze(A);
+
+    for (int d = 0; d < 3; d++)
+    {
+        rhs[d].resize(n);
+    }
+}
+
+// FillMatrix: Computes M / h^2 + k L over the free particles. Springs to pinned particles only add to the diagonal.
+void ProjectiveSolver::FillMatrix(const ParticleSystem& ps, float springConst, float h)
+{
+    auto entry = [&](int row, int col) -> double&
+    {
+        auto first = A.rows.begin() + A.colStart[col];
+        auto last = A.rows.begin() + A.colStart[col + 1];
+        return A.values[std::lower_bound(first, last, row) - A.rows.begin()];
+    };
+
+    std::fill(A.values.begin(), A.values.end(), 0.0);
+    for (int r = 0; r < A.n; r++)
+    {
+        entry(r, r) = 1.0 / (ps.invMass[freeParticles[r]] * h * h);
+    }
+
+    for (auto& group : groups)
+    {
+        for (const SpringDamper& sp : *group.springs)
+        {
+            int ri = freeRow[sp.i], rj = freeRow[sp.j];
+            if (ri >= 0) entry(ri, ri) += springConst;
+            if (rj >= 0) entry(rj, rj) += springConst;
+            if (ri >= 0 && rj >= 0)
+            {
+                entry(ri, rj) -= springConst;
+                entry(rj, ri) -= springConst;
+            }
+        }
+    }
+}
+
+// Step: One projective dynamics step. Refactors the global matrix first if its inputs changed.
+void ProjectiveSolver::Step(ParticleSystem& ps, float h, int iterations, float springConst, float dampingConst, float gravityAcce, float groundPos, int numThreads)
+{
+    // A different set of pinned particles changes the pattern, other parameters only the values.
+    bool pinsChanged = factoredInvMass.size() != ps.invMass.size();
+    bool valuesChanged = !factored || factoredK != springConst || factoredH != h;
+    for (int i = 0; i < numParticles && !pinsChanged; i++)
+    {
+        if ((factoredInvMass[i] == 0.0f) != (ps.invMass[i] == 0.0f)) pinsChanged = true;
+        else if (factoredInvMass[i] != ps.invMass[i]) valuesChanged = true;
+    }
+    if (pinsChanged) BuildPattern(ps);
+    if (pinsChanged || valuesChanged)
+    {
+        FillMatrix(ps, springConst, h);
+        factored = ldlt.Factorize(A);
+        factoredK = springConst;
+        factoredH = h;
+        factoredInvMass = ps.invMass;
+        numFactorizations++;
+    }
+
+    // Spring damping is not part of the projective energy, so it is added as an explicit force.
+    for (auto& group : groups)
+    {
+        ComputeSpringForces(ps, *group.springs, 0.0f, dampingConst);
+    }
+
+    // Inertial target s = x + h v + h^2 M^-1 f for free particles. Pinned particles stay where they are.
+    for (int i = 0; i < numParticles; i++)
+    {
+        glm::vec3 x = ps.GetPosition(i);
+        prevPos[i] = x;
+        float w = ps.invMass[i];
+        if (w == 0.0f)
+        {
+            inertia[i] = x;
+            continue;
+        }
+        glm::vec3 a(ps.fx[i] * w, ps.fy[i] * w - gravityAcce, ps.fz[i] * w);
+        inertia[i] = x + h * ps.GetVelocity(i) + h * h * a;
+        ps.SetPosition(i, inertia[i]);
+    }
+    ps.ResetForces();
+
+    // A singular matrix leaves the particles on their inertial path.
+    for (int it = 0; factored && it < iterations; it++)
+    {
+        // Local step: project every spring onto its rest length, independently per spring.
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            const std::vector<SpringDamper>& springs = *groups[g].springs;
+            std::vector<glm::vec3>& proj = projections[g];
+            ThreadPool::Shared().ParallelFor((int)springs.size(), std::min(numThreads, (int)springs.size() / PD_GRAIN), [&](int begin, int end)
+                {
+                    for (int s = begin; s < end; s++)
+                    {
+                        glm::vec3 d = ps.GetPosition(springs[s].i) - ps.GetPosition(springs[s].j);
+                        float len = glm::length(d);
+                        proj[s] = len > EPSILON ? d * (springs[s].restLength / len) : glm::vec3(0.0f);
+                    }
+                });
+        }
+
+        // Global step right-hand side: M / h^2 s + k sum(A^T p), with pinned neighbors moved to the right.
+        for (int r = 0; r < A.n; r++)
+        {
+            int i = freeParticles[r];
+            double m = 1.0 / (ps.invMass[i] * h * h);
+            for (int d = 0; d < 3; d++)
+            {
+                rhs[d][r] = m * inertia[i][d];
+            }
+        }
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            const std::vector<SpringDamper>& springs = *groups[g].springs;
+            for (size_t s = 0; s < springs.size(); s++)
+            {
+                int ri = freeRow[springs[s].i], rj = freeRow[springs[s].j];
+                glm::vec3 p = springConst * projections[g][s];
+                glm::vec3 xi = springConst * ps.GetPosition(springs[s].i);
+                glm::vec3 xj = springConst * ps.GetPosition(springs[s].j);
+                for (int d = 0; d < 3; d++)
+                {
+                    if (ri >= 0) rhs[d][ri] += p[d] + (rj < 0 ? xj[d] : 0.0f);
+                    if (rj >= 0) rhs[d][rj] += -p[d] + (ri < 0 ? xi[d] : 0.0f);
+                }
+            }
+        }
+
+        // Global step: the three coordinates are independent solves with the same factor.
+        ThreadPool::Shared().ParallelFor(3, numThreads, [&](int begin, int end)
+            {
+                for (int d = begin; d < end; d++)
+                {
+                    ldlt.Solve(rhs[d], work[d]);
+                }
+            });
+
+        for (int r = 0; r < A.n; r++)
+        {
+            ps.SetPosition(freeParticles[r], glm::vec3(rhs[0][r], rhs[1][r], rhs[2][r]));
+        }
+    }
+
+    // Ground collision, then velocities from the position change.
+    const float floorY = groundPos + (float)EPSILON;
+    for (int r = 0; r < A.n; r++)
+    {
+        int i = freeParticles[r];
+        bool below = ps.py[i] < floorY;
+        if (below) ps.py[i] = floorY;
+
+        ps.vx[i] = (ps.px[i] - prevPos[i].x) / h;
+        ps.vy[i] = below ? 0.0f : (ps.py[i] - prevPos[i].y) / h;
+        ps.vz[i] = (ps.pz[i] - prevPos[i].z) / h;
+    }
+}
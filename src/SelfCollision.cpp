@@ -0,0 +1,497 @@
+#include "SelfCollision.h"
+
+#include "MeshBVH.h"
+#include "ThreadPool.h"
+
+// Minimum number of particles, edges or buckets per task.
+#define COLLISION_GRAIN 1024
+
+// Elements or pairs per chunk, chunks are gathered in order so the pair and contact order is fixed.
+#define CONTACT_CHUNK 4096
+
+// An element whose box covers more cells than this is stretched far beyond its rest length and is skipped.
+#define COLLISION_MAX_CELLS 512
+
+// HashCell: Bucket of a cell, numBuckets is a power of two.
+static inline int HashCell(const glm::ivec3& c, int numBuckets)
+{
+    uint32_t h = (uint32_t)c.x * 73856093u ^ (uint32_t)c.y * 19349663u ^ (uint32_t)c.z * 83492791u;
+    return (int)(h & (uint32_t)(numBuckets - 1));
+}
+
+// CellOf: Cell of a point in a grid of cells of the given size. Points of a blown up cloth are clamped so the cell fits an int.
+static inline glm::ivec3 CellOf(const glm::vec3& p, float invCellSize)
+{
+    return glm::ivec3(glm::clamp(glm::floor(p * invCellSize), glm::vec3(-1.0e9f), glm::vec3(1.0e9f)));
+}
+
+// ClosestOnSegments: Parameters s, t of the closest points p1 + s (q1 - p1) and p2 + t (q2 - p2) of two segments
+// (Ericson, Real-Time Collision Detection 5.1.9).
+static void ClosestOnSegments(const glm::vec3& p1, const glm::vec3& q1, const glm::vec3& p2, const glm::vec3& q2, float& s, float& t)
+{
+    glm::vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+    float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+    if (a <= EPSILON && e <= EPSILON)
+    {
+        s = t = 0.0f;
+        return;
+    }
+    if (a <= EPSILON)
+    {
+        s = 0.0f;
+        t = glm::clamp(f / e, 0.0f, 1.0f);
+        return;
+    }
+
+    float c = glm::dot(d1, r);
+    if (e <= EPSILON)
+    {
+        t = 0.0f;
+        s = glm::clamp(-c / a, 0.0f, 1.0f);
+        return;
+    }
+
+    float b = glm::dot(d1, d2);
+    float denom = a * e - b * b;
+    s = denom > EPSILON ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+    t = (b * s + f) / e;
+    if (t < 0.0f)
+    {
+        t = 0.0f;
+        s = glm::clamp(-c / a, 0.0f, 1.0f);
+    }
+    else if (t > 1.0f)
+    {
+        t = 1.0f;
+        s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+    }
+}
+
+// CellLess: Lexicographic order of cells.
+static inline bool CellLess(const glm::ivec3& a, const glm::ivec3& b)
+{
+    return a.z != b.z ? a.z < b.z : (a.y != b.y ? a.y < b.y : a.x < b.x);
+}
+
+// CellRange: Cells overlapped by the box [lo, hi], false if there are too many of them or the box is not finite.
+static inline bool CellRange(const glm::vec3& lo, const glm::vec3& hi, float invCellSize, glm::ivec3& cmin, glm::ivec3& cmax)
+{
+    glm::vec3 extent = glm::floor(hi * invCellSize) - glm::floor(lo * invCellSize) + 1.0f;
+    if (!(extent.x * extent.y * extent.z <= COLLISION_MAX_CELLS)) return false;
+    cmin = CellOf(lo, invCellSize);
+    cmax = CellOf(hi, invCellSize);
+    return true;
+}
+
+// Build: Copies the triangles, collects their edges in order of their lower end and sizes both hashes. The mean
+// edge length comes from the current positions.
+void SelfCollision::Build(const ParticleSystem& ps, const std::vector<glm::ivec3>& triangles)
+{
+    numParticles = ps.Size();
+    tris = triangles;
+    edges.clear();
+    for (const glm::ivec3& t : triangles)
+    {
+        for (int k = 0; k < 3; k++) edges.push_back(glm::ivec2(std::min(t[k], t[(k + 1) % 3]), std::max(t[k], t[(k + 1) % 3])));
+    }
+    std::sort(edges.begin(), edges.end(), [](const glm::ivec2& a, const glm::ivec2& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    meanEdgeLength = 0.0f;
+    for (const glm::ivec2& e : edges) meanEdgeLength += glm::length(ps.GetPosition(e.y) - ps.GetPosition(e.x));
+    if (!edges.empty()) meanEdgeLength /= edges.size();
+
+    // An edge overlaps one or two cells.
+    ResizeHash(particleHash, numParticles);
+    ResizeHash(edgeHash, 2 * (int)edges.size());
+    stale = true;
+}
+
+// ResizeHash: Sets up a power of two number of buckets, at least half the expected entries. Cells hold a few
+// entries each, so there are still more buckets than occupied cells and the arrays stay small.
+void SelfCollision::ResizeHash(Hash& hash, int expectedEntries)
+{
+    int buckets = 16;
+    while (2 * buckets < expectedEntries) buckets *= 2;
+    if (buckets != hash.numBuckets)
+    {
+        hash.numBuckets = buckets;
+        hash.counts.reset(new std::atomic<int>[buckets]);
+        for (int b = 0; b < buckets; b++) hash.counts[b].store(0, std::memory_order_relaxed);
+    }
+    hash.bucketStart.assign(hash.numBuckets + 1, 0);
+}
+
+// FillHash: Counting sort of count items into the buckets of every cell of their range, cellRange(i, cmin, cmax)
+// returns false for items left out. Counting and scattering run in parallel with atomic counters, then every
+// bucket is sorted by item so the layout does not depend on the threads.
+template <typename F>
+void SelfCollision::FillHash(Hash& hash, int count, F cellRange, int numThreads)
+{
+    ThreadPool& pool = ThreadPool::Shared();
+    const int numBuckets = hash.numBuckets;
+    int tasks = std::min(numThreads, count / COLLISION_GRAIN);
+
+    pool.ParallelFor(count, tasks, [&](int begin, int end)
+        {
+            glm::ivec3 cmin, cmax, c;
+            for (int i = begin; i < end; i++)
+            {
+                if (!cellRange(i, cmin, cmax)) continue;
+                for (c.z = cmin.z; c.z <= cmax.z; c.z++)
+                    for (c.y = cmin.y; c.y <= cmax.y; c.y++)
+                        for (c.x = cmin.x; c.x <= cmax.x; c.x++) hash.counts[HashCell(c, numBuckets)].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+
+    // Exclusive prefix sum, the counters become the write cursors of their buckets.
+    int sum = 0;
+    for (int b = 0; b < numBuckets; b++)
+    {
+        int n = hash.counts[b].load(std::memory_order_relaxed);
+        hash.bucketStart[b] = sum;
+        hash.counts[b].store(sum, std::memory_order_relaxed);
+        sum += n;
+    }
+    hash.bucketStart[numBuckets] = sum;
+    hash.entries.resize(sum);
+
+    pool.ParallelFor(count, tasks, [&](int begin, int end)
+        {
+            glm::ivec3 cmin, cmax, c;
+            for (int i = begin; i < end; i++)
+            {
+                if (!cellRange(i, cmin, cmax)) continue;
+                for (c.z = cmin.z; c.z <= cmax.z; c.z++)
+                    for (c.y = cmin.y; c.y <= cmax.y; c.y++)
+                        for (c.x = cmin.x; c.x <= cmax.x; c.x++)
+                            hash.entries[hash.counts[HashCell(c, numBuckets)].fetch_add(1, std::memory_order_relaxed)] = { i, c };
+            }
+        });
+
+    // Buckets hold a few entries, the counters are cleared for the next build on the way. A serial scatter already
+    // leaves every bucket in item order.
+    pool.ParallelFor(numBuckets, std::min(numThreads, numBuckets / COLLISION_GRAIN), [&](int begin, int end)
+        {
+            for (int b = begin; b < end; b++)
+            {
+                if (tasks > 1 && hash.bucketStart[b + 1] - hash.bucketStart[b] > 1)
+                {
+                    std::sort(hash.entries.begin() + hash.bucketStart[b], hash.entries.begin() + hash.bucketStart[b + 1],
+                        [](const HashEntry& x, const HashEntry& y) { return x.item < y.item || (x.item == y.item && CellLess(x.cell, y.cell)); });
+                }
+                hash.counts[b].store(0, std::memory_order_relaxed);
+            }
+        });
+}
+
+// ForEntriesInCells: Calls f(item, cell) for every entry of the hash in a cell of [cmin, cmax].
+template <typename F>
+inline void SelfCollision::ForEntriesInCells(const Hash& hash, const glm::ivec3& cmin, const glm::ivec3& cmax, F f) const
+{
+    glm::ivec3 c;
+    for (c.z = cmin.z; c.z <= cmax.z; c.z++)
+    {
+        for (c.y = cmin.y; c.y <= cmax.y; c.y++)
+        {
+            for (c.x = cmin.x; c.x <= cmax.x; c.x++)
+            {
+                int b = HashCell(c, hash.numBuckets);
+                for (int k = hash.bucketStart[b]; k < hash.bucketStart[b + 1]; k++)
+                {
+                    // Other cells can share the bucket.
+                    if (hash.entries[k].cell == c) f(hash.entries[k].item, c);
+                }
+            }
+        }
+    }
+}
+
+// TriangleDistance: Closest point weights and offset from triangle t to particle i.
+static inline float TriangleDistance(const ParticleSystem& ps, int i, const glm::ivec3& tri, glm::vec3& bary, glm::vec3& d)
+{
+    glm::vec3 a = ps.GetPosition(tri.x), b = ps.GetPosition(tri.y), c = ps.GetPosition(tri.z);
+    bary = ClosestOnTriangle(ps.GetPosition(i), a, b, c);
+    d = ps.GetPosition(i) - (bary.x * a + bary.y * b + bary.z * c);
+    return glm::dot(d, d);
+}
+
+// EdgeDistance: Closest point parameters and offset between edges e and g.
+static inline float EdgeDistance(const ParticleSystem& ps, const glm::ivec2& e, const glm::ivec2& g, float& s, float& t, glm::vec3& d)
+{
+    glm::vec3 a = ps.GetPosition(e.x), b = ps.GetPosition(e.y), c = ps.GetPosition(g.x), q = ps.GetPosition(g.y);
+    ClosestOnSegments(a, b, c, q, s, t);
+    d = (a + s * (b - a)) - (c + t * (q - c));
+    return glm::dot(d, d);
+}
+
+// FindTrianglePairs: Particles closer than radius to triangles [begin, end), other than their corners, as (particle, triangle).
+void SelfCollision::FindTrianglePairs(const ParticleSystem& ps, int begin, int end, float radius, std::vector<glm::ivec2>& out) const
+{
+    const float invCellSize = 1.0f / cellSize;
+    for (int t = begin; t < end; t++)
+    {
+        const glm::ivec3 tri = tris[t];
+        glm::vec3 a = ps.GetPosition(tri.x), b = ps.GetPosition(tri.y), c = ps.GetPosition(tri.z);
+        glm::vec3 lo = glm::min(a, glm::min(b, c)) - radius;
+        glm::vec3 hi = glm::max(a, glm::max(b, c)) + radius;
+        glm::ivec3 cmin, cmax;
+        if (!CellRange(lo, hi, invCellSize, cmin, cmax)) continue;
+
+        ForEntriesInCells(particleHash, cmin, cmax, [&](int i, const glm::ivec3&)
+            {
+                if (i == tri.x || i == tri.y || i == tri.z) return;
+                glm::vec3 p = ps.GetPosition(i);
+                if (glm::any(glm::lessThan(p, lo)) || glm::any(glm::greaterThan(p, hi))) return;
+
+                glm::vec3 bary, d;
+                if (TriangleDistance(ps, i, tri, bary, d) < radius * radius) out.push_back(glm::ivec2(i, t));
+            });
+    }
+}
+
+// FindEdgePairs: Edges closer than radius to edges [begin, end) with a higher index and no shared end, as (edge, edge).
+// Edges sit in every cell their box overlaps, a pair is reported in the first cell both ranges share.
+void SelfCollision::FindEdgePairs(const ParticleSystem& ps, int begin, int end, float radius, std::vector<glm::ivec2>& out) const
+{
+    const float invCellSize = 1.0f / cellSize;
+    for (int k = begin; k < end; k++)
+    {
+        const glm::ivec2 e = edges[k];
+        glm::vec3 a = ps.GetPosition(e.x), b = ps.GetPosition(e.y);
+        glm::vec3 lo = glm::min(a, b) - radius, hi = glm::max(a, b) + radius;
+        glm::ivec3 cmin, cmax;
+        if (!CellRange(lo, hi, invCellSize, cmin, cmax)) continue;
+
+        ForEntriesInCells(edgeHash, cmin, cmax, [&](int f, const glm::ivec3& cell)
+            {
+                if (f <= k) return;
+                const glm::ivec2 g = edges[f];
+                if (g.x == e.x || g.x == e.y || g.y == e.x || g.y == e.y) return;
+
+                glm::vec3 c = ps.GetPosition(g.x), d = ps.GetPosition(g.y);
+                glm::vec3 glo = glm::min(c, d), ghi = glm::max(c, d);
+                if (glm::any(glm::lessThan(ghi, lo)) || glm::any(glm::greaterThan(glo, hi))) return;
+                if (cell != glm::max(cmin, CellOf(glo, invCellSize))) return;
+
+                float s1, t1;
+                glm::vec3 delta;
+                if (EdgeDistance(ps, e, g, s1, t1, delta) < radius * radius) out.push_back(glm::ivec2(k, f));
+            });
+    }
+}
+
+// TriangleContact: Contact of a (particle, triangle) pair if the particle is closer than the thickness.
+bool SelfCollision::TriangleContact(const ParticleSystem& ps, const glm::ivec2& pair, Contact& contact) const
+{
+    const int i = pair.x;
+    const glm::ivec3 tri = tris[pair.y];
+    glm::vec3 bary, d;
+    float dist2 = TriangleDistance(ps, i, tri, bary, d);
+    if (dist2 >= thickness * thickness) return false;
+
+    float dist = sqrtf(dist2);
+    glm::vec3 normal = d / dist;
+    if (dist <= EPSILON)
+    {
+        // A particle on the triangle is pushed back to the side of the face normal it came from.
+        glm::vec3 a = ps.GetPosition(tri.x);
+        normal = glm::cross(ps.GetPosition(tri.y) - a, ps.GetPosition(tri.z) - a);
+        float len = glm::length(normal);
+        if (len <= EPSILON) return false;
+        normal /= len;
+        glm::vec3 v = ps.GetVelocity(i) - (bary.x * ps.GetVelocity(tri.x) + bary.y * ps.GetVelocity(tri.y) + bary.z * ps.GetVelocity(tri.z));
+        if (glm::dot(v, normal) > 0.0f) normal = -normal;
+    }
+    contact = { { i, tri.x, tri.y, tri.z }, { 1.0f, -bary.x, -bary.y, -bary.z }, normal };
+    return true;
+}
+
+// EdgeContact: Contact of an (edge, edge) pair if the edges are closer than the thickness.
+bool SelfCollision::EdgeContact(const ParticleSystem& ps, const glm::ivec2& pair, Contact& contact) const
+{
+    const glm::ivec2 e = edges[pair.x], g = edges[pair.y];
+    float s, t;
+    glm::vec3 d;
+    float dist2 = EdgeDistance(ps, e, g, s, t, d);
+    if (dist2 >= thickness * thickness) return false;
+
+    float dist = sqrtf(dist2);
+    glm::vec3 normal = d / dist;
+    if (dist <= EPSILON)
+    {
+        // Crossing edges, separate along their common normal.
+        normal = glm::cross(ps.GetPosition(e.y) - ps.GetPosition(e.x), ps.GetPosition(g.y) - ps.GetPosition(g.x));
+        float len = glm::length(normal);
+        if (len <= EPSILON) return false;
+        normal /= len;
+    }
+    contact = { { e.x, e.y, g.x, g.y }, { 1.0f - s, s, -(1.0f - t), -t }, normal };
+    return true;
+}
+
+// Resolve: Projects one contact back to the thickness and removes its approaching velocity, with Coulomb friction
+// on the sliding velocity. Every particle moves by its inverse mass times its weight, like a distance constraint.
+void SelfCollision::Resolve(ParticleSystem& ps, const Contact& c, float deltaT, const SleepTracker* sleep)
+{
+    float invMass[4];
+    float weightSum = 0.0f;
+    glm::vec3 x(0.0f), v(0.0f);
+    for (int k = 0; k < 4; k++)
+    {
+        int i = c.p[k];
+        invMass[k] = ps.invMass[i];
+        if (sleep != nullptr && invMass[k] != 0.0f && !sleep->IsAwake(i))
+        {
+            // Sleeping particles hold still for the rest of the step.
+            wakeList.push_back(i);
+            invMass[k] = 0.0f;
+        }
+        weightSum += invMass[k] * c.w[k] * c.w[k];
+        x += c.w[k] * ps.GetPosition(i);
+        v += c.w[k] * ps.GetVelocity(i);
+    }
+    if (weightSum <= 0.0f) return;
+
+    // Earlier contacts may already have separated this one.
+    float depth = thickness - glm::dot(x, c.normal);
+    if (depth <= 0.0f) return;
+
+    float vn = glm::dot(v, c.normal);
+    glm::vec3 vt = v - vn * c.normal;
+    float normalSpeed = std::max(-vn, depth / deltaT);
+    float vtLength = glm::length(vt);
+    glm::vec3 dv = std::max(-vn, 0.0f) * c.normal;
+    if (vtLength > EPSILON) dv -= std::min(vtLength, friction * normalSpeed) / vtLength * vt;
+
+    for (int k = 0; k < 4; k++)
+    {
+        if (invMass[k] == 0.0f) continue;
+        int i = c.p[k];
+        float share = invMass[k] * c.w[k] / weightSum;
+        ps.SetPosition(i, ps.GetPosition(i) + share * depth * c.normal);
+        ps.vx[i] += share * dv.x;
+        ps.vy[i] += share * dv.y;
+        ps.vz[i] += share * dv.z;
+    }
+}
+
+// MaxDisplacement2: Largest squared distance a particle moved since the pairs were built.
+float SelfCollision::MaxDisplacement2(const ParticleSystem& ps, int numThreads)
+{
+    const int n = ps.Size();
+    const int numChunks = (n + COLLISION_GRAIN - 1) / COLLISION_GRAIN;
+    chunkMax.assign(numChunks, 0.0f);
+    ThreadPool::Shared().ParallelFor(numChunks, numThreads, [&](int begin, int end)
+        {
+            for (int chunk = begin; chunk < end; chunk++)
+            {
+                float m = 0.0f;
+                for (int i = chunk * COLLISION_GRAIN; i < std::min(n, (chunk + 1) * COLLISION_GRAIN); i++)
+                {
+                    glm::vec3 d = ps.GetPosition(i) - buildPositions[i];
+                    m = std::max(m, glm::dot(d, d));
+                }
+                chunkMax[chunk] = m;
+            }
+        });
+    return chunkMax.empty() ? 0.0f : *std::max_element(chunkMax.begin(), chunkMax.end());
+}
+
+// BuildPairs: Rehashes the particles and edges and collects every particle-triangle and edge-edge pair closer than
+// the thickness plus the skin, in parallel chunks gathered in order.
+void SelfCollision::BuildPairs(const ParticleSystem& ps, int numThreads)
+{
+    const float radius = thickness + skin;
+
+    // Cells two edges long keep every query to a few cells, more and smaller cells cost more hash lookups than
+    // they save in distance tests.
+    cellSize = std::max(2.0f * meanEdgeLength, 2.0f * radius);
+    const float invCellSize = 1.0f / cellSize;
+    FillHash(particleHash, numParticles, [&](int i, glm::ivec3& cmin, glm::ivec3& cmax)
+        {
+            cmin = cmax = CellOf(ps.GetPosition(i), invCellSize);
+            return true;
+        }, numThreads);
+    FillHash(edgeHash, (int)edges.size(), [&](int k, glm::ivec3& cmin, glm::ivec3& cmax)
+        {
+            glm::vec3 a = ps.GetPosition(edges[k].x), b = ps.GetPosition(edges[k].y);
+            return CellRange(glm::min(a, b), glm::max(a, b), invCellSize, cmin, cmax);
+        }, numThreads);
+
+    int numTriangleChunks = ((int)tris.size() + CONTACT_CHUNK - 1) / CONTACT_CHUNK;
+    int numEdgeChunks = ((int)edges.size() + CONTACT_CHUNK - 1) / CONTACT_CHUNK;
+    int numChunks = numTriangleChunks + numEdgeChunks;
+    chunkPairs.resize(numChunks);
+    ThreadPool::Shared().ParallelFor(numChunks, numThreads, [&](int begin, int end)
+        {
+            for (int chunk = begin; chunk < end; chunk++)
+            {
+                std::vector<glm::ivec2>& out = chunkPairs[chunk];
+                out.clear();
+                if (chunk < numTriangleChunks)
+                {
+                    int first = chunk * CONTACT_CHUNK;
+                    FindTrianglePairs(ps, first, std::min((int)tris.size(), first + CONTACT_CHUNK), radius, out);
+                }
+                else
+                {
+                    int first = (chunk - numTriangleChunks) * CONTACT_CHUNK;
+                    FindEdgePairs(ps, first, std::min((int)edges.size(), first + CONTACT_CHUNK), radius, out);
+                }
+            }
+        });
+
+    trianglePairs.clear();
+    edgePairs.clear();
+    for (int chunk = 0; chunk < numChunks; chunk++)
+    {
+        std::vector<glm::ivec2>& pairs = chunk < numTriangleChunks ? trianglePairs : edgePairs;
+        pairs.insert(pairs.end(), chunkPairs[chunk].begin(), chunkPairs[chunk].end());
+    }
+
+    buildPositions.resize(numParticles);
+    for (int i = 0; i < numParticles; i++) buildPositions[i] = ps.GetPosition(i);
+    stale = false;
+    numBuilds++;
+}
+
+// Solve: Rebuilds the pairs once a particle moved half the skin, then tests the pairs in parallel chunks and
+// resolves the contacts in order.
+void SelfCollision::Solve(ParticleSystem& ps, float deltaT, const SleepTracker* sleep, int numThreads)
+{
+    lastContacts = 0;
+    if (!enabled || thickness <= 0.0f || tris.empty() || ps.Size() != numParticles) return;
+
+    // A pair closer than the thickness now was closer than the thickness plus the skin when the pairs were built,
+    // as long as no particle has moved more than half the skin since.
+    if (stale || MaxDisplacement2(ps, numThreads) > 0.25f * skin * skin) BuildPairs(ps, numThreads);
+
+    int numTriangleChunks = ((int)trianglePairs.size() + CONTACT_CHUNK - 1) / CONTACT_CHUNK;
+    int numEdgeChunks = ((int)edgePairs.size() + CONTACT_CHUNK - 1) / CONTACT_CHUNK;
+    int numChunks = numTriangleChunks + numEdgeChunks;
+    chunkContacts.resize(numChunks);
+    ThreadPool::Shared().ParallelFor(numChunks, numThreads, [&](int begin, int end)
+        {
+            for (int chunk = begin; chunk < end; chunk++)
+            {
+                std::vector<Contact>& out = chunkContacts[chunk];
+                out.clear();
+                bool triangles = chunk < numTriangleChunks;
+                const std::vector<glm::ivec2>& pairs = triangles ? trianglePairs : edgePairs;
+                int first = (triangles ? chunk : chunk - numTriangleChunks) * CONTACT_CHUNK;
+                Contact contact;
+                for (int k = first; k < std::min((int)pairs.size(), first + CONTACT_CHUNK); k++)
+                {
+                    if (triangles ? TriangleContact(ps, pairs[k], contact) : EdgeContact(ps, pairs[k], contact)) out.push_back(contact);
+                }
+            }
+        });
+
+    bool anySleeping = sleep != nullptr && sleep->AnySleeping();
+    for (const std::vector<Contact>& contacts : chunkContacts)
+    {
+        for (const Contact& c : contacts) Resolve(ps, c, deltaT, anySleeping ? sleep : nullptr);
+        lastContacts += (int)contacts.size();
+    }
+}
@@ -0,0 +1,50 @@
+#include "SimulationClock.h"
+
+#include <algorithm>
+
+// Constructor: Sets the fixed step and the number of steps a single frame may take at most.
+SimulationClock::SimulationClock(double _fixedDt, int _maxStepsPerFrame)
+{
+    fixedDt = _fixedDt;
+    maxStepsPerFrame = _maxStepsPerFrame;
+}
+
+// BeginFrame: Measures the wall time since the previous frame with a monotonic clock.
+void SimulationClock::BeginFrame()
+{
+    auto currT = std::chrono::steady_clock::now();
+    double frameTime = started ? std::chrono::duration<double>(currT - prevT).count() : 0.0;
+    prevT = currT;
+    started = true;
+
+    // Update the FPS counter once every second.
+    fpsCount++;
+    fpsInterval += frameTime;
+    if (fpsInterval >= 1.0)
+    {
+        fps = fpsCount;
+        fpsInterval = 0.0;
+        fpsCount = 0;
+    }
+
+    BeginFrame(frameTime);
+}
+
+// BeginFrame: Adds the frame time to the accumulator and converts it into whole fixed steps.
+void SimulationClock::BeginFrame(double frameTime)
+{
+    accumulator += frameTime;
+    steps = (int)(accumulator / fixedDt);
+
+    // A frame that took too long drops the excess time instead of making the next frame even slower.
+    if (steps > maxStepsPerFrame)
+    {
+        steps = maxStepsPerFrame;
+        accumulator = 0.0;
+    }
+    else
+    {
+        accumulator -= steps * fixedDt;
+    }
+    totalSteps += steps;
+}
@@ -1,4 +1,5 @@
 #include "Skeleton.h"
+#include "Profiler.h"
 
 // Constructor: Initializes the skeleton and loads its data from the specified file.
 /* Skeleton::Skeleton(std::string _fileName, const glm::mat4& _toWorld)
@@ -9,11 +10,10 @@
 }
 */
 
-Skeleton::Skeleton(std::string _fileName, GLuint _shaderID)
+Skeleton::Skeleton(std::string _fileName)
 {
 	fileName = _fileName;
 	toWorld = glm::mat4(1.0f);
-	shaderID = _shaderID;
 	load();
 }
 
@@ -52,21 +52,12 @@ void Skeleton::load()
 // Updates the skeleton's transformation matrix and propagates the update through the joint hierarchy.
 void Skeleton::update(const glm::mat4& input_toWorld)
 {
+	ScopedTimer timer(PROFILE_FK);
+
 	toWorld = input_toWorld;
 	jointRoot->update(toWorld);
 }
 
-// Draws the skeleton (starting from the root joint) using the provided view projection matrix and shader.
-/* 
-void Skeleton::draw(const glm::mat4& viewProjMtx, GLuint shader)
-{
-	jointRoot->draw(viewProjMtx * toWorld, shader);
-}
-*/
-void Skeleton::draw(const glm::mat4& viewProjMtx)
-{
-	jointRoot->draw(viewProjMtx * toWorld, shaderID);
-}
 
 
 // Project2
@@ -91,7 +82,8 @@ void Skeleton::getJointRot(int jointNum, glm::vec3& rot)
 
 void Skeleton::setJointRot(int jointNum, glm::vec3& rot)
 {
-	joints[jointNum]->setRot(glm::vec3(rot[0], rot[1], rot[2]));
+	glm::vec3 newRot(rot[0], rot[1], rot[2]);
+	joints[jointNum]->setRot(newRot);
 }
 
 void Skeleton::getJointRotMin(int jointNum, glm::vec3& rotMin)
@@ -0,0 +1,33 @@
+#include "SkeletonRenderer.h"
+
+// Constructor: Creates a box for every joint from its boxmin and boxmax.
+SkeletonRenderer::SkeletonRenderer(Skeleton* _skel, GLuint _shaderID)
+{
+	skel = _skel;
+	shaderID = _shaderID;
+
+	for (size_t i = 0; i < skel->getNumOfJoint(); i++)
+	{
+		BallJoint* joint = skel->getJoint((int)i);
+		cubes.push_back(new Cube(joint->getBoxMin(), joint->getBoxMax()));
+	}
+}
+
+// Destructor: Deletes the joint boxes.
+SkeletonRenderer::~SkeletonRenderer()
+{
+	for (Cube* cube : cubes)
+	{
+		delete cube;
+	}
+}
+
+// Draws every joint's box at its world transformation.
+void SkeletonRenderer::draw(const glm::mat4& viewProjMtx)
+{
+	glm::mat4 viewProjWorld = viewProjMtx * skel->getToWorld();
+	for (size_t i = 0; i < cubes.size(); i++)
+	{
+		cubes[i]->draw(viewProjWorld * skel->getWorldMat((int)i), shaderID);
+	}
+}
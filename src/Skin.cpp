@@ -1,76 +1,23 @@
 #include "Skin.h"
+#include "Profiler.h"
 
 
-Skin::Skin(std::string _fileName, Skeleton* _skel, GLint _programID)
+Skin::Skin(std::string _fileName, Skeleton* _skel)
 { 
 	fileName = _fileName;
 	skel = _skel;
-	shaderID = _programID;
+	gatherNormals = false;
 
 	load();
 	checkNormals();
 	invBindingMat();
 
-	// check cube.cpp from line 97
-
-	// Generate a vertex array (VAO), vertex buffer objects (VBO) and EBO.
-	glGenVertexArrays(1, &vao);
-	glGenBuffers(2, vbos);
-	glGenBuffers(1, &ebo);
-
-	// Bind to the VAO.
-	glBindVertexArray(vao);
-
-	// 1st VBO, positions
-	//a. Bind buffer to VAO
-	glBindBuffer(GL_ARRAY_BUFFER, vbos[0]);
-	//b. Pass in the position data.
-	glBufferData(GL_ARRAY_BUFFER, 
-		sizeof(glm::vec3) * currPositions.size(), 
-		//currPositions.data(), 
-		nullptr,
-		GL_STREAM_DRAW);
-	// c. Enable vertex attribute 0. Create channel
-	// We will be able to access vertices through it.
-	glEnableVertexAttribArray(0);
-	//d. How to read VBO
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
-
-	//2nd VBO, normals
-	//a. Bind buffer to VAO
-	glBindBuffer(GL_ARRAY_BUFFER, vbos[1]);
-	//b. Pass in the data.
-	glBufferData(GL_ARRAY_BUFFER, 
-		sizeof(glm::vec3) * currNormals.size(), 
-		//currNormals.data(), 
-		nullptr,
-		GL_STREAM_DRAW);
-	// c. Enable vertex attribute 0. Create channel
-	// We will be able to access vertices through it.
-	glEnableVertexAttribArray(1);
-	//d. How to read VBO
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
-
-	//vertex index
-	//a. Bind to the EBO. We will use it to store the indices.
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	//b. Pass in the data.
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 
-		sizeof(glm::ivec3) * triangles.size(), 
-		triangles.data(), 
-		GL_STATIC_DRAW);
-
-	// Unbind from the VBO.
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	// Unbind from the VAO.
-	glBindVertexArray(0);
+	adjacency.Build((int)positions.size(), triangles);
+	faceNormals.resize(triangles.size());
 }
 
 Skin::~Skin()
 {
-	glDeleteBuffers(2, vbos);
-	glDeleteBuffers(1, &ebo);
-	glDeleteVertexArrays(1, &vao);
 }
 
 void Skin::load()
@@ -219,8 +166,8 @@ void Skin::update()
 {
 	if (skel == nullptr) return;
 
-	//Bind buffer to positions VBO
-	glBindBuffer(GL_ARRAY_BUFFER, vbos[0]);
+	ScopedTimer timer(PROFILE_SKIN);
+
 	for (size_t i = 0; i < positions.size(); i++)
 	{
 		glm::vec3 newPos(0.0f);
@@ -232,15 +179,16 @@ void Skin::update()
 				* glm::vec4(positions[i], 1.0f));
 		}
 		currPositions[i] = newPos;
-		glBufferSubData(GL_ARRAY_BUFFER, 
-			sizeof(glm::vec3) * i,
-			sizeof(glm::vec3),
-			&newPos);
 	}
 
+	// Gathering the face normals of the deformed mesh skips the inverse-transpose per joint weight.
+	if (gatherNormals)
+	{
+		ComputeFaceNormals(currPositions.data(), triangles.data(), faceNormals.data(), 0, (int)triangles.size());
+		GatherVertexNormals(adjacency, faceNormals.data(), currNormals.data(), 0, (int)currPositions.size());
+		return;
+	}
 
-	//Bind buffer to normals VBO
-	glBindBuffer(GL_ARRAY_BUFFER, vbos[1]);
 	for (size_t i = 0; i < normals.size(); i++)
 	{
 		glm::vec3 newNorm(0.0f);
@@ -252,38 +200,5 @@ void Skin::update()
 				* glm::vec4(normals[i], 0.0f));
 		}
 		currNormals[i] = glm::normalize(newNorm);
-		glBufferSubData(GL_ARRAY_BUFFER,
-			sizeof(glm::vec3) * i,
-			sizeof(glm::vec3),
-			&newNorm);
 	}
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
-
-// See Cube::draw
-void Skin::draw(const glm::mat4& viewProjMtx)
-{
-	glUseProgram(shaderID);
-
-	glm::mat4 model(1.0);
-	// Color of the skin!!!!
-	glm::vec3 color(1.00f, 0.75f, 0.0f);
-	// Blood Orange glm::vec3 color(0.83f, 0.00f, 0.15f);
-	
-
-	// get the locations and send the uniforms to the shader 
-	glUniformMatrix4fv(glGetUniformLocation(shaderID, "viewProj"), 1, false, (float*)&viewProjMtx);
-	glUniformMatrix4fv(glGetUniformLocation(shaderID, "model"), 1, GL_FALSE, (float*)&model);
-	glUniform3fv(glGetUniformLocation(shaderID, "DiffuseColor"), 1, &color[0]);
-
-	// Bind to the VAO.
-	glBindVertexArray(vao);
-
-	// draw the points using triangles, indexed with the EBO
-	glDrawElements(GL_TRIANGLES, triangles.size() * 3, GL_UNSIGNED_INT, 0); // mode, count, type, indices
-																			
-	// Unbind from the VAO and shader program.
-	glBindVertexArray(0);
-	glUseProgram(0);
-}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "SkinRenderer.h"
+#include "Profiler.h"
+
+SkinRenderer::SkinRenderer(const Skin* _skin, GLuint _programID)
+{
+	skin = _skin;
+	shaderID = _programID;
+
+	const std::vector<glm::vec3>& positions = skin->getPositions();
+	const std::vector<glm::vec3>& normals = skin->getNormals();
+	const std::vector<glm::ivec3>& triangles = skin->getTriangles();
+
+	// check cube.cpp from line 97
+
+	// Generate a vertex array (VAO), vertex buffer objects (VBO) and EBO.
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(2, vbos);
+	glGenBuffers(1, &ebo);
+
+	// Bind to the VAO.
+	glBindVertexArray(vao);
+
+	// 1st VBO, positions
+	//a. Bind buffer to VAO
+	glBindBuffer(GL_ARRAY_BUFFER, vbos[0]);
+	//b. Pass in the position data.
+	glBufferData(GL_ARRAY_BUFFER, 
+		sizeof(glm::vec3) * positions.size(), 
+		positions.data(),
+		GL_STREAM_DRAW);
+	// c. Enable vertex attribute 0. Create channel
+	// We will be able to access vertices through it.
+	glEnableVertexAttribArray(0);
+	//d. How to read VBO
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+
+	//2nd VBO, normals
+	//a. Bind buffer to VAO
+	glBindBuffer(GL_ARRAY_BUFFER, vbos[1]);
+	//b. Pass in the data.
+	glBufferData(GL_ARRAY_BUFFER, 
+		sizeof(glm::vec3) * normals.size(), 
+		normals.data(),
+		GL_STREAM_DRAW);
+	// c. Enable vertex attribute 0. Create channel
+	// We will be able to access vertices through it.
+	glEnableVertexAttribArray(1);
+	//d. How to read VBO
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+
+	//vertex index
+	//a. Bind to the EBO. We will use it to store the indices.
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	//b. Pass in the data.
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 
+		sizeof(glm::ivec3) * triangles.size(), 
+		triangles.data(), 
+		GL_STATIC_DRAW);
+
+	// Unbind from the VBO.
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// Unbind from the VAO.
+	glBindVertexArray(0);
+}
+
+SkinRenderer::~SkinRenderer()
+{
+	glDeleteBuffers(2, vbos);
+	glDeleteBuffers(1, &ebo);
+	glDeleteVertexArrays(1, &vao);
+}
+
+// Uploads the skinned positions and normals, one call per buffer.
+void SkinRenderer::update()
+{
+	ScopedTimer timer(PROFILE_UPLOAD);
+
+	const std::vector<glm::vec3>& positions = skin->getPositions();
+	const std::vector<glm::vec3>& normals = skin->getNormals();
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbos[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec3) * positions.size(), positions.data());
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbos[1]);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec3) * normals.size(), normals.data());
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// See Cube::draw
+void SkinRenderer::draw(const glm::mat4& viewProjMtx)
+{
+	glUseProgram(shaderID);
+
+	glm::mat4 model(1.0);
+	// Color of the skin!!!!
+	glm::vec3 color(1.00f, 0.75f, 0.0f);
+	// Blood Orange glm::vec3 color(0.83f, 0.00f, 0.15f);
+	
+
+	// get the locations and send the uniforms to the shader 
+	glUniformMatrix4fv(glGetUniformLocation(shaderID, "viewProj"), 1, false, (float*)&viewProjMtx);
+	glUniformMatrix4fv(glGetUniformLocation(shaderID, "model"), 1, GL_FALSE, (float*)&model);
+	glUniform3fv(glGetUniformLocation(shaderID, "DiffuseColor"), 1, &color[0]);
+
+	// Bind to the VAO.
+	glBindVertexArray(vao);
+
+	// draw the points using triangles, indexed with the EBO
+	glDrawElements(GL_TRIANGLES, skin->getTriangles().size() * 3, GL_UNSIGNED_INT, 0); // mode, count, type, indices
+																			
+	// Unbind from the VAO and shader program.
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
@@ -0,0 +1,202 @@
+#include "SleepTracker.h"
+
+#include "ThreadPool.h"
+
+// Minimum number of tiles per task when the evaluation is split across threads.
+#define SLEEP_GRAIN 16
+
+// MergeSpans: Sorts particle runs and joins the ones that touch.
+static void MergeSpans(std::vector<ParticleSpan>& spans)
+{
+    std::sort(spans.begin(), spans.end(), [](const ParticleSpan& a, const ParticleSpan& b) { return a.begin < b.begin; });
+
+    size_t n = 0;
+    for (size_t i = 0; i < spans.size(); i++)
+    {
+        if (n > 0 && spans[n - 1].end == spans[i].begin) spans[n - 1].end = spans[i].end;
+        else spans[n++] = spans[i];
+    }
+    spans.resize(n);
+}
+
+// BuildGrid: Cuts the grid into tiles with one particle run per tile row, and links every tile to the up to
+// eight tiles around it.
+void SleepTracker::BuildGrid(int width, int height, int tileSize)
+{
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+
+    alwaysAwake = false;
+    tiles.clear();
+    spans.clear();
+    neighbors.clear();
+    particleTile.assign((size_t)width * height, 0);
+    for (int ty = 0; ty < tilesY; ty++)
+    {
+        for (int tx = 0; tx < tilesX; tx++)
+        {
+            Tile tile;
+            tile.spanBegin = (int)spans.size();
+            int x0 = tx * tileSize, x1 = std::min(width, x0 + tileSize);
+            for (int y = ty * tileSize; y < std::min(height, (ty + 1) * tileSize); y++)
+            {
+                spans.push_back({ x0 + y * width, x1 + y * width });
+                for (int x = x0; x < x1; x++) particleTile[x + y * width] = (int)tiles.size();
+            }
+            tile.spanEnd = (int)spans.size();
+
+            tile.neighborBegin = (int)neighbors.size();
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    int nx = tx + dx, ny = ty + dy;
+                    if ((dx != 0 || dy != 0) && nx >= 0 && nx < tilesX && ny >= 0 && ny < tilesY) neighbors.push_back(nx + ny * tilesX);
+                }
+            }
+            tile.neighborEnd = (int)neighbors.size();
+
+            tile.restSteps = 0;
+            tile.awake = true;
+            tile.moving = false;
+            tiles.push_back(tile);
+        }
+    }
+
+    numSleeping = 0;
+    RebuildSpans();
+}
+
+// SetAwake: Switches a tile between awake and asleep, a fresh tile starts its rest count over.
+void SleepTracker::SetAwake(int t, bool awake)
+{
+    tiles[t].restSteps = 0;
+    if (tiles[t].awake == awake) return;
+
+    tiles[t].awake = awake;
+    numSleeping += awake ? -1 : 1;
+    changed = true;
+}
+
+// RebuildSpans: Collects the awake tiles, their particle runs and the runs of the sleeping tiles bordering them.
+void SleepTracker::RebuildSpans()
+{
+    awakeTiles.clear();
+    awakeSpans.clear();
+    borderSpans.clear();
+    numAwakeParticles = 0;
+    for (int t = 0; t < (int)tiles.size(); t++)
+    {
+        const Tile& tile = tiles[t];
+        bool border = false;
+        if (!tile.awake)
+        {
+            for (int n = tile.neighborBegin; n < tile.neighborEnd; n++) border = border || tiles[neighbors[n]].awake;
+            if (!border) continue;
+        }
+
+        if (tile.awake) awakeTiles.push_back(t);
+        for (int s = tile.spanBegin; s < tile.spanEnd; s++)
+        {
+            (tile.awake ? awakeSpans : borderSpans).push_back(spans[s]);
+            if (tile.awake) numAwakeParticles += spans[s].end - spans[s].begin;
+        }
+    }
+    MergeSpans(awakeSpans);
+    MergeSpans(borderSpans);
+}
+
+// Evaluate: Largest kinetic energy and unbalanced force per unit mass of every awake tile against the thresholds.
+// A free particle resting on the ground is held up by it, so a downward net force there does not count.
+void SleepTracker::Evaluate(const ParticleSystem& ps, float gravityAcce, float groundPos, int numThreads)
+{
+    if (!enabled) return;
+
+    const float floorY = groundPos + (float)EPSILON; // Same height the integrator clamps to.
+    const float energy2 = 2.0f * energyThreshold;
+    const float force2 = forceThreshold * forceThreshold;
+
+    int numAwake = (int)awakeTiles.size();
+    ThreadPool::Shared().ParallelFor(numAwake, std::min(numThreads, numAwake / SLEEP_GRAIN), [&](int begin, int end)
+        {
+            for (int k = begin; k < end; k++)
+            {
+                Tile& tile = tiles[awakeTiles[k]];
+                bool moving = false;
+                for (int s = tile.spanBegin; s < tile.spanEnd && !moving; s++)
+                {
+                    for (int i = spans[s].begin; i < spans[s].end; i++)
+                    {
+                        float w = ps.invMass[i];
+                        if (w == 0.0f) continue; // Pinned particles only move when moved from outside.
+
+                        float v2 = ps.vx[i] * ps.vx[i] + ps.vy[i] * ps.vy[i] + ps.vz[i] * ps.vz[i];
+                        float ax = ps.fx[i] * w;
+                        float ay = ps.fy[i] * w - gravityAcce;
+                        float az = ps.fz[i] * w;
+                        if (ay < 0.0f && ps.py[i] <= floorY) ay = 0.0f;
+
+                        moving = moving || v2 > energy2 || ax * ax + ay * ay + az * az > force2;
+                    }
+                }
+                tile.moving = moving;
+            }
+        });
+}
+
+// Update: Counts the steps every awake tile has rested. A tile sleeps once it rested sleepSteps steps and no
+// tile around it is moving, a sleeping tile wakes as soon as one is.
+void SleepTracker::Update(ParticleSystem& ps)
+{
+    if (!enabled) return;
+
+    for (int t = 0; t < (int)tiles.size(); t++)
+    {
+        Tile& tile = tiles[t];
+        bool nearMoving = false;
+        for (int n = tile.neighborBegin; n < tile.neighborEnd; n++) nearMoving = nearMoving || tiles[neighbors[n]].moving;
+
+        if (!tile.awake)
+        {
+            if (nearMoving) SetAwake(t, true);
+            continue;
+        }
+
+        tile.restSteps = tile.moving ? 0 : tile.restSteps + 1;
+        if (tile.restSteps < sleepSteps || nearMoving) continue;
+
+        // Whatever motion is left would only creep, a sleeping tile stands still.
+        SetAwake(t, false);
+        for (int s = tile.spanBegin; s < tile.spanEnd; s++)
+        {
+            std::fill(ps.vx.begin() + spans[s].begin, ps.vx.begin() + spans[s].end, 0.0f);
+            std::fill(ps.vy.begin() + spans[s].begin, ps.vy.begin() + spans[s].end, 0.0f);
+            std::fill(ps.vz.begin() + spans[s].begin, ps.vz.begin() + spans[s].end, 0.0f);
+        }
+    }
+
+    // The flags are set again by the next evaluation.
+    for (Tile& tile : tiles) tile.moving = false;
+    if (changed) RebuildSpans();
+}
+
+// WakeParticle: Wakes the tile of a particle that was moved from outside the simulation.
+void SleepTracker::WakeParticle(int i)
+{
+    int t = particleTile[i];
+    if (tiles[t].awake)
+    {
+        tiles[t].restSteps = 0;
+        return;
+    }
+    SetAwake(t, true);
+    RebuildSpans();
+}
+
+// WakeAll: Wakes every tile and restarts every rest count, e.g. after a change of the cloth's parameters.
+void SleepTracker::WakeAll()
+{
+    bool anySleeping = numSleeping > 0;
+    for (int t = 0; t < (int)tiles.size(); t++) SetAwake(t, true);
+    if (anySleeping) RebuildSpans();
+}
@@ -0,0 +1,254 @@
+#include "SparseCholesky.h"
+
+#include <algorithm>
+#include <set>
+
+// MinimumDegreeOrdering: Approximate minimum degree ordering (Amestoy, Davis & Duff) on the quotient graph.
+// Eliminated variables become elements, which keeps the graph no larger than the original matrix.
+// Supervariable detection and aggressive absorption are omitted for simplicity.
+std::vector<int> MinimumDegreeOrdering(const SparseMatrix& A)
+{
+    const int n = A.n;
+
+    // Variable-variable and variable-element adjacency, and the variables of each element.
+    std::vector<std::vector<int>> adjVar(n), adjElem(n), elemVars(n);
+    std::vector<char> isVar(n, 1), isElem(n, 0);
+    std::vector<int> degree(n);
+    for (int j = 0; j < n; j++)
+    {
+        for (int p = A.colStart[j]; p < A.colStart[j + 1]; p++)
+        {
+            if (A.rows[p] != j) adjVar[j].push_back(A.rows[p]);
+        }
+        degree[j] = (int)adjVar[j].size();
+    }
+
+    // Variables ordered by approximate degree.
+    std::set<std::pair<int, int>> queue;
+    for (int j = 0; j < n; j++)
+    {
+        queue.insert({ degree[j], j });
+    }
+
+    std::vector<int> mark(n, -1), weight(n, -1), weightStamp(n, -1);
+    std::vector<int> perm;
+    perm.reserve(n);
+
+    for (int k = 0; k < n; k++)
+    {
+        // Pivot on the variable of minimum degree.
+        int piv = queue.begin()->second;
+        queue.erase(queue.begin());
+        perm.push_back(piv);
+        isVar[piv] = 0;
+
+        // The new element's variables: the pivot's variable neighbors plus those of its adjacent elements.
+        std::vector<int> Lp;
+        mark[piv] = k;
+        for (int v : adjVar[piv])
+        {
+            if (isVar[v] && mark[v] != k)
+            {
+                mark[v] = k;
+                Lp.push_back(v);
+            }
+        }
+        for (int e : adjElem[piv])
+        {
+            if (!isElem[e]) continue;
+            for (int v : elemVars[e])
+            {
+                if (isVar[v] && mark[v] != k)
+                {
+                    mark[v] = k;
+                    Lp.push_back(v);
+                }
+            }
+
+            // The element is absorbed into the new one.
+            isElem[e] = 0;
+            std::vector<int>().swap(elemVars[e]);
+        }
+        isElem[piv] = 1;
+        std::vector<int>().swap(adjVar[piv]);
+        std::vector<int>().swap(adjElem[piv]);
+
+        // Drop absorbed elements from the neighbors and compute |Le \ Lp| for the elements they still touch.
+        for (int i : Lp)
+        {
+            auto& elems = adjElem[i];
+            elems.erase(std::remove_if(elems.begin(), elems.end(), [&](int e) { return !isElem[e]; }), elems.end());
+            for (int e : elems)
+            {
+                if (weightStamp[e] != k)
+                {
+                    weightStamp[e] = k;
+                    weight[e] = (int)elemVars[e].size();
+                }
+                weight[e]--;
+            }
+            elems.push_back(piv);
+
+            // Variables reachable through the new element no longer need a direct edge.
+            auto& vars = adjVar[i];
+            vars.erase(std::remove_if(vars.begin(), vars.end(), [&](int v) { return !isVar[v] || mark[v] == k; }), vars.end());
+        }
+
+        // Approximate external degree of every variable of the new element.
+        int remaining = n - k - 1;
+        for (int i : Lp)
+        {
+            int d = (int)adjVar[i].size() + (int)Lp.size() - 1;
+            for (int e : adjElem[i])
+            {
+                if (e != piv) d += weight[e];
+            }
+            d = std::min(d, std::min(remaining - 1, degree[i] + (int)Lp.size()));
+            d = std::max(d, 0);
+
+            queue.erase({ degree[i], i });
+            degree[i] = d;
+            queue.insert({ d, i });
+        }
+        elemVars[piv] = std::move(Lp);
+    }
+
+    return perm;
+}
+
+// Analyze: Computes the fill-reducing ordering, the elimination tree and the column counts of L.
+void SparseLDLT::Analyze(const SparseMatrix& A)
+{
+    n = A.n;
+    perm = MinimumDegreeOrdering(A);
+    permInv.resize(n);
+    for (int k = 0; k < n; k++)
+    {
+        permInv[perm[k]] = k;
+    }
+
+    parent.assign(n, -1);
+    colCount.assign(n, 0);
+    flag.assign(n, 0);
+
+    // Walk up the elimination tree from every entry of the permuted upper triangle.
+    for (int k = 0; k < n; k++)
+    {
+        parent[k] = -1;
+        flag[k] = k;
+        int kk = perm[k];
+        for (int p = A.colStart[kk]; p < A.colStart[kk + 1]; p++)
+        {
+            int i = permInv[A.rows[p]];
+            if (i >= k) continue;
+            for (; flag[i] != k; i = parent[i])
+            {
+                if (parent[i] == -1) parent[i] = k;
+                colCount[i]++;
+                flag[i] = k;
+            }
+        }
+    }
+
+    // Column pointers of L.
+    colStart.assign(n + 1, 0);
+    for (int k = 0; k < n; k++)
+    {
+        colStart[k + 1] = colStart[k] + colCount[k];
+    }
+    Li.resize(colStart[n]);
+    Lx.resize(colStart[n]);
+    D.resize(n);
+
+    Y.assign(n, 0.0);
+    pattern.resize(n);
+    lnz.resize(n);
+}
+
+// Factorize: Up-looking numeric LDL^T factorization. Returns false if a zero pivot is met.
+bool SparseLDLT::Factorize(const SparseMatrix& A)
+{
+    for (int k = 0; k < n; k++)
+    {
+        // Scatter column k of the permuted matrix into Y and find the nonzero pattern of row k of L.
+        Y[k] = 0.0;
+        int top = n;
+        flag[k] = k;
+        lnz[k] = 0;
+        int kk = perm[k];
+        for (int p = A.colStart[kk]; p < A.colStart[kk + 1]; p++)
+        {
+            int i = permInv[A.rows[p]];
+            if (i > k) continue;
+            Y[i] += A.values[p];
+            int len = 0;
+            for (; flag[i] != k; i = parent[i])
+            {
+                pattern[len++] = i;
+                flag[i] = k;
+            }
+            while (len > 0) pattern[--top] = pattern[--len];
+        }
+
+        // Compute the numeric values of row k of L and the pivot D[k].
+        D[k] = Y[k];
+        Y[k] = 0.0;
+        for (; top < n; top++)
+        {
+            int i = pattern[top];
+            double yi = Y[i];
+            Y[i] = 0.0;
+            int end = colStart[i] + lnz[i];
+            for (int p = colStart[i]; p < end; p++)
+            {
+                Y[Li[p]] -= Lx[p] * yi;
+            }
+            double lki = yi / D[i];
+            D[k] -= lki * yi;
+            Li[end] = k;
+            Lx[end] = lki;
+            lnz[i]++;
+        }
+        if (D[k] == 0.0) return false;
+    }
+    return true;
+}
+
+// Solve: Permutes b, runs the forward, diagonal and backward solves, and permutes the result back.
+void SparseLDLT::Solve(std::vector<double>& x, std::vector<double>& work) const
+{
+    work.resize(n);
+    for (int k = 0; k < n; k++)
+    {
+        work[k] = x[perm[k]];
+    }
+
+    // L y = b
+    for (int j = 0; j < n; j++)
+    {
+        for (int p = colStart[j]; p < colStart[j + 1]; p++)
+        {
+            work[Li[p]] -= Lx[p] * work[j];
+        }
+    }
+
+    // D z = y
+    for (int j = 0; j < n; j++)
+    {
+        work[j] /= D[j];
+    }
+
+    // L^T x = z
+    for (int j = n - 1; j >= 0; j--)
+    {
+        for (int p = colStart[j]; p < colStart[j + 1]; p++)
+        {
+            work[j] -= Lx[p] * work[Li[p]];
+        }
+    }
+
+    for (int k = 0; k < n; k++)
+    {
+        x[perm[k]] = work[k];
+    }
+}
@@ -1,56 +1,321 @@
 #include "SpringDamper.h"
 
-// Constructor: Initializes the spring-damper system with two particles, spring constant, damping constant, and rest length.
-SpringDamper::SpringDamper(Particle* _P1, Particle* _P2, float* _SpringConst, float* _DampingConst, float* _RestLength)
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SPRING_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC allows any intrinsic in any function, the kernel is only called once CPUID reports support.
+#define SPRING_TARGET_SSE4
+#define SPRING_TARGET_AVX2
+#else
+#define SPRING_TARGET_SSE4 __attribute__((target("sse4.1")))
+#define SPRING_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// ComputeSpringForcesScalar: Reference kernel, computes and applies the forces of one spring at a time.
+// Springs are read sequentially, particle data is accessed by index straight from the particle arrays.
+// The float operations are those of the per-object SpringDamper::ComputeForce it replaced, in the same order,
+// so both give bit-identical forces.
+static void ComputeSpringForcesScalar(ParticleSystem& ps, const SpringDamper* springs, int count, float springConst, float dampingConst)
 {
-    P1 = _P1; // First particle connected by the spring-damper
-    P2 = _P2; // Second particle connected by the spring-damper
+    const float* __restrict PX = ps.px.data();
+    const float* __restrict PY = ps.py.data();
+    const float* __restrict PZ = ps.pz.data();
+    const float* __restrict VX = ps.vx.data();
+    const float* __restrict VY = ps.vy.data();
+    const float* __restrict VZ = ps.vz.data();
+    float* __restrict FX = ps.fx.data();
+    float* __restrict FY = ps.fy.data();
+    float* __restrict FZ = ps.fz.data();
+
+    for (int s = 0; s < count; s++)
+    {
+        const int i = springs[s].i;
+        const int j = springs[s].j;
+
+        // Calculate the current direction vector from P1 to P2 and its length.
+        float dx = PX[j] - PX[i];
+        float dy = PY[j] - PY[i];
+        float dz = PZ[j] - PZ[i];
+        float currLength = sqrtf(dx * dx + dy * dy + dz * dz);
+
+        // Normalize the direction vector if its length is significant, otherwise drop the spring's contribution.
+        if (currLength > (float)EPSILON)
+        {
+            float invLength = 1.0f / currLength;
+            dx *= invLength;
+            dy *= invLength;
+            dz *= invLength;
+        }
+        else
+        {
+            dx = dy = dz = 0.0f;
+            currLength = 0.0f;
+        }
+
+        // Hooke's law along the spring: F = -k * (l - x) * dir.
+        float fSpring = -springConst * (springs[s].restLength - currLength);
+
+        // Damping along the spring: F = -c * v * dir, with v the relative velocity of the two particles along dir.
+        float v = (VX[i] - VX[j]) * dx + (VY[i] - VY[j]) * dy + (VZ[i] - VZ[j]) * dz;
+        float fDamper = -dampingConst * v;
+
+        // Apply the sum of both forces to P1 and the opposite force to P2.
+        float fx = fSpring * dx + fDamper * dx;
+        float fy = fSpring * dy + fDamper * dy;
+        float fz = fSpring * dz + fDamper * dz;
+        FX[i] += fx;
+        FY[i] += fy;
+        FZ[i] += fz;
+        FX[j] -= fx;
+        FY[j] -= fy;
+        FZ[j] -= fz;
+    }
+}
 
-    SpringConst = _SpringConst; // Pointer to the spring constant (stiffness of the spring)
-    DampingConst = _DampingConst; // Pointer to the damping constant (resistance factor)
-    RestLength = _RestLength; // Pointer to the rest length of the spring (natural length without any forces applied)
+#ifdef SPRING_SIMD_X86
 
-    // Calculate the initial direction vector from P1 to P2.
-    // This is used to calculate forces applied to the particles.
-    prevDir = P2->GetPosition() - P1->GetPosition();
+// ScatterSpringForces: Accumulates the forces computed for a block of springs into the particles.
+// Done one spring at a time so springs of the same block may share particles.
+static inline void ScatterSpringForces(ParticleSystem& ps, const SpringDamper* springs, int width, const float* fx, const float* fy, const float* fz)
+{
+    for (int k = 0; k < width; k++)
+    {
+        const int i = springs[k].i;
+        const int j = springs[k].j;
+        ps.fx[i] += fx[k];
+        ps.fy[i] += fy[k];
+        ps.fz[i] += fz[k];
+        ps.fx[j] -= fx[k];
+        ps.fy[j] -= fy[k];
+        ps.fz[j] -= fz[k];
+    }
 }
 
-// Computes and applies the forces generated by the spring and damper to both particles.
-void SpringDamper::ComputeForce()
+// ComputeSpringForcesSSE4: 4-wide kernel. SSE has no gather, so the particle data is loaded lane by lane.
+SPRING_TARGET_SSE4
+static void ComputeSpringForcesSSE4(ParticleSystem& ps, const SpringDamper* springs, int count, float springConst, float dampingConst)
 {
-    // Calculate the current direction vector from P1 to P2 and its length.
-    glm::vec3 dir = P2->GetPosition() - P1->GetPosition();
-    float currLength = glm::length(dir);
+    const float* PX = ps.px.data();
+    const float* PY = ps.py.data();
+    const float* PZ = ps.pz.data();
+    const float* VX = ps.vx.data();
+    const float* VY = ps.vy.data();
+    const float* VZ = ps.vz.data();
+
+    const __m128 eps = _mm_set1_ps((float)EPSILON);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 k = _mm_set1_ps(-springConst);
+    const __m128 c = _mm_set1_ps(-dampingConst);
 
-    // Normalize the direction vector if its length is significant.
-    if (currLength > EPSILON)
+    alignas(16) float outX[4], outY[4], outZ[4];
+
+    int s = 0;
+    for (; s + 4 <= count; s += 4)
     {
-        dir = glm::normalize(dir);
-        prevDir = dir; // Update the previous direction for future use.
+        const SpringDamper* sp = springs + s;
+        const int i0 = sp[0].i, i1 = sp[1].i, i2 = sp[2].i, i3 = sp[3].i;
+        const int j0 = sp[0].j, j1 = sp[1].j, j2 = sp[2].j, j3 = sp[3].j;
+
+        // Direction vector from P1 to P2 for four springs.
+        __m128 dx = _mm_sub_ps(_mm_setr_ps(PX[j0], PX[j1], PX[j2], PX[j3]), _mm_setr_ps(PX[i0], PX[i1], PX[i2], PX[i3]));
+        __m128 dy = _mm_sub_ps(_mm_setr_ps(PY[j0], PY[j1], PY[j2], PY[j3]), _mm_setr_ps(PY[i0], PY[i1], PY[i2], PY[i3]));
+        __m128 dz = _mm_sub_ps(_mm_setr_ps(PZ[j0], PZ[j1], PZ[j2], PZ[j3]), _mm_setr_ps(PZ[i0], PZ[i1], PZ[i2], PZ[i3]));
+
+        // Length, and a mask that zeroes degenerate springs instead of branching.
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        __m128 valid = _mm_cmpgt_ps(len, eps);
+        __m128 invLen = _mm_and_ps(valid, _mm_div_ps(one, len));
+        len = _mm_and_ps(valid, len);
+        dx = _mm_mul_ps(dx, invLen);
+        dy = _mm_mul_ps(dy, invLen);
+        dz = _mm_mul_ps(dz, invLen);
+
+        // Hooke term: -k * (l - x).
+        __m128 rest = _mm_setr_ps(sp[0].restLength, sp[1].restLength, sp[2].restLength, sp[3].restLength);
+        __m128 fSpring = _mm_mul_ps(k, _mm_sub_ps(rest, len));
+
+        // Damping term: -c * dot(v1 - v2, dir).
+        __m128 rvx = _mm_sub_ps(_mm_setr_ps(VX[i0], VX[i1], VX[i2], VX[i3]), _mm_setr_ps(VX[j0], VX[j1], VX[j2], VX[j3]));
+        __m128 rvy = _mm_sub_ps(_mm_setr_ps(VY[i0], VY[i1], VY[i2], VY[i3]), _mm_setr_ps(VY[j0], VY[j1], VY[j2], VY[j3]));
+        __m128 rvz = _mm_sub_ps(_mm_setr_ps(VZ[i0], VZ[i1], VZ[i2], VZ[i3]), _mm_setr_ps(VZ[j0], VZ[j1], VZ[j2], VZ[j3]));
+        __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rvx, dx), _mm_mul_ps(rvy, dy)), _mm_mul_ps(rvz, dz));
+        __m128 fDamper = _mm_mul_ps(c, v);
+
+        // Force on P1 along the spring direction, summed per component like the scalar kernel.
+        _mm_store_ps(outX, _mm_add_ps(_mm_mul_ps(fSpring, dx), _mm_mul_ps(fDamper, dx)));
+        _mm_store_ps(outY, _mm_add_ps(_mm_mul_ps(fSpring, dy), _mm_mul_ps(fDamper, dy)));
+        _mm_store_ps(outZ, _mm_add_ps(_mm_mul_ps(fSpring, dz), _mm_mul_ps(fDamper, dz)));
+        ScatterSpringForces(ps, sp, 4, outX, outY, outZ);
     }
-    else
+
+    // Remaining springs go through the reference kernel.
+    ComputeSpringForcesScalar(ps, springs + s, count - s, springConst, dampingConst);
+}
+
+// ComputeSpringForcesAVX2: 8-wide kernel using hardware gathers for the spring records and the particle data.
+SPRING_TARGET_AVX2
+static void ComputeSpringForcesAVX2(ParticleSystem& ps, const SpringDamper* springs, int count, float springConst, float dampingConst)
+{
+    const float* PX = ps.px.data();
+    const float* PY = ps.py.data();
+    const float* PZ = ps.pz.data();
+    const float* VX = ps.vx.data();
+    const float* VY = ps.vy.data();
+    const float* VZ = ps.vz.data();
+
+    const __m256 eps = _mm256_set1_ps((float)EPSILON);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 k = _mm256_set1_ps(-springConst);
+    const __m256 c = _mm256_set1_ps(-dampingConst);
+
+    // Offsets (in 32-bit words) of the eight consecutive spring records.
+    const int stride = sizeof(SpringDamper) / sizeof(int);
+    const __m256i recordOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+
+    alignas(32) float outX[8], outY[8], outZ[8];
+
+    int s = 0;
+    for (; s + 8 <= count; s += 8)
     {
-        dir = glm::vec3(0.0f); // Reset direction if too small.
-        currLength = 0.0f; // Avoid division by zero in subsequent calculations.
+        const SpringDamper* sp = springs + s;
+        const int* base = reinterpret_cast<const int*>(sp);
+
+        // Gather the endpoint indices and rest lengths of eight springs.
+        __m256i vi = _mm256_i32gather_epi32(base, recordOffsets, 4);
+        __m256i vj = _mm256_i32gather_epi32(base + 1, recordOffsets, 4);
+        __m256 rest = _mm256_i32gather_ps(reinterpret_cast<const float*>(base + 2), recordOffsets, 4);
+
+        // Direction vector from P1 to P2.
+        __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(PX, vj, 4), _mm256_i32gather_ps(PX, vi, 4));
+        __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(PY, vj, 4), _mm256_i32gather_ps(PY, vi, 4));
+        __m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(PZ, vj, 4), _mm256_i32gather_ps(PZ, vi, 4));
+
+        // Length, and a mask that zeroes degenerate springs instead of branching.
+        __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+        __m256 valid = _mm256_cmp_ps(len, eps, _CMP_GT_OQ);
+        __m256 invLen = _mm256_and_ps(valid, _mm256_div_ps(one, len));
+        len = _mm256_and_ps(valid, len);
+        dx = _mm256_mul_ps(dx, invLen);
+        dy = _mm256_mul_ps(dy, invLen);
+        dz = _mm256_mul_ps(dz, invLen);
+
+        // Hooke term: -k * (l - x).
+        __m256 fSpring = _mm256_mul_ps(k, _mm256_sub_ps(rest, len));
+
+        // Damping term: -c * dot(v1 - v2, dir).
+        __m256 rvx = _mm256_sub_ps(_mm256_i32gather_ps(VX, vi, 4), _mm256_i32gather_ps(VX, vj, 4));
+        __m256 rvy = _mm256_sub_ps(_mm256_i32gather_ps(VY, vi, 4), _mm256_i32gather_ps(VY, vj, 4));
+        __m256 rvz = _mm256_sub_ps(_mm256_i32gather_ps(VZ, vi, 4), _mm256_i32gather_ps(VZ, vj, 4));
+        __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rvx, dx), _mm256_mul_ps(rvy, dy)), _mm256_mul_ps(rvz, dz));
+        __m256 fDamper = _mm256_mul_ps(c, v);
+
+        // Force on P1 along the spring direction, summed per component like the scalar kernel.
+        _mm256_store_ps(outX, _mm256_add_ps(_mm256_mul_ps(fSpring, dx), _mm256_mul_ps(fDamper, dx)));
+        _mm256_store_ps(outY, _mm256_add_ps(_mm256_mul_ps(fSpring, dy), _mm256_mul_ps(fDamper, dy)));
+        _mm256_store_ps(outZ, _mm256_add_ps(_mm256_mul_ps(fSpring, dz), _mm256_mul_ps(fDamper, dz)));
+        ScatterSpringForces(ps, sp, 8, outX, outY, outZ);
     }
 
-    // Calculate the force generated by the spring according to Hooke's Law: F = -k * (x - l)
-    // where k is the spring constant, x is the current length, and l is the rest length.
-    glm::vec3 f_spring = -(*SpringConst) * ((*RestLength) - currLength) * dir;
+    // Remaining springs go through the reference kernel.
+    ComputeSpringForcesScalar(ps, springs + s, count - s, springConst, dampingConst);
+}
+
+// CPUSupports: Queries CPUID (and the OS-enabled register state for AVX) for the requested kernel.
+static bool CPUSupports(SpringKernel kernel)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (kernel == SPRING_KERNEL_SSE4) return sse41;
+
+    // AVX registers must be enabled by the OS (XCR0 bits 1 and 2).
+    if (!osxsave || !avx || maxLeaf < 7) return false;
+    if ((_xgetbv(0) & 0x6) != 0x6) return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    if (kernel == SPRING_KERNEL_SSE4) return __builtin_cpu_supports("sse4.1");
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+// GetBestSpringKernel: Returns the widest kernel the running CPU supports.
+SpringKernel GetBestSpringKernel()
+{
+#ifdef SPRING_SIMD_X86
+    if (CPUSupports(SPRING_KERNEL_AVX2)) return SPRING_KERNEL_AVX2;
+    if (CPUSupports(SPRING_KERNEL_SSE4)) return SPRING_KERNEL_SSE4;
+#endif
+    return SPRING_KERNEL_SCALAR;
+}
+
+typedef void (*SpringKernelFunc)(ParticleSystem&, const SpringDamper*, int, float, float);
+
+// KernelFunc: Maps a kernel to its implementation.
+static SpringKernelFunc KernelFunc(SpringKernel kernel)
+{
+#ifdef SPRING_SIMD_X86
+    if (kernel == SPRING_KERNEL_AVX2) return ComputeSpringForcesAVX2;
+    if (kernel == SPRING_KERNEL_SSE4) return ComputeSpringForcesSSE4;
+#endif
+    return ComputeSpringForcesScalar;
+}
+
+// Selected kernel and its implementation.
+struct ActiveSpringKernel
+{
+    SpringKernel kernel;
+    SpringKernelFunc func;
+};
+
+// ActiveKernel: The selected kernel, the best one until SetSpringKernel picks another. It is set up on first use,
+// so code running during static initialization of other files never sees it unset.
+static ActiveSpringKernel& ActiveKernel()
+{
+    static ActiveSpringKernel active = { GetBestSpringKernel(), KernelFunc(GetBestSpringKernel()) };
+    return active;
+}
+
+SpringKernel GetSpringKernel()
+{
+    return ActiveKernel().kernel;
+}
 
-    // If the spring force is negligible, reset it to avoid unnecessary calculations.
-    if (f_spring.length() < EPSILON) f_spring = glm::vec3(0.0f);
+// SetSpringKernel: Switches the kernel, e.g. to compare against the scalar reference.
+void SetSpringKernel(SpringKernel kernel)
+{
+    // Never select a kernel wider than what the CPU supports.
+    SpringKernel best = GetBestSpringKernel();
+    if (kernel > best) kernel = best;
 
-    // Calculate the damping force based on the relative velocity of the two particles along the direction of the spring.
-    // F_damping = -c * v, where c is the damping constant and v is the relative velocity along the spring's direction.
-    float v = glm::dot(P1->GetVelocity() - P2->GetVelocity(), dir);
-    glm::vec3 f_damper = -(*DampingConst) * v * dir;
+    ActiveKernel() = { kernel, KernelFunc(kernel) };
+}
 
-    // If the damping force is negligible, reset it to avoid unnecessary calculations.
-    if (f_damper.length() < EPSILON) f_damper = glm::vec3(0.0f);
+const char* GetSpringKernelName(SpringKernel kernel)
+{
+    switch (kernel)
+    {
+    case SPRING_KERNEL_AVX2: return "AVX2";
+    case SPRING_KERNEL_SSE4: return "SSE4.1";
+    default: return "Scalar";
+    }
+}
 
-    // Apply the combined spring and damping forces to particle P1.
-    P1->ApplyForce(f_spring + f_damper);
-    // Apply the opposite force to particle P2 to maintain Newton's third law: For every action, there is an equal and opposite reaction.
-    P2->ApplyForce(-f_spring - f_damper);
+// ComputeSpringForces: Computes and applies the forces generated by a batch of springs, using the selected kernel.
+void ComputeSpringForces(ParticleSystem& ps, const SpringDamper* springs, int count, float springConst, float dampingConst)
+{
+    ActiveKernel().func(ps, springs, count, springConst, dampingConst);
 }
@@ -0,0 +1,132 @@
+#include "ThreadPool.h"
+
+// Set on pool threads (and on the caller while it runs tasks) so nested parallel loops run serially instead of deadlocking.
+static thread_local bool insideTask = false;
+
+// Constructor: Starts numThreads - 1 workers, the caller of ParallelFor is the last thread.
+ThreadPool::ThreadPool(int numThreads)
+{
+    nextTask = 0;
+    for (int i = 1; i < numThreads; i++)
+    {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+// Destructor: Wakes all workers and waits for them to exit.
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wakeCond.notify_all();
+    for (auto& t : workers)
+    {
+        t.join();
+    }
+}
+
+ThreadPool& ThreadPool::Shared()
+{
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+// RunTasks: Claims tasks of the given job until none are left or a newer job has replaced it.
+void ThreadPool::RunTasks(const Job& current)
+{
+    const unsigned long long tag = (current.generation & 0xffffffffull) << 32;
+    int finished = 0;
+    unsigned long long claim = nextTask.load();
+    while (true)
+    {
+        // Claim the next task only while the counter still belongs to this job.
+        if ((claim & ~0xffffffffull) != tag || (int)(claim & 0xffffffffull) >= current.numTasks) break;
+        if (!nextTask.compare_exchange_weak(claim, claim + 1)) continue;
+        int task = (int)(claim & 0xffffffffull);
+
+        // Contiguous range of this task.
+        int begin = (int)((long long)current.count * task / current.numTasks);
+        int end = (int)((long long)current.count * (task + 1) / current.numTasks);
+        (*current.body)(begin, end);
+        finished++;
+        claim = nextTask.load();
+    }
+
+    if (finished > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingTasks -= finished;
+        if (pendingTasks == 0) doneCond.notify_all();
+    }
+}
+
+// WorkerLoop: Sleeps until a new job is published, then helps to finish it.
+void ThreadPool::WorkerLoop()
+{
+    insideTask = true;
+    Job current;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCond.wait(lock, [&] { return stop || job.generation != current.generation; });
+            if (stop) return;
+            current = job;
+        }
+        RunTasks(current);
+    }
+}
+
+// ParallelForBatches: Processes color batches in order, each batch is split across threads.
+void ThreadPool::ParallelForBatches(const std::vector<int>& offsets, int maxTasks, int grain, const std::function<void(int, int)>& body)
+{
+    for (size_t c = 0; c + 1 < offsets.size(); c++)
+    {
+        int begin = offsets[c];
+        int batchCount = offsets[c + 1] - begin;
+        ParallelFor(batchCount, std::min(maxTasks, batchCount / grain), [&](int b, int e)
+            {
+                body(begin + b, begin + e);
+            });
+    }
+}
+
+// ParallelFor: Publishes a job, works on it from the calling thread, and waits until all of its tasks are done.
+void ThreadPool::ParallelFor(int _count, int maxTasks, const std::function<void(int, int)>& _body)
+{
+    if (_count <= 0) return;
+
+    int tasks = std::min(std::min(maxTasks, GetNumThreads()), _count);
+
+    // Small jobs, nested calls and single-threaded pools run directly on the caller.
+    if (tasks <= 1 || insideTask)
+    {
+        _body(0, _count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    Job current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job.body = &_body;
+        job.count = _count;
+        job.numTasks = tasks;
+        job.generation++;
+        nextTask = (job.generation & 0xffffffffull) << 32;
+        pendingTasks = tasks;
+        current = job;
+    }
+    wakeCond.notify_all();
+
+    insideTask = true;
+    RunTasks(current);
+    insideTask = false;
+
+    // Wait for the workers to finish the tasks they claimed.
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCond.wait(lock, [&] { return pendingTasks == 0; });
+    job.body = nullptr;
+}
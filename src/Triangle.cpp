@@ -13,24 +13,28 @@ Triangle::Triangle(Particle* _P1, Particle* _P2, Particle* _P3, float* _FluidDen
 }
 
 // Computes the aerodynamic force acting on the triangle due to wind.
-void Triangle::ComputeAerodynamicForce()
+// If faceNormal is given, the area-weighted normal is also stored there for the vertex normal gather.
+void Triangle::ComputeAerodynamicForce(glm::vec3* faceNormal)
 {
+    // Calculate the normal vector of the triangle using the cross product of two edges.
+    glm::vec3 n = glm::cross(
+        P2->GetPosition() - P1->GetPosition(), 
+        P3->GetPosition() - P1->GetPosition());
+
+    // The unnormalized cross product is the area-weighted normal used for smooth shading.
+    if (faceNormal) *faceNormal = n;
+
     // Calculate the average velocity of the triangle's surface by averaging the velocities of its particles.
     glm::vec3 SurfaceVelocity = (
-        P1->GetVelocity() + P2->GetVelocity() + P2->GetVelocity()) / 3.0f;
+        P1->GetVelocity() + P2->GetVelocity() + P3->GetVelocity()) / 3.0f;
 
     // Calculate the relative velocity of the surface against the wind.
     glm::vec3 v_dir = SurfaceVelocity - *WindVelocity;
     float v_scale = glm::length(v_dir); // Magnitude of the relative velocity
-    if (v_scale < EPSILON) return; // If velocity is negligible, no force is applied.
+    float area = glm::length(n); // The magnitude of the cross product is twice the area of the triangle.
+    if (v_scale < EPSILON || area < EPSILON) return; // If velocity or area is negligible, no force is applied.
 
     v_dir /= v_scale; // Normalize the direction of the relative velocity.
-
-    // Calculate the normal vector of the triangle using the cross product of two edges.
-    glm::vec3 n = glm::cross(
-        P2->GetPosition() - P1->GetPosition(), 
-        P3->GetPosition() - P1->GetPosition());
-    float area = glm::length(n); // The magnitude of this cross product is twice the area of the triangle.
     n /= area; // Normalize the normal vector.
     area /= 2; // Correct the area calculation.
 
@@ -47,20 +51,3 @@ void Triangle::ComputeAerodynamicForce()
     P3->ApplyForce(f);
 }
 
-// Computes and distributes the normal vector of the triangle to its particles.
-void Triangle::ComputeNormal()
-{
-    // Calculate the normal vector of the triangle using the cross product of two edges.
-    glm::vec3 n = glm::cross(
-        P2->GetPosition() - P1->GetPosition(),
-        P3->GetPosition() - P1->GetPosition());
-
-    if (n.length() < EPSILON) return; // If the normal is negligible, skip normalization.
-
-    n = glm::normalize(n); // Normalize the normal vector.
-
-    // Add the computed normal to each particle. This is useful for lighting calculations.
-    P1->AddNormal(n);
-    P2->AddNormal(n);
-    P3->AddNormal(n);
-}
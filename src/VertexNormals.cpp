@@ -0,0 +1,142 @@
+#include "VertexNormals.h"
+
+// Build: Counts the triangles around every vertex, then fills them in with a prefix sum (counting sort).
+void VertexTriangleAdjacency::Build(int numVertices, const std::vector<glm::ivec3>& tris)
+{
+    offsets.assign(numVertices + 1, 0);
+    for (const glm::ivec3& t : tris)
+    {
+        offsets[t.x + 1]++;
+        offsets[t.y + 1]++;
+        offsets[t.z + 1]++;
+    }
+    for (int v = 0; v < numVertices; v++)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+
+    // Visiting triangles in order keeps every vertex's list sorted, so summation order is deterministic.
+    triangles.resize(offsets[numVertices]);
+    std::vector<int> next(offsets.begin(), offsets.end() - 1);
+    for (int i = 0; i < (int)tris.size(); i++)
+    {
+        triangles[next[tris[i].x]++] = i;
+        triangles[next[tris[i].y]++] = i;
+        triangles[next[tris[i].z]++] = i;
+    }
+}
+
+// ComputeFaceNormals: Cross product of the two edges leaving the first corner, its length is twice the area.
+void ComputeFaceNormals(const glm::vec3* positions, const glm::ivec3* tris, glm::vec3* faceNormals, int begin, int end)
+{
+    for (int t = begin; t < end; t++)
+    {
+        glm::vec3 p1 = positions[tris[t].x];
+        faceNormals[t] = glm::cross(positions[tris[t].y] - p1, positions[tris[t].z] - p1);
+    }
+}
+
+// ComputeFaceNormals: Same as above, reading the positions from a particle system.
+void ComputeFaceNormals(const ParticleSystem& ps, const glm::ivec3* tris, glm::vec3* faceNormals, int begin, int end)
+{
+    for (int t = begin; t < end; t++)
+    {
+        glm::vec3 p1 = ps.GetPosition(tris[t].x);
+        faceNormals[t] = glm::cross(ps.GetPosition(tris[t].y) - p1, ps.GetPosition(tris[t].z) - p1);
+    }
+}
+
+// GatherVertexNormals: Sums the incident face normals of every vertex and normalizes.
+void GatherVertexNormals(const VertexTriangleAdjacency& adjacency, const glm::vec3* faceNormals, glm::vec3* normals, int begin, int end)
+{
+    const int* offsets = adjacency.offsets.data();
+    const int* triangles = adjacency.triangles.data();
+    for (int v = begin; v < end; v++)
+    {
+        glm::vec3 n(0.0f);
+        for (int k = offsets[v]; k < offsets[v + 1]; k++)
+        {
+            n += faceNormals[triangles[k]];
+        }
+
+        // Vertices without any area keep a zero normal instead of NaN.
+        float len2 = glm::dot(n, n);
+        normals[v] = len2 > 0.0f ? n * glm::inversesqrt(len2) : n;
+    }
+}
+
+// ComputeGridNormals: Sums the six triangles around every vertex straight from the grid neighbours.
+// With spokes s = neighbour - p, the triangles around p are the consecutive pairs of the ring
+// down, down-right, right, up, up-left, left, so the area-weighted normal is the sum of the crosses of consecutive spokes.
+// Spokes that leave the grid are zero, which drops exactly the triangles that do not exist on the border.
+void ComputeGridNormals(const ParticleSystem& ps, int width, int height, glm::vec3* normals, int rowBegin, int rowEnd)
+{
+    const float* PX = ps.px.data();
+    const float* PY = ps.py.data();
+    const float* PZ = ps.pz.data();
+
+    auto vertexNormal = [&](int x, int y)
+    {
+        int i = x + y * width;
+        glm::vec3 p(PX[i], PY[i], PZ[i]);
+        bool left = x > 0, right = x < width - 1;
+        bool up = y > 0, down = y < height - 1;
+
+        auto spoke = [&](bool valid, int j) { return valid ? glm::vec3(PX[j], PY[j], PZ[j]) - p : glm::vec3(0.0f); };
+        glm::vec3 d = spoke(down, i + width);
+        glm::vec3 dr = spoke(down && right, i + width + 1);
+        glm::vec3 r = spoke(right, i + 1);
+        glm::vec3 u = spoke(up, i - width);
+        glm::vec3 ul = spoke(up && left, i - width - 1);
+        glm::vec3 l = spoke(left, i - 1);
+
+        glm::vec3 n = glm::cross(d, dr) + glm::cross(dr, r) + glm::cross(r, u)
+            + glm::cross(u, ul) + glm::cross(ul, l) + glm::cross(l, d);
+
+        // Vertices without any area keep a zero normal instead of NaN.
+        float len2 = glm::dot(n, n);
+        normals[i] = len2 > 0.0f ? n * glm::inversesqrt(len2) : n;
+    };
+
+    for (int y = rowBegin; y < rowEnd; y++)
+    {
+        // Border rows and columns go through the guarded path.
+        if (y == 0 || y == height - 1 || width < 3)
+        {
+            for (int x = 0; x < width; x++) vertexNormal(x, y);
+            continue;
+        }
+        vertexNormal(0, y);
+
+        // Interior vertices have all six neighbours, so the loop has no branches and vectorizes over x.
+        int row = y * width;
+        float* __restrict NX = &normals[0].x;
+        for (int x = 1; x < width - 1; x++)
+        {
+            int i = row + x;
+            float px = PX[i], py = PY[i], pz = PZ[i];
+            float dx = PX[i + width] - px, dy = PY[i + width] - py, dz = PZ[i + width] - pz;
+            float drx = PX[i + width + 1] - px, dry = PY[i + width + 1] - py, drz = PZ[i + width + 1] - pz;
+            float rx = PX[i + 1] - px, ry = PY[i + 1] - py, rz = PZ[i + 1] - pz;
+            float ux = PX[i - width] - px, uy = PY[i - width] - py, uz = PZ[i - width] - pz;
+            float ulx = PX[i - width - 1] - px, uly = PY[i - width - 1] - py, ulz = PZ[i - width - 1] - pz;
+            float lx = PX[i - 1] - px, ly = PY[i - 1] - py, lz = PZ[i - 1] - pz;
+
+            // Sum of the crosses of consecutive spokes d, dr, r, u, ul, l.
+            float nx = (dy * drz - dz * dry) + (dry * rz - drz * ry) + (ry * uz - rz * uy)
+                + (uy * ulz - uz * uly) + (uly * lz - ulz * ly) + (ly * dz - lz * dy);
+            float ny = (dz * drx - dx * drz) + (drz * rx - drx * rz) + (rz * ux - rx * uz)
+                + (uz * ulx - ux * ulz) + (ulz * lx - ulx * lz) + (lz * dx - lx * dz);
+            float nz = (dx * dry - dy * drx) + (drx * ry - dry * rx) + (rx * uy - ry * ux)
+                + (ux * uly - uy * ulx) + (ulx * ly - uly * lx) + (lx * dy - ly * dx);
+
+            float len2 = nx * nx + ny * ny + nz * nz;
+            float s = len2 > 0.0f ? 1.0f / std::sqrt(len2) : 0.0f;
+            NX[3 * i + 0] = nx * s;
+            NX[3 * i + 1] = ny * s;
+            NX[3 * i + 2] = nz * s;
+        }
+
+        vertexNormal(width - 1, y);
+    }
+}
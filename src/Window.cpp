@@ -10,16 +10,23 @@ const char* Window::windowTitle = "Cloth Simulation";
 
 // Project 1
 Skeleton* Window::skel;
+SkeletonRenderer* Window::skelRenderer = nullptr;
 
 // Project 2
 Skin* Window::skin = nullptr;
+SkinRenderer* Window::skinRenderer = nullptr;
 bool Window::drawSkelFlag = false;
 
 // Project 3
 Character* Window::character = nullptr;
 
 // Project 4
+ClothWorld* Window::clothWorld = nullptr;
 Cloth* Window::cloth = nullptr;
+MeshCollider* Window::skinCollider = nullptr;
+BoxCollider* Window::boxCollider = nullptr;
+ClothRenderer* Window::clothRenderer = nullptr;
+SimulationClock Window::simClock;
 
 // Camera Properties
 Camera* Cam;
@@ -78,7 +85,8 @@ bool Window::initializeObjects() {
    // Project 2
    	if (!skelFileName.empty())
 	{
-		skel = new Skeleton(skelFileName, shaderProgram);
+		skel = new Skeleton(skelFileName);
+		skelRenderer = new SkeletonRenderer(skel, shaderProgram);
 
         // Project 3
         int numOfJoint = skel->getNumOfJoint();
@@ -94,7 +102,8 @@ bool Window::initializeObjects() {
 	
 	if (!skinFileName.empty())
 	{
-		skin = new Skin(skinFileName, skel, shaderProgram);
+		skin = new Skin(skinFileName, skel);
+		skinRenderer = new SkinRenderer(skin, shaderProgram);
 
         if (!animFileName.empty())
 		{
@@ -117,14 +126,22 @@ bool Window::initializeObjects() {
 	}
 */
     // Project 4
-	cloth = new Cloth(
+	clothWorld = new ClothWorld();
+	cloth = clothWorld->AddCloth(
 		4.0f, // size 
 		100.0, //mass 
 		25, // N particles
 		glm::vec3(-2.0f, 3.0f, 0.0f), //topleft
 		glm::vec3(1.0f, 0.0f, 0.0f), // horizontal
-		glm::vec3(0.0f, -1.0f, 0.0f), // vertical
-		shaderProgram);
+		glm::vec3(0.0f, -1.0f, 0.0f)); // vertical
+	clothRenderer = new ClothRenderer(cloth, shaderProgram);
+	if (skin != nullptr) skinCollider = new MeshCollider(skin->getPositions(), skin->getTriangles());
+	if (skel != nullptr)
+	{
+		// The boxes start at rest in the skeleton's pose.
+		skel->update(glm::mat4(1.0));
+		boxCollider = new BoxCollider(skel);
+	}
 
 	return true;
 }
@@ -132,9 +149,14 @@ bool Window::initializeObjects() {
 void Window::cleanUp() {
     // Deallcoate the objects.
     // delete cube;
+	if (skelRenderer) delete skelRenderer;
 	if (skel) delete skel;
+	if (skinRenderer) delete skinRenderer;
 	if (skin) delete skin;
-	if (cloth) delete cloth;
+	if (clothRenderer) delete clothRenderer;
+	if (clothWorld) delete clothWorld;
+	if (skinCollider) delete skinCollider;
+	if (boxCollider) delete boxCollider;
 
     // Delete the shader program.
     glDeleteProgram(shaderProgram);
@@ -203,17 +225,40 @@ void Window::idleCallback() {
     // Project 1
     // skel->update(glm::mat4(1.0));
 
+    // Close the previous frame's timings and consume the elapsed wall time in fixed simulation steps
+    Profiler::Shared().EndFrame();
+    simClock.BeginFrame();
+
     // Project 3
-    if (character != nullptr) character->update();
+    if (character != nullptr) character->update(simClock);
 
     // Project 3
     // ELSE IF !!!! for fixed camera!!!!!
     else if (skel != nullptr)skel->update(glm::mat4(1.0));
 
-	if (skin != nullptr)skin->update();
+    if (boxCollider != nullptr) boxCollider->Update(simClock.GetSteps() * simClock.GetFixedDt());
+
+	if (skin != nullptr)
+	{
+		skin->update();
+		if (skinCollider != nullptr) skinCollider->Update(skin->getPositions(), simClock.GetSteps() * simClock.GetFixedDt(), clothWorld->GetNumThreads());
+	}
 
     // Project 4
-    if (cloth != nullptr) cloth->Update();
+    if (clothWorld != nullptr)
+    {
+        clothWorld->Update(simClock);
+        clothRenderer->Update();
+    }
+
+    // The colliders and the cloth use the pose of the last step, the character is drawn between the last two
+    // steps like the cloth.
+    if (character != nullptr)
+    {
+        character->updateRenderPose(simClock);
+        if (skin != nullptr) skin->update();
+    }
+    if (skin != nullptr) skinRenderer->update();
 	
 }
 
@@ -229,15 +274,15 @@ void Window::displayCallback(GLFWwindow* window) {
 
     if (skin != nullptr)
 	{
-		skin->draw(Cam->GetViewProjectMtx());
+		skinRenderer->draw(Cam->GetViewProjectMtx());
 	}
 	if ((skin == nullptr || drawSkelFlag) && skel != nullptr)
 	{
-		skel->draw(Cam->GetViewProjectMtx());
+		skelRenderer->draw(Cam->GetViewProjectMtx());
 	}
     if (cloth != nullptr)
 	{
-		cloth->Draw(Cam->GetViewProjectMtx());
+		clothRenderer->Draw(Cam->GetViewProjectMtx());
 	}
 
     // Gets events, including input such as keyboard and mouse or window resizing.
@@ -349,6 +394,16 @@ void Window::plotImGUI()
 	int numOfJoint = 0;
 	if(skel != nullptr) numOfJoint = skel->getNumOfJoint();
 
+    // Recompute the skin normals from the deformed triangles instead of skinning the loaded ones.
+    if (skin != nullptr)
+    {
+        bool gather = skin->getGatherNormals();
+        if (ImGui::Checkbox("Gather Normals", &gather))
+        {
+            skin->setGatherNormals(gather);
+        }
+    }
+
     // Iterate through all the joints in the skeleton.
 	for (int i = 0; i < numOfJoint; i++)
 	{
@@ -408,9 +463,48 @@ void Window::plotImGUI()
     ImGui::SetWindowSize(ImVec2(260, Window::height));
 
     // Display the current frames per second (FPS).
-    std::string fps = "FPS: " + std::to_string(cloth->GetFPS());
+    std::string fps = "FPS: " + std::to_string(simClock.GetFPS());
     ImGui::Text(fps.c_str());
 
+    // Number of threads the cloths are stepped with.
+    int threads = clothWorld->GetNumThreads();
+    if (ImGui::SliderInt("Threads", &threads, 1, ThreadPool::Shared().GetNumThreads()))
+    {
+        clothWorld->SetNumThreads(threads);
+    }
+    ImGui::Text("Throughput: %.2e particle-substeps/s", clothWorld->GetLastThroughput());
+
+    // Rolling per-phase timings of the last frames.
+    if (ImGui::TreeNode("Profiler"))
+    {
+        Profiler& profiler = Profiler::Shared();
+        bool enabled = profiler.IsEnabled();
+        if (ImGui::Checkbox("Enabled", &enabled))
+        {
+            profiler.SetEnabled(enabled);
+        }
+
+        for (int p = 0; p < NUM_PROFILE_PHASES; p++)
+        {
+            ProfilePhase phase = (ProfilePhase)p;
+            std::string label = std::string(Profiler::GetPhaseName(phase)) + " " + std::to_string(profiler.GetLastFrameTime(phase)).substr(0, 5) + " ms";
+            ImGui::PlotHistogram(label.c_str(), profiler.GetHistory(phase), Profiler::HISTORY_SIZE, profiler.GetHistoryOffset(), NULL, 0.0f, FLT_MAX, ImVec2(120, 30));
+        }
+
+        // Dump the recent events next to the executable.
+        if (ImGui::Button("Export CSV"))
+        {
+            profiler.WriteCSV("profile.csv");
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Export Trace"))
+        {
+            profiler.WriteChromeTrace("profile.json");
+        }
+
+        ImGui::TreePop();
+    }
+
     // Create a collapsible tree node for translating fixed points of the cloth.
     if (ImGui::TreeNode("Fixed Points"))
     {
@@ -512,6 +606,187 @@ void Window::plotImGUI()
         ImGui::TreePop(); // Close the tree node.
     }
 
+// Solver Section
+if (ImGui::TreeNode("Solver"))
+{
+    // Choose the integrator: explicit oversampling, implicit backward Euler, XPBD constraints, projective dynamics,
+    // or the explicit grid stencil that needs no spring or triangle lists.
+    int mode = cloth->GetSolverMode();
+    const char* modes[] = { "Explicit", "Implicit", "XPBD", "Projective", "Grid Stencil" };
+    if (ImGui::Combo("Integrator", &mode, modes, IM_ARRAYSIZE(modes)))
+    {
+        cloth->SetSolverMode((SolverMode)mode);
+    }
+
+    if (cloth->GetSolverMode() == SOLVER_EXPLICIT || cloth->GetSolverMode() == SOLVER_GRID)
+    {
+        // Substep count chosen from the stability estimate, or the fixed oversampling count.
+        bool adaptive = cloth->GetAdaptiveSubsteps();
+        if (ImGui::Checkbox("Adaptive Substeps", &adaptive))
+        {
+            cloth->SetAdaptiveSubsteps(adaptive);
+        }
+        ImGui::Text("Substeps: %d (avg %.1f)", cloth->GetLastSubsteps(), cloth->GetAverageSubsteps());
+
+        // Resting tiles of the explicit solver stop being simulated until something nearby moves.
+        if (cloth->GetSolverMode() == SOLVER_EXPLICIT && cloth->GetSleepTracker().CanSleep())
+        {
+            SleepTracker& sleep = cloth->GetSleepTracker();
+            bool sleepEnabled = sleep.GetEnabled();
+            if (ImGui::Checkbox("Sleep Resting Tiles", &sleepEnabled))
+            {
+                sleep.SetEnabled(sleepEnabled);
+            }
+            ImGui::Text("Sleeping tiles: %d / %d", sleep.GetNumSleeping(), sleep.GetNumTiles());
+        }
+
+        // Substeps the grid solver advances per pass over the rows, same results with fewer trips to memory.
+        if (cloth->GetSolverMode() == SOLVER_GRID)
+        {
+            int block = cloth->GetGridSolver().GetBlockSubsteps();
+            if (ImGui::SliderInt("Block Substeps", &block, 1, 16))
+            {
+                cloth->GetGridSolver().SetBlocking(block);
+            }
+        }
+    }
+    else if (cloth->GetSolverMode() == SOLVER_IMPLICIT)
+    {
+        // Number of implicit steps per frame.
+        int substeps = cloth->GetImplicitSubsteps();
+        if (ImGui::SliderInt("Substeps", &substeps, 1, 10))
+        {
+            cloth->SetImplicitSubsteps(substeps);
+        }
+
+        // Maximum number of CG iterations per step, and the iterations the last solve took.
+        int maxIter = cloth->GetImplicitSolver().GetMaxIterations();
+        if (ImGui::SliderInt("CG Iterations", &maxIter, 1, 500))
+        {
+            cloth->GetImplicitSolver().SetMaxIterations(maxIter);
+        }
+
+        // Preconditioner of the CG solve, multigrid keeps the iteration count low on fine cloths.
+        int precond = cloth->GetImplicitSolver().GetPreconditioner();
+        const char* preconds[] = { "Block Jacobi", "Multigrid" };
+        if (ImGui::Combo("Preconditioner", &precond, preconds, IM_ARRAYSIZE(preconds)))
+        {
+            cloth->GetImplicitSolver().SetPreconditioner((ImplicitPreconditioner)precond);
+        }
+        ImGui::Text("Last solve: %d iterations", cloth->GetImplicitSolver().GetLastIterations());
+    }
+    else if (cloth->GetSolverMode() == SOLVER_XPBD)
+    {
+        // Number of XPBD substeps per frame.
+        int substeps = cloth->GetXPBDSubsteps();
+        if (ImGui::SliderInt("Substeps", &substeps, 1, 40))
+        {
+            cloth->SetXPBDSubsteps(substeps);
+        }
+
+        // Number of constraint iterations per substep.
+        int iterations = cloth->GetXPBDIterations();
+        if (ImGui::SliderInt("Iterations", &iterations, 1, 20))
+        {
+            cloth->SetXPBDIterations(iterations);
+        }
+    }
+    else if (cloth->GetSolverMode() == SOLVER_PROJECTIVE)
+    {
+        // Number of local/global iterations per step, and how often the global matrix has been factored.
+        int iterations = cloth->GetProjectiveIterations();
+        if (ImGui::SliderInt("Iterations", &iterations, 1, 30))
+        {
+            cloth->SetProjectiveIterations(iterations);
+        }
+        ImGui::Text("Factorizations: %d", cloth->GetProjectiveSolver().GetNumFactorizations());
+    }
+
+    // Contacts of the cloth with itself, kept apart by the thickness. The grid solver does not support them.
+    if (cloth->GetSolverMode() != SOLVER_GRID)
+    {
+        SelfCollision& self = cloth->GetSelfCollision();
+        bool selfEnabled = self.GetEnabled();
+        if (ImGui::Checkbox("Self Collision", &selfEnabled))
+        {
+            self.SetEnabled(selfEnabled);
+        }
+        if (self.GetEnabled())
+        {
+            float thickness = self.GetThickness();
+            if (ImGui::SliderFloat("Thickness", &thickness, 0.0f, cloth->GetRestLength()))
+            {
+                self.SetThickness(thickness);
+            }
+            float friction = self.GetFriction();
+            if (ImGui::SliderFloat("Friction", &friction, 0.0f, 1.0f))
+            {
+                self.SetFriction(friction);
+            }
+            ImGui::Text("Contacts: %d (pairs %d)", self.GetLastContacts(), self.GetNumPairs());
+        }
+    }
+
+    ImGui::TreePop(); // End of Solver section.
+}
+
+// Skin Collider Section
+if (skinCollider != nullptr && ImGui::TreeNode("Skin Collider"))
+{
+    // Attach the skinned character to the cloths as a collider.
+    bool attached = clothWorld->HasCollider(skinCollider);
+    if (ImGui::Checkbox("Collide", &attached))
+    {
+        if (attached) clothWorld->AddCollider(skinCollider);
+        else clothWorld->RemoveCollider(skinCollider);
+    }
+
+    // Distance the cloth keeps from the skin, and how far through it a crossing particle is still caught.
+    float thickness = skinCollider->GetThickness();
+    if (ImGui::SliderFloat("Thickness", &thickness, 0.0f, 0.2f))
+    {
+        skinCollider->SetThickness(thickness);
+    }
+    float reach = skinCollider->GetReach();
+    if (ImGui::SliderFloat("Reach", &reach, 0.0f, 0.5f))
+    {
+        skinCollider->SetReach(reach);
+    }
+    float friction = skinCollider->GetFriction();
+    if (ImGui::SliderFloat("Friction", &friction, 0.0f, 1.0f))
+    {
+        skinCollider->SetFriction(friction);
+    }
+
+    ImGui::TreePop(); // End of Skin Collider section.
+}
+
+// Box Collider Section
+if (boxCollider != nullptr && ImGui::TreeNode("Box Collider"))
+{
+    // Attach the skeleton's joint boxes to the cloths as a collider, a cheaper stand-in for the skin.
+    bool attached = clothWorld->HasCollider(boxCollider);
+    if (ImGui::Checkbox("Collide", &attached))
+    {
+        if (attached) clothWorld->AddCollider(boxCollider);
+        else clothWorld->RemoveCollider(boxCollider);
+    }
+    ImGui::Text("Boxes: %d", boxCollider->GetNumBoxes());
+
+    float thickness = boxCollider->GetThickness();
+    if (ImGui::SliderFloat("Thickness", &thickness, 0.0f, 0.2f))
+    {
+        boxCollider->SetThickness(thickness);
+    }
+    float friction = boxCollider->GetFriction();
+    if (ImGui::SliderFloat("Friction", &friction, 0.0f, 1.0f))
+    {
+        boxCollider->SetFriction(friction);
+    }
+
+    ImGui::TreePop(); // End of Box Collider section.
+}
+
 // Cloths Coefficients Section
 if (ImGui::TreeNode("Cloth Coefficients"))
 {
@@ -0,0 +1,138 @@
+#include "XPBDSolver.h"
+
+#include "ThreadPool.h"
+
+// Minimum number of constraints or particles per task when a pass is split across threads.
+#define XPBD_GRAIN 512
+
+// Build: Stores the constraint groups and sizes the per-constraint multipliers and the per-particle scratch arrays.
+void XPBDSolver::Build(int numParticles, const std::vector<ConstraintGroup>& _groups)
+{
+    groups = _groups;
+
+    lambdas.resize(groups.size());
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        lambdas[g].assign(groups[g].springs->size(), 0.0f);
+    }
+
+    prevX.resize(numParticles);
+    prevY.resize(numParticles);
+    prevZ.resize(numParticles);
+}
+
+// SolveGroup: Projects every distance constraint of one group once, batch by batch.
+void XPBDSolver::SolveGroup(ParticleSystem& ps, int g, float alphaTilde, float gamma, int numThreads)
+{
+    const SpringDamper* springs = groups[g].springs->data();
+    float* lambda = lambdas[g].data();
+
+    ThreadPool::Shared().ParallelForBatches(*groups[g].batches, numThreads, XPBD_GRAIN, [&](int begin, int end)
+        {
+            for (int s = begin; s < end; s++)
+            {
+                const int i = springs[s].i;
+                const int j = springs[s].j;
+
+                float wi = ps.invMass[i];
+                float wj = ps.invMass[j];
+                float denom = (1.0f + gamma) * (wi + wj) + alphaTilde;
+                if (denom <= 0.0f) continue; // Both ends pinned and no compliance: nothing can move.
+
+                // Constraint C = |xi - xj| - restLength with gradient n = (xi - xj) / |xi - xj| on xi.
+                float dx = ps.px[i] - ps.px[j];
+                float dy = ps.py[i] - ps.py[j];
+                float dz = ps.pz[i] - ps.pz[j];
+                float len = sqrtf(dx * dx + dy * dy + dz * dz);
+                if (len <= EPSILON) continue;
+                dx /= len;
+                dy /= len;
+                dz /= len;
+                float C = len - springs[s].restLength;
+
+                // Displacement along the gradient since the start of the substep, for the damping term.
+                float dC = dx * ((ps.px[i] - prevX[i]) - (ps.px[j] - prevX[j]))
+                    + dy * ((ps.py[i] - prevY[i]) - (ps.py[j] - prevY[j]))
+                    + dz * ((ps.pz[i] - prevZ[i]) - (ps.pz[j] - prevZ[j]));
+
+                // XPBD multiplier update with damping.
+                float dLambda = (-C - alphaTilde * lambda[s] - gamma * dC) / denom;
+                lambda[s] += dLambda;
+
+                // Move both ends along the gradient, weighted by inverse mass.
+                ps.px[i] += wi * dLambda * dx;
+                ps.py[i] += wi * dLambda * dy;
+                ps.pz[i] += wi * dLambda * dz;
+                ps.px[j] -= wj * dLambda * dx;
+                ps.py[j] -= wj * dLambda * dy;
+                ps.pz[j] -= wj * dLambda * dz;
+            }
+        });
+}
+
+// Substep: Predicts positions from velocities and forces, projects the constraints, and derives the new velocities.
+void XPBDSolver::Substep(ParticleSystem& ps, float h, int iterations, float springConst, float dampingConst, float gravityAcce, float groundPos, int numThreads)
+{
+    const int n = ps.Size();
+    const float floorY = groundPos + (float)EPSILON;
+    const int tasks = std::min(numThreads, n / XPBD_GRAIN);
+
+    // Predict: explicit velocity update from external forces, then move the particles.
+    ThreadPool::Shared().ParallelFor(n, tasks, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                float w = ps.invMass[i];
+                float active = w > 0.0f ? 1.0f : 0.0f;
+                ps.vx[i] += ps.fx[i] * w * h;
+                ps.vy[i] += (ps.fy[i] * w - gravityAcce * active) * h;
+                ps.vz[i] += ps.fz[i] * w * h;
+
+                prevX[i] = ps.px[i];
+                prevY[i] = ps.py[i];
+                prevZ[i] = ps.pz[i];
+
+                ps.px[i] += ps.vx[i] * h;
+                ps.py[i] += ps.vy[i] * h;
+                ps.pz[i] += ps.vz[i] * h;
+
+                ps.fx[i] = 0.0f;
+                ps.fy[i] = 0.0f;
+                ps.fz[i] = 0.0f;
+            }
+        });
+
+    // Compliance and damping scaled by the substep: alpha~ = alpha / h^2, gamma = alpha~ * (beta * h^2) / h.
+    float alpha = springConst > 0.0f ? 1.0f / springConst : 0.0f;
+    float alphaTilde = alpha / (h * h);
+    float gamma = alphaTilde * dampingConst * h;
+
+    // Multipliers start from zero every substep.
+    for (auto& lambda : lambdas)
+    {
+        std::fill(lambda.begin(), lambda.end(), 0.0f);
+    }
+
+    for (int it = 0; it < iterations; it++)
+    {
+        for (int g = 0; g < (int)groups.size(); g++)
+        {
+            SolveGroup(ps, g, alphaTilde, gamma, numThreads);
+        }
+    }
+
+    // Ground collision on positions, then velocities from the position change.
+    ThreadPool::Shared().ParallelFor(n, tasks, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                bool below = ps.invMass[i] > 0.0f && ps.py[i] < floorY;
+                ps.py[i] = below ? floorY : ps.py[i];
+
+                ps.vx[i] = (ps.px[i] - prevX[i]) / h;
+                ps.vy[i] = (ps.py[i] - prevY[i]) / h;
+                ps.vz[i] = (ps.pz[i] - prevZ[i]) / h;
+                ps.vy[i] = below ? 0.0f : ps.vy[i];
+            }
+        });
+}